@@ -1,38 +1,48 @@
+#include <stdio.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "ds2431.h"
+#include "crc.h"
 
 #define TAG "DS2431"
 
+// Un sdkconfig viejo puede traer un valor por debajo del rango actual
+#if CONFIG_DS2431_COPY_SPU_US < DS2431_TPROG_MAX_US
+#define COPY_SPU_US          DS2431_TPROG_MAX_US
+#else
+#define COPY_SPU_US          CONFIG_DS2431_COPY_SPU_US
+#endif
+
 // ─────────────────────────────────────────────────────────────────────────────
-// CRC-16 (polinomio 0x8005, usado por DS2431)
+// CRC-16 (polinomio 0x8005, usado por DS2431) — ver componente crc
 // ─────────────────────────────────────────────────────────────────────────────
 uint16_t ds2431_crc16(const uint8_t *data, size_t len) {
-    uint16_t crc = 0x0000;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= (uint16_t)data[i] << 8;
-        for (int j = 0; j < 8; j++) {
-            crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : (crc << 1);
-        }
-    }
-    return crc;
+    return crc16_idj(data, len);
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
 // Match ROM — selecciona un esclavo por ROM de 64 bits
 // Tiempos extendidos para cable de ~80m (~4-8nF de capacitancia)
+//
+// Si el esclavo es el último direccionado en este bus, basta con Resume: el
+// DS2431 conserva su flag RC hasta el próximo comando ROM. Un reset que
+// necesitó reintentos puede venir de un corte de alimentación, así que en
+// ese caso se vuelve al Match ROM completo.
 // ─────────────────────────────────────────────────────────────────────────────
 esp_err_t ds2431_match_rom(ds2482_t *ds2482, ds2431_t *dev) {
     esp_err_t err;
     bool presence = false;
 
-    // 3 reintentos con 30ms entre ellos — bus largo necesita más recuperación
-    for (int intento = 0; intento < 3; intento++) {
-        err = ds2482_1wire_reset(&presence);
+    // 3 reintentos con pausa de recuperación del perfil (30ms en 80m)
+    int intento;
+    for (intento = 0; intento < 3; intento++) {
+        err = ds2482_1wire_reset(ds2482, &presence);
         if (err == ESP_OK && presence) break;
-        vTaskDelay(pdMS_TO_TICKS(30));
+        ds2482_stats_reintento(ds2482);
+        ds2482_pausa_us(ds2482->tiempos.reintento_us);
     }
 
     if (err != ESP_OK || !presence) {
@@ -42,21 +52,78 @@ esp_err_t ds2431_match_rom(ds2482_t *ds2482, ds2431_t *dev) {
         return ESP_ERR_NOT_FOUND;
     }
 
-    err = ds2482_write_byte(OW_CMD_MATCH_ROM);
-    if (err != ESP_OK) return err;
-
-    uint8_t *rom_bytes = (uint8_t *)&dev->rom_code;
-    for (int i = 0; i < 8; i++) {
-        err = ds2482_write_byte(rom_bytes[i]);
+#if CONFIG_DS2431_RESUME
+    if (intento == 0 && ds2482_rom_es_activa(ds2482, dev->rom_code)) {
+        err = ds2482_write_byte(ds2482, OW_CMD_RESUME);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error enviando ROM byte %d", i);
-            return err;
+            ds2482_rom_olvidar(ds2482);
+            ESP_LOGE(TAG, "Error enviando Resume");
         }
+        return err;
+    }
+#endif
+
+    // Comando + 8 bytes de ROM en un solo bloque
+    uint8_t match[9] = { OW_CMD_MATCH_ROM };
+    memcpy(&match[1], &dev->rom_code, 8);
+    err = ds2482_write_bytes(ds2482, match, sizeof(match));
+    if (err != ESP_OK) {
+        ds2482_rom_olvidar(ds2482);
+        ESP_LOGE(TAG, "Error enviando Match ROM");
+        return err;
     }
 
+    ds2482_rom_recordar(ds2482, dev->rom_code);
+    return ESP_OK;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Overdrive Skip / Match ROM
+// El byte de comando se envía a velocidad estándar; lo que sigue (la ROM en
+// el Match, y todo el tráfico posterior) va en overdrive.
+// ─────────────────────────────────────────────────────────────────────────────
+static esp_err_t overdrive_comando(ds2482_t *ds2482, uint8_t cmd) {
+    uint8_t config = ds2482->config & ~DS2482_CFG_1WS;
+    esp_err_t err = ds2482_configure(ds2482, config);
+    if (err != ESP_OK) return err;
+
+    bool presence = false;
+    err = ds2482_1wire_reset(ds2482, &presence);
+    if (err != ESP_OK) return err;
+    if (!presence) return ESP_ERR_NOT_FOUND;
+
+    err = ds2482_write_byte(ds2482, cmd);
+    if (err != ESP_OK) return err;
+    return ds2482_configure(ds2482, config | DS2482_CFG_1WS);
+}
+
+esp_err_t ds2431_overdrive_match(ds2482_t *ds2482, ds2431_t *dev) {
+    ds2482_rom_olvidar(ds2482);
+    esp_err_t err = overdrive_comando(ds2482, OW_CMD_OVERDRIVE_MATCH);
+    if (err != ESP_OK) return err;
+
+    err = ds2482_write_bytes(ds2482, (const uint8_t *)&dev->rom_code, 8);
+    if (err != ESP_OK) return err;
+
+    ds2482_rom_recordar(ds2482, dev->rom_code);
     return ESP_OK;
 }
 
+esp_err_t ds2431_overdrive_skip(ds2482_t *ds2482) {
+    // Skip ROM limpia el flag RC de todos los esclavos
+    ds2482_rom_olvidar(ds2482);
+    return overdrive_comando(ds2482, OW_CMD_OVERDRIVE_SKIP);
+}
+
+esp_err_t ds2431_velocidad_estandar(ds2482_t *ds2482) {
+    esp_err_t err = ds2482_configure(ds2482, ds2482->config & ~DS2482_CFG_1WS);
+    if (err != ESP_OK) return err;
+
+    // Un reset a velocidad estándar saca de overdrive a todos los esclavos
+    bool presence;
+    return ds2482_1wire_reset(ds2482, &presence);
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
 // Write Scratchpad
 // ─────────────────────────────────────────────────────────────────────────────
@@ -70,19 +137,28 @@ esp_err_t ds2431_write_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
     esp_err_t err = ds2431_match_rom(ds2482, dev);
     if (err != ESP_OK) return err;
 
-    err = ds2482_write_byte(DS2431_CMD_WRITE_SCRATCHPAD);
-    if (err != ESP_OK) return err;
-
-    err = ds2482_write_byte((uint8_t)(addr & 0xFF));
-    if (err != ESP_OK) return err;
-    err = ds2482_write_byte((uint8_t)(addr >> 8));
-    if (err != ESP_OK) return err;
+    uint8_t cmd[3 + 8] = {
+        DS2431_CMD_WRITE_SCRATCHPAD, (uint8_t)(addr & 0xFF), (uint8_t)(addr >> 8)
+    };
+    memcpy(&cmd[3], data, len);
+    err = ds2482_write_bytes(ds2482, cmd, 3 + len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error escribiendo scratchpad @ 0x%02X", addr);
+        return err;
+    }
 
-    for (size_t i = 0; i < len; i++) {
-        err = ds2482_write_byte(data[i]);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error escribiendo byte %d en scratchpad", i);
-            return err;
+    // Si la escritura llega al fin de la fila, el DS2431 contesta con el
+    // CRC-16 invertido de comando + dirección + datos tal como los recibió
+    if ((addr & 0x07) + len == 8) {
+        uint8_t rx[2];
+        err = ds2482_read_bytes(ds2482, rx, sizeof(rx));
+        if (err != ESP_OK) return err;
+        uint16_t esperado = (uint16_t)~crc16_ow(cmd, 3 + len);
+        uint16_t recibido = (uint16_t)rx[0] | ((uint16_t)rx[1] << 8);
+        if (recibido != esperado) {
+            ESP_LOGW(TAG, "Write Scratchpad @ 0x%02X: CRC 0x%04X, esperado 0x%04X",
+                     addr, recibido, esperado);
+            return ESP_ERR_INVALID_CRC;
         }
     }
 
@@ -93,27 +169,26 @@ esp_err_t ds2431_write_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
 // ─────────────────────────────────────────────────────────────────────────────
 // Read Scratchpad
 // ─────────────────────────────────────────────────────────────────────────────
-esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
-                                  uint16_t *addr_es, uint8_t *data, size_t len) {
+esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev, uint16_t *addr_es,
+                                  uint8_t *es_byte, uint8_t *data, size_t len) {
     esp_err_t err = ds2431_match_rom(ds2482, dev);
     if (err != ESP_OK) return err;
 
-    err = ds2482_write_byte(DS2431_CMD_READ_SCRATCHPAD);
+    err = ds2482_write_byte(ds2482, DS2431_CMD_READ_SCRATCHPAD);
     if (err != ESP_OK) return err;
 
-    uint8_t ta1, ta2, es;
-    err = ds2482_read_byte(&ta1); if (err != ESP_OK) return err;
-    err = ds2482_read_byte(&ta2); if (err != ESP_OK) return err;
-    err = ds2482_read_byte(&es);  if (err != ESP_OK) return err;
+    uint8_t hdr[3];
+    err = ds2482_read_bytes(ds2482, hdr, sizeof(hdr));
+    if (err != ESP_OK) return err;
+    uint8_t ta1 = hdr[0], ta2 = hdr[1], es = hdr[2];
 
     if (addr_es) *addr_es = (uint16_t)ta1 | ((uint16_t)ta2 << 8);
+    if (es_byte) *es_byte = es;
 
-    for (size_t i = 0; i < len; i++) {
-        err = ds2482_read_byte(&data[i]);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error leyendo scratchpad byte %d", i);
-            return err;
-        }
+    err = ds2482_read_bytes(ds2482, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error leyendo scratchpad");
+        return err;
     }
 
     ESP_LOGD(TAG, "Read Scratchpad OK: TA1=0x%02X TA2=0x%02X ES=0x%02X", ta1, ta2, es);
@@ -128,18 +203,42 @@ esp_err_t ds2431_copy_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
     esp_err_t err = ds2431_match_rom(ds2482, dev);
     if (err != ESP_OK) return err;
 
-    err = ds2482_write_byte(DS2431_CMD_COPY_SCRATCHPAD);
+    uint8_t cmd[3] = {
+        DS2431_CMD_COPY_SCRATCHPAD, (uint8_t)(addr & 0xFF), (uint8_t)(addr >> 8)
+    };
+    err = ds2482_write_bytes(ds2482, cmd, sizeof(cmd));
     if (err != ESP_OK) return err;
 
-    err = ds2482_write_byte((uint8_t)(addr & 0xFF)); if (err != ESP_OK) return err;
-    err = ds2482_write_byte((uint8_t)(addr >> 8));   if (err != ESP_OK) return err;
-    err = ds2482_write_byte(es_byte);                if (err != ESP_OK) return err;
-
-    ESP_LOGI(TAG, "Copy Scratchpad addr=0x%02X es=0x%02X — iniciando polling", addr, es_byte);
-    // Espera pasiva: 15ms cubre el máx del DS2431 con margen para ambiente ruidoso
-    vTaskDelay(pdMS_TO_TICKS(15));
+    // El E/S cierra el comando y arranca la programación: va con Strong
+    // Pullup para que el esclavo no dependa del APU durante tPROG
+    err = ds2482_write_byte_spu(ds2482, es_byte);
+    if (err != ESP_OK) return err;
+    int64_t t0 = esp_timer_get_time();
+    ds2482_pausa_us(COPY_SPU_US);
+
+    // Ningún time slot mientras programa: el primero corta el Strong Pullup.
+    // Pasado tPROG máx. la lectura solo confirma el resultado (0xAA/0x55
+    // alternados; 0xFF si el esclavo todavía no terminó).
+    uint8_t fin = 0xFF;
+    uint32_t us = 0;
+    do {
+        err = ds2482_read_byte(ds2482, &fin);
+        if (err != ESP_OK) return err;
+        us = (uint32_t)(esp_timer_get_time() - t0);
+    } while (fin == 0xFF && us < DS2431_COPY_TIMEOUT_US);
 
-    return ESP_OK;
+    if (fin == 0xAA || fin == 0x55) {
+        ESP_LOGD(TAG, "Copy Scratchpad addr=0x%02X es=0x%02X OK en %lu us",
+                 addr, es_byte, (unsigned long)us);
+        return ESP_OK;
+    }
+    if (fin == 0xFF) {
+        ESP_LOGE(TAG, "Copy Scratchpad addr=0x%02X sin confirmar en %lu us",
+                 addr, (unsigned long)us);
+        return ESP_ERR_TIMEOUT;
+    }
+    ESP_LOGE(TAG, "Copy Scratchpad addr=0x%02X: fin inválido 0x%02X", addr, fin);
+    return ESP_ERR_INVALID_RESPONSE;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -147,178 +246,567 @@ esp_err_t ds2431_copy_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
 // ─────────────────────────────────────────────────────────────────────────────
 esp_err_t ds2431_read_memory(ds2482_t *ds2482, ds2431_t *dev,
                               uint16_t addr, uint8_t *data, size_t len) {
+    ds2482_stats_t antes, despues;
+    ds2482_stats_obtener(ds2482, &antes);
+
     esp_err_t err = ds2431_match_rom(ds2482, dev);
     if (err != ESP_OK) return err;
 
-    err = ds2482_write_byte(DS2431_CMD_READ_MEMORY);
+    uint8_t cmd[3] = { DS2431_CMD_READ_MEMORY, (uint8_t)(addr & 0xFF), (uint8_t)(addr >> 8) };
+    err = ds2482_write_bytes(ds2482, cmd, sizeof(cmd));
     if (err != ESP_OK) return err;
 
-    err = ds2482_write_byte((uint8_t)(addr & 0xFF)); if (err != ESP_OK) return err;
-    err = ds2482_write_byte((uint8_t)(addr >> 8));   if (err != ESP_OK) return err;
-
-    for (size_t i = 0; i < len; i++) {
-        err = ds2482_read_byte(&data[i]);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error leyendo memoria byte %d", i);
-            return err;
-        }
+    err = ds2482_read_bytes(ds2482, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error leyendo memoria @ 0x%02X (%d bytes)", addr, len);
+        return err;
     }
 
+    ds2482_stats_obtener(ds2482, &despues);
+    ESP_LOGD(TAG, "Read Memory %d bytes: %lu transacciones I2C", len,
+             (unsigned long)(despues.i2c_transacciones - antes.i2c_transacciones));
     return ESP_OK;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// API alto nivel: escribir datos IDJ v2 (jaula + dolly opcional)
-// Nota: el maestro normalmente NO escribe EEPROM, pero se mantiene
-// sincronizado con el programador por si se requiere en el futuro.
-// Tiempos extendidos para cable de 80m.
+// Confirmación de presencia para el censo incremental
+// Match ROM + Read Memory de 1 byte: ~13 operaciones de byte contra los 64
+// triplets de una pasada de búsqueda. El factory byte siempre vale 0xAA/0x55,
+// así que también distingue esclavos vírgenes de un bus sin respuesta (0xFF).
 // ─────────────────────────────────────────────────────────────────────────────
-esp_err_t ds2431_escribir_datos(ds2482_t *ds2482, ds2431_t *dev,
-                                 const ds2431_data_t *datos) {
-    uint8_t buf[DS2431_EEPROM_BUF_LEN];
-    memset(buf, 0x00, sizeof(buf));
-
-    // Magic
-    buf[DS2431_ADDR_MAGIC]     = DS2431_MAGIC_BYTE0;
-    buf[DS2431_ADDR_MAGIC + 1] = DS2431_MAGIC_BYTE1;
-
-    // Jaula
-    buf[DS2431_ADDR_JAULA]     = (uint8_t)(datos->numero_jaula & 0xFF);
-    buf[DS2431_ADDR_JAULA + 1] = (uint8_t)(datos->numero_jaula >> 8);
-    memcpy(&buf[DS2431_ADDR_UNIDAD_JAULA], datos->unidad_jaula, 12);
-
-    // Dolly
-    buf[DS2431_ADDR_DOLLY]     = (uint8_t)(datos->numero_dolly & 0xFF);
-    buf[DS2431_ADDR_DOLLY + 1] = (uint8_t)(datos->numero_dolly >> 8);
-    if (datos->tiene_dolly && datos->numero_dolly > 0) {
-        memcpy(&buf[DS2431_ADDR_UNIDAD_DOLLY], datos->unidad_dolly, 12);
-    }
+esp_err_t ds2431_confirmar_presencia(ds2482_t *ds2482, uint64_t rom, bool *presente) {
+    // Otras familias no tienen factory byte: verificación genérica por árbol
+    if ((uint8_t)(rom & 0xFF) != DS2431_FAMILY_CODE) return ds2482_verificar_rom(ds2482, rom, presente);
+
+    *presente = false;
+
+    bool presence = false;
+    esp_err_t err = ds2482_1wire_reset(ds2482, &presence);
+    if (err != ESP_OK) return err;
+    if (!presence) return ESP_OK;
+
+    uint8_t cmd[12] = { OW_CMD_MATCH_ROM };
+    memcpy(&cmd[1], &rom, 8);
+    cmd[9]  = DS2431_CMD_READ_MEMORY;
+    cmd[10] = (uint8_t)(DS2431_ADDR_FACTORY_BYTE & 0xFF);
+    cmd[11] = (uint8_t)(DS2431_ADDR_FACTORY_BYTE >> 8);
+    err = ds2482_write_bytes(ds2482, cmd, sizeof(cmd));
+    if (err != ESP_OK) return err;
+
+    uint8_t factory;
+    err = ds2482_read_byte(ds2482, &factory);
+    if (err != ESP_OK) return err;
+
+    *presente = (factory == 0xAA || factory == 0x55);
+    // El Match ROM de arriba deja a este esclavo listo para un Resume
+    if (*presente) ds2482_rom_recordar(ds2482, rom);
+    else           ds2482_rom_olvidar(ds2482);
+    return ESP_OK;
+}
+
+static uint16_t leer_u16(const uint8_t *p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t leer_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8)
+         | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void poner_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Códigos de unidad: salen del número, v3 ya no los guarda
+// ─────────────────────────────────────────────────────────────────────────────
+void ds2431_generar_unidad_jaula(uint16_t jaula, char *out) {
+    snprintf(out, 12, "T0603-%04d", jaula);
+}
+
+void ds2431_generar_unidad_dolly(uint16_t dolly, char *out) {
+    snprintf(out, 12, "T0605-%04d", dolly);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Imagen IDJ v3 de la EEPROM (40 bytes = 5 bloques de 8, registro en 0–1)
+// ─────────────────────────────────────────────────────────────────────────────
+void ds2431_armar_imagen(const ds2431_data_t *datos, uint8_t *buf) {
+    memset(buf, 0x00, DS2431_EEPROM_BUF_LEN);
+
+    // Magic y versión
+    buf[DS2431_ADDR_MAGIC]   = DS2431_MAGIC_BYTE0;
+    buf[DS2431_ADDR_VERSION] = DS2431_VERSION_V3;
+
+    // Jaula y dolly (0 = sin dolly)
+    poner_u16(&buf[DS2431_ADDR_JAULA], datos->numero_jaula);
+    poner_u16(&buf[DS2431_V3_ADDR_DOLLY], datos->tiene_dolly ? datos->numero_dolly : 0);
 
     // Timestamp
-    buf[DS2431_ADDR_TIMESTAMP]     = (uint8_t)(datos->timestamp & 0xFF);
-    buf[DS2431_ADDR_TIMESTAMP + 1] = (uint8_t)((datos->timestamp >> 8)  & 0xFF);
-    buf[DS2431_ADDR_TIMESTAMP + 2] = (uint8_t)((datos->timestamp >> 16) & 0xFF);
-    buf[DS2431_ADDR_TIMESTAMP + 3] = (uint8_t)((datos->timestamp >> 24) & 0xFF);
-
-    // CRC-16 sobre 36 bytes (0x00–0x23)
-    uint16_t crc = ds2431_crc16(buf, DS2431_CRC_DATA_LEN);
-    buf[DS2431_ADDR_CRC16]     = (uint8_t)(crc & 0xFF);
-    buf[DS2431_ADDR_CRC16 + 1] = (uint8_t)(crc >> 8);
-
-    // Escribir 5 bloques de 8 bytes con tiempos extendidos para 80m
-    size_t pos = 0;
-    while (pos < DS2431_EEPROM_BUF_LEN) {
-        uint16_t addr = (uint16_t)pos;
-
-        // Reset del bridge — 15ms para bus de 80m
-        ds2482_1wire_reset(&(bool){false});
-        vTaskDelay(pdMS_TO_TICKS(15));
-
-        esp_err_t err = ds2431_write_scratchpad(ds2482, dev, addr, &buf[pos], 8);
-        if (err != ESP_OK) return err;
+    buf[DS2431_V3_ADDR_TIMESTAMP]     = (uint8_t)(datos->timestamp & 0xFF);
+    buf[DS2431_V3_ADDR_TIMESTAMP + 1] = (uint8_t)((datos->timestamp >> 8)  & 0xFF);
+    buf[DS2431_V3_ADDR_TIMESTAMP + 2] = (uint8_t)((datos->timestamp >> 16) & 0xFF);
+    buf[DS2431_V3_ADDR_TIMESTAMP + 3] = (uint8_t)((datos->timestamp >> 24) & 0xFF);
 
-        // Verificar scratchpad
-        uint8_t ta1, ta2, es_byte;
-        uint8_t verify[8];
-        err = ds2431_match_rom(ds2482, dev);
-        if (err != ESP_OK) return err;
-        err = ds2482_write_byte(DS2431_CMD_READ_SCRATCHPAD);
+    // CRC-16 sobre 10 bytes (0x00–0x09)
+    poner_u16(&buf[DS2431_V3_ADDR_CRC16], ds2431_crc16(buf, DS2431_V3_CRC_DATA_LEN));
+}
+
+// Un bloque de 8 bytes: Write Scratchpad, verificación y Copy, con las
+// pausas del perfil del cable
+static esp_err_t escribir_bloque(ds2482_t *ds2482, ds2431_t *dev, uint16_t addr,
+                                 const uint8_t *bloque) {
+    // Reset del bridge — 15ms para bus de 80m
+    ds2482_1wire_reset(ds2482, &(bool){false});
+    ds2482_pausa_us(ds2482->tiempos.pre_bloque_us);
+
+    // Con el CRC del Write Scratchpad bien, el scratchpad tiene la fila
+    // completa y el E/S es el offset final (7), sin PF ni AA
+    uint8_t es_byte = 0x07;
+    esp_err_t err = ds2431_write_scratchpad(ds2482, dev, addr, bloque, 8);
+    if (err == ESP_ERR_INVALID_CRC) {
+        // El CRC no distingue si se corrompió la escritura o la respuesta:
+        // se relee el scratchpad y decide la comparación
+        ds2482_stats_crc_fallo(ds2482);
+        uint8_t  verify[8];
+        uint16_t ta;
+        err = ds2431_read_scratchpad(ds2482, dev, &ta, &es_byte, verify, sizeof(verify));
         if (err != ESP_OK) return err;
-        err = ds2482_read_byte(&ta1);     if (err != ESP_OK) return err;
-        err = ds2482_read_byte(&ta2);     if (err != ESP_OK) return err;
-        err = ds2482_read_byte(&es_byte); if (err != ESP_OK) return err;
-        for (int i = 0; i < 8; i++) {
-            err = ds2482_read_byte(&verify[i]);
-            if (err != ESP_OK) return err;
-        }
 
-        if (memcmp(&buf[pos], verify, 8) != 0) {
+        if (ta != addr || memcmp(bloque, verify, 8) != 0) {
             ESP_LOGE(TAG, "Validación scratchpad falló en 0x%02X", addr);
+            ds2482_rom_olvidar(ds2482);
             return ESP_ERR_INVALID_RESPONSE;
         }
+    } else if (err != ESP_OK) {
+        return err;
+    }
 
-        // 20ms antes del copy — margen extra para bus largo
-        vTaskDelay(pdMS_TO_TICKS(20));
+    // 20ms antes del copy — margen extra para bus largo
+    ds2482_pausa_us(ds2482->tiempos.pre_copy_us);
 
-        err = ds2431_copy_scratchpad(ds2482, dev, addr, es_byte);
+    err = ds2431_copy_scratchpad(ds2482, dev, addr, es_byte);
+    if (err != ESP_OK) return err;
+
+    // El Copy vuelve con la programación confirmada: el bloque siguiente
+    // arranca sin pausa de recovery
+    ESP_LOGI(TAG, "Bloque 0x%02X grabado OK", addr);
+    return ESP_OK;
+}
+
+// Graba los bloques de DS2431_BLOQUES_V3 que difieren de `actual` (todos si
+// es NULL), de mayor a menor: primero se anulan las huellas viejas (4 y 2) y
+// el registro v3 va al final. Una escritura cortada a mitad deja un CRC que
+// no cierra, nunca una huella vieja que siga coincidiendo.
+static esp_err_t escribir_imagen(ds2482_t *ds2482, ds2431_t *dev, const uint8_t *buf,
+                                 const uint8_t *actual, uint8_t *escritos) {
+    if (escritos) *escritos = 0;
+    for (int b = DS2431_BLOQUES - 1; b >= 0; b--) {
+        if (!(DS2431_BLOQUES_V3 & (1 << b))) continue;
+        uint16_t addr = (uint16_t)(b * 8);
+        if (actual && memcmp(&actual[addr], &buf[addr], 8) == 0) continue;
+        esp_err_t err = escribir_bloque(ds2482, dev, addr, &buf[addr]);
         if (err != ESP_OK) return err;
+        if (escritos) *escritos |= (uint8_t)(1 << b);
+    }
+    return ESP_OK;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// API alto nivel: escribir datos IDJ v3 (jaula + dolly opcional)
+// Nota: el maestro normalmente NO escribe EEPROM, pero se mantiene
+// sincronizado con el programador por si se requiere en el futuro.
+// Tiempos extendidos para cable de 80m.
+// ─────────────────────────────────────────────────────────────────────────────
+esp_err_t ds2431_escribir_datos(ds2482_t *ds2482, ds2431_t *dev,
+                                 const ds2431_data_t *datos) {
+    uint8_t buf[DS2431_EEPROM_BUF_LEN];
+    ds2431_armar_imagen(datos, buf);
+    return escribir_imagen(ds2482, dev, buf, NULL, NULL);
+}
 
-        ESP_LOGI(TAG, "Bloque 0x%02X grabado OK", addr);
-        pos += 8;
-        // 40ms entre bloques: enfriamiento EEPROM + recovery bus 80m
-        vTaskDelay(pdMS_TO_TICKS(40));
+// ─────────────────────────────────────────────────────────────────────────────
+// Escritura diferencial: solo los bloques que difieren de la imagen actual.
+// Reprogramar los mismos datos no graba nada y pasar de v2 a v3 graba los
+// bloques 0–2 y 4 una sola vez. La imagen actual la puede pasar quien ya la
+// leyó; si no, se lee acá (una lectura de 40 bytes cuesta menos que un
+// bloque), y si esa lectura falla se graban todos.
+// ─────────────────────────────────────────────────────────────────────────────
+esp_err_t ds2431_escribir_datos_diff(ds2482_t *ds2482, ds2431_t *dev,
+                                      const ds2431_data_t *datos, const uint8_t *actual,
+                                      uint8_t *escritos) {
+    uint8_t buf[DS2431_EEPROM_BUF_LEN];
+    uint8_t leido[DS2431_EEPROM_BUF_LEN];
+    ds2431_armar_imagen(datos, buf);
+
+    if (!actual) {
+        if (ds2431_read_memory(ds2482, dev, 0x00, leido, sizeof(leido)) == ESP_OK) {
+            actual = leido;
+        } else {
+            ESP_LOGW(TAG, "Sin imagen actual de la EEPROM — se graban todos los bloques");
+        }
     }
 
+    uint8_t mascara = 0;
+    esp_err_t err = escribir_imagen(ds2482, dev, buf, actual, &mascara);
+    if (escritos) *escritos = mascara;
+    if (err != ESP_OK) return err;
+
+    ESP_LOGI(TAG, "Escritura diferencial: %d de %d bloques",
+             __builtin_popcount(mascara), __builtin_popcount(DS2431_BLOQUES_V3));
     return ESP_OK;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// API alto nivel: leer y validar datos IDJ v2
+// API alto nivel: leer y validar datos IDJ (v1, v2 o v3)
 //
-// Detecta formato antiguo v1 (CRC en 0x14) e informa que requiere
-// reprogramación con el IDJ Programador actualizado.
+// v3 se reconoce por el byte de versión en 0x01; v1 y v2 comparten el magic
+// 'I','D' y se distinguen por cuál de los dos CRC cierra. v1 no tiene dolly.
 // ─────────────────────────────────────────────────────────────────────────────
-esp_err_t ds2431_leer_datos(ds2482_t *ds2482, ds2431_t *dev,
-                             ds2431_data_t *datos) {
-    uint8_t buf[DS2431_EEPROM_BUF_LEN];
-    memset(datos, 0, sizeof(ds2431_data_t));
+uint8_t ds2431_version_imagen(const uint8_t *buf) {
+    if (buf[0] != DS2431_MAGIC_BYTE0) return 0;
 
-    esp_err_t err = ds2431_read_memory(ds2482, dev, 0x00, buf, DS2431_EEPROM_BUF_LEN);
+    if (buf[1] == DS2431_VERSION_V3) {
+        return leer_u16(&buf[DS2431_V3_ADDR_CRC16]) == ds2431_crc16(buf, DS2431_V3_CRC_DATA_LEN)
+             ? DS2431_VERSION_V3 : 0;
+    }
+    if (buf[1] != DS2431_MAGIC_BYTE1) return 0;
+    if (leer_u16(&buf[DS2431_ADDR_CRC16]) == ds2431_crc16(buf, DS2431_CRC_DATA_LEN)) {
+        return DS2431_VERSION_V2;
+    }
+    if (leer_u16(&buf[DS2431_V1_ADDR_CRC16]) == ds2431_crc16(buf, DS2431_V1_CRC_DATA_LEN)) {
+        return DS2431_VERSION_V1;
+    }
+    return 0;
+}
+
+// Registro desde 0x00 en un solo Read Memory: con los 12 bytes de v3 alcanza;
+// si el magic es de v1/v2 se sigue leyendo hasta DS2431_EEPROM_BUF_LEN sin
+// volver a direccionar al esclavo
+static esp_err_t leer_registro(ds2482_t *ds2482, ds2431_t *dev, uint8_t *buf) {
+    esp_err_t err = ds2431_read_memory(ds2482, dev, 0x00, buf, DS2431_V3_LEN);
     if (err != ESP_OK) return err;
+    if (buf[0] != DS2431_MAGIC_BYTE0 || buf[1] != DS2431_MAGIC_BYTE1) return ESP_OK;
+
+    err = ds2482_read_bytes(ds2482, &buf[DS2431_V3_LEN], DS2431_EEPROM_BUF_LEN - DS2431_V3_LEN);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Error leyendo el resto del registro v1/v2");
+    return err;
+}
+
+// Valida y decodifica el registro leído por leer_registro()
+static esp_err_t parsear_datos(ds2482_t *ds2482, const uint8_t *buf, ds2431_data_t *datos) {
+    memset(datos, 0, sizeof(ds2431_data_t));
 
     // Verificar magic
-    if (buf[0] != DS2431_MAGIC_BYTE0 || buf[1] != DS2431_MAGIC_BYTE1) {
+    if (buf[0] != DS2431_MAGIC_BYTE0
+        || (buf[1] != DS2431_MAGIC_BYTE1 && buf[1] != DS2431_VERSION_V3)) {
         ESP_LOGW(TAG, "EEPROM virgen (magic=0x%02X%02X)", buf[0], buf[1]);
         datos->valido = false;
         return ESP_OK;
     }
 
-    // Verificar CRC v2 (36 bytes, CRC en 0x24)
-    uint16_t crc_leido     = (uint16_t)buf[DS2431_ADDR_CRC16]
-                           | ((uint16_t)buf[DS2431_ADDR_CRC16 + 1] << 8);
-    uint16_t crc_calculado = ds2431_crc16(buf, DS2431_CRC_DATA_LEN);
-
-    if (crc_leido != crc_calculado) {
-        // Detectar si es formato antiguo v1 (CRC sobre 20 bytes en 0x14)
-        uint16_t crc_v1_leido     = (uint16_t)buf[0x14] | ((uint16_t)buf[0x15] << 8);
-        uint16_t crc_v1_calculado = ds2431_crc16(buf, 20);
-
-        if (crc_v1_leido == crc_v1_calculado) {
-            ESP_LOGW(TAG, "EEPROM con formato ANTIGUO (v1) — esclavo requiere reprogramación");
-        } else {
-            ESP_LOGE(TAG, "CRC inválido: leído=0x%04X calculado=0x%04X — datos corruptos",
-                     crc_leido, crc_calculado);
-        }
+    uint8_t version = ds2431_version_imagen(buf);
+    if (version == 0) {
+        ESP_LOGE(TAG, "CRC inválido (magic=0x%02X%02X) — datos corruptos", buf[0], buf[1]);
+        ds2482_stats_crc_fallo(ds2482);
         datos->valido = false;
         return ESP_ERR_INVALID_CRC;
     }
 
-    // Parsear jaula
-    datos->numero_jaula = (uint16_t)buf[DS2431_ADDR_JAULA]
-                        | ((uint16_t)buf[DS2431_ADDR_JAULA + 1] << 8);
-    memcpy(datos->unidad_jaula, &buf[DS2431_ADDR_UNIDAD_JAULA], 12);
+    datos->numero_jaula = leer_u16(&buf[DS2431_ADDR_JAULA]);
+    switch (version) {
+    case DS2431_VERSION_V3:
+        datos->numero_dolly = leer_u16(&buf[DS2431_V3_ADDR_DOLLY]);
+        datos->timestamp    = leer_u32(&buf[DS2431_V3_ADDR_TIMESTAMP]);
+        ds2431_generar_unidad_jaula(datos->numero_jaula, datos->unidad_jaula);
+        if (datos->numero_dolly > 0) {
+            ds2431_generar_unidad_dolly(datos->numero_dolly, datos->unidad_dolly);
+        }
+        break;
+
+    case DS2431_VERSION_V2:
+        memcpy(datos->unidad_jaula, &buf[DS2431_ADDR_UNIDAD_JAULA], 12);
+        datos->numero_dolly = leer_u16(&buf[DS2431_ADDR_DOLLY]);
+        if (datos->numero_dolly > 0) {
+            memcpy(datos->unidad_dolly, &buf[DS2431_ADDR_UNIDAD_DOLLY], 12);
+        }
+        datos->timestamp = leer_u32(&buf[DS2431_ADDR_TIMESTAMP]);
+        break;
+
+    default:
+        memcpy(datos->unidad_jaula, &buf[DS2431_ADDR_UNIDAD_JAULA], 12);
+        datos->timestamp = leer_u32(&buf[DS2431_V1_ADDR_TIMESTAMP]);
+        break;
+    }
     datos->unidad_jaula[11] = '\0';
+    datos->unidad_dolly[11] = '\0';
+    datos->tiene_dolly = (datos->numero_dolly > 0);
+    datos->version     = version;
+    datos->valido      = true;
+
+    ESP_LOGI(TAG, "EEPROM OK (v%d) — Jaula #%d '%s' | Dolly %s", version,
+             datos->numero_jaula, datos->unidad_jaula,
+             datos->tiene_dolly ? datos->unidad_dolly : "N/A");
 
-    // Parsear dolly
-    datos->numero_dolly = (uint16_t)buf[DS2431_ADDR_DOLLY]
-                        | ((uint16_t)buf[DS2431_ADDR_DOLLY + 1] << 8);
-    datos->tiene_dolly  = (datos->numero_dolly > 0);
-    if (datos->tiene_dolly) {
-        memcpy(datos->unidad_dolly, &buf[DS2431_ADDR_UNIDAD_DOLLY], 12);
-        datos->unidad_dolly[11] = '\0';
+    return ESP_OK;
+}
+
+// Posición de timestamp + CRC según el formato
+static uint16_t addr_huella(uint8_t version) {
+    switch (version) {
+    case DS2431_VERSION_V3: return DS2431_V3_ADDR_TIMESTAMP;
+    case DS2431_VERSION_V1: return DS2431_V1_ADDR_TIMESTAMP;
+    default:                return DS2431_ADDR_TIMESTAMP;
     }
+}
 
-    // Parsear timestamp
-    datos->timestamp = (uint32_t)buf[DS2431_ADDR_TIMESTAMP]
-                     | ((uint32_t)buf[DS2431_ADDR_TIMESTAMP + 1] << 8)
-                     | ((uint32_t)buf[DS2431_ADDR_TIMESTAMP + 2] << 16)
-                     | ((uint32_t)buf[DS2431_ADDR_TIMESTAMP + 3] << 24);
+static void huella_de_buffer(const uint8_t *p, uint8_t version, ds2431_huella_t *huella) {
+    huella->timestamp = leer_u32(p);
+    huella->crc       = leer_u16(&p[4]);
+    huella->version   = version;
+}
 
-    datos->valido = true;
+esp_err_t ds2431_leer_huella(ds2482_t *ds2482, ds2431_t *dev, uint8_t version,
+                             ds2431_huella_t *huella) {
+    uint8_t buf[DS2431_HUELLA_LEN];
+    esp_err_t err = ds2431_read_memory(ds2482, dev, addr_huella(version), buf, sizeof(buf));
+    if (err != ESP_OK) return err;
+    huella_de_buffer(buf, version, huella);
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "EEPROM OK — Jaula #%d '%s' | Dolly %s",
-             datos->numero_jaula, datos->unidad_jaula,
-             datos->tiene_dolly ? datos->unidad_dolly : "N/A");
+esp_err_t ds2431_leer_datos(ds2482_t *ds2482, ds2431_t *dev,
+                             ds2431_data_t *datos) {
+    return ds2431_leer_datos_od(ds2482, NULL, dev, datos);
+}
 
+// ─────────────────────────────────────────────────────────────────────────────
+// Overdrive por ROM
+//
+// Una lectura en overdrive que no queda verificada se repite a velocidad
+// estándar, y solo se le cuenta el fallo a la ROM si ahí sí se verifica: un
+// esclavo ausente, una EEPROM virgen o una corrupta dan lo mismo a las dos
+// velocidades y no dicen nada del overdrive.
+// ─────────────────────────────────────────────────────────────────────────────
+// verificada: el contenido pasó un control (CRC o huella conocida). Una
+// EEPROM "virgen" no cuenta: en overdrive también puede ser magic corrupto.
+typedef esp_err_t (*lectura_fn_t)(ds2482_t *ds2482, ds2431_t *dev, void *ctx,
+                                  bool *verificada);
+
+void ds2431_od_init(ds2431_od_t *od, bool habilitado) {
+    memset(od, 0, sizeof(*od));
+    od->habilitado = habilitado;
+}
+
+ds2431_od_estado_t ds2431_od_estado(const ds2431_od_t *od, uint64_t rom) {
+    for (size_t i = 0; i < od->num_roms; i++) {
+        if (od->roms[i].rom == rom) return (ds2431_od_estado_t)od->roms[i].estado;
+    }
+    return DS2431_OD_DESCONOCIDO;
+}
+
+// Entrada de la ROM si hay que intentarla en overdrive; NULL si no
+static ds2431_od_rom_t *od_entrada(ds2431_od_t *od, uint64_t rom) {
+    if (od == NULL || !od->habilitado) return NULL;
+    for (size_t i = 0; i < od->num_roms; i++) {
+        if (od->roms[i].rom != rom) continue;
+        return (od->roms[i].estado == DS2431_OD_NO) ? NULL : &od->roms[i];
+    }
+    if (od->num_roms == DS2431_OD_MAX_ROMS) return NULL;   // tabla llena: estándar
+
+    ds2431_od_rom_t *e = &od->roms[od->num_roms++];
+    e->rom    = rom;
+    e->estado = DS2431_OD_DESCONOCIDO;
+    e->fallos = 0;
+    return e;
+}
+
+static esp_err_t con_overdrive(ds2482_t *ds2482, ds2431_od_t *od, ds2431_t *dev,
+                               lectura_fn_t leer, void *ctx) {
+    bool verificada = false;
+    ds2431_od_rom_t *e = od_entrada(od, dev->rom_code);
+    if (e == NULL) return leer(ds2482, dev, ctx, &verificada);
+
+    esp_err_t err = ds2431_overdrive_match(ds2482, dev);
+    if (err == ESP_OK) err = leer(ds2482, dev, ctx, &verificada);
+
+    // Siempre de vuelta a estándar: el resto del bus no está en overdrive
+    if (ds2431_velocidad_estandar(ds2482) != ESP_OK) {
+        ESP_LOGW(TAG, "No se pudo volver a velocidad estándar — reseteando bridge");
+        ds2482_reset(ds2482);
+        ds2482_configure(ds2482, DS2482_CFG_APU);
+    }
+
+    if (verificada) {
+        e->estado = DS2431_OD_OK;
+        e->fallos = 0;
+        od->lecturas_od++;
+        return err;
+    }
+
+    // Fallback inmediato a velocidad estándar con Match ROM completo
+    ds2482_rom_olvidar(ds2482);
+    od->fallbacks++;
+    esp_err_t err_std = leer(ds2482, dev, ctx, &verificada);
+    if (verificada) {
+        if (++e->fallos >= CONFIG_DS2431_OD_FALLOS_MAX) {
+            e->estado = DS2431_OD_NO;
+            ESP_LOGW(TAG, "%016llX: overdrive descartado tras %d fallos, queda a velocidad estándar",
+                     (unsigned long long)dev->rom_code, e->fallos);
+        } else {
+            ESP_LOGD(TAG, "%016llX: sin verificar en overdrive (%s), leída a velocidad estándar",
+                     (unsigned long long)dev->rom_code, esp_err_to_name(err));
+        }
+    }
+    return err_std;
+}
+
+static esp_err_t leer_datos_uno(ds2482_t *ds2482, ds2431_t *dev, void *ctx,
+                                bool *verificada) {
+    ds2431_data_t *datos = ctx;
+    uint8_t buf[DS2431_EEPROM_BUF_LEN];
+    memset(datos, 0, sizeof(ds2431_data_t));
+
+    esp_err_t err = leer_registro(ds2482, dev, buf);
+    if (err != ESP_OK) return err;
+    err = parsear_datos(ds2482, buf, datos);
+    *verificada = (err == ESP_OK && datos->valido);
+    return err;
+}
+
+esp_err_t ds2431_leer_datos_od(ds2482_t *ds2482, ds2431_od_t *od, ds2431_t *dev,
+                               ds2431_data_t *datos) {
+    return con_overdrive(ds2482, od, dev, leer_datos_uno, datos);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Lectura en lote
+//
+// Lee las ROMs una detrás de otra. La pausa entre esclavos se adapta al bus:
+// baja de a poco mientras las lecturas salen bien y se duplica ante un fallo
+// (hasta los 300 ms fijos que se usaban antes). Los que fallan se reintentan
+// en una pasada posterior, sin repetir los que ya se leyeron.
+// ─────────────────────────────────────────────────────────────────────────────
+#define LOTE_RECUP_INICIAL_US   2000
+#define LOTE_RECUP_FALLO_US     5000      // piso tras un fallo
+#define LOTE_RECUP_MAX_US       300000
+
+void ds2431_lote_init(ds2431_lote_t *lote) {
+    memset(lote, 0, sizeof(*lote));
+    lote->recuperacion_us = LOTE_RECUP_INICIAL_US;
+#if CONFIG_DS2431_OVERDRIVE
+    ds2431_od_init(&lote->od, true);
+#endif
+}
+
+// Huella (si la entrada la trae) y, si cambió, lectura completa
+static esp_err_t lote_leer_uno(ds2482_t *ds2482, ds2431_t *dev, void *ctx,
+                               bool *verificada) {
+    ds2431_lectura_t *l = ctx;
+    uint8_t buf[DS2431_EEPROM_BUF_LEN];
+    esp_err_t err = ESP_OK;
+
+    l->sin_cambios = false;
+    if (l->tiene_huella) {
+        ds2431_huella_t actual;
+        err = ds2431_leer_huella(ds2482, dev, l->huella.version, &actual);
+        l->sin_cambios = (err == ESP_OK)
+                      && actual.timestamp == l->huella.timestamp
+                      && actual.crc == l->huella.crc;
+    }
+    if (err == ESP_OK && !l->sin_cambios) {
+        err = leer_registro(ds2482, dev, buf);
+        if (err == ESP_OK) err = parsear_datos(ds2482, buf, &l->datos);
+        // La huella solo se actualiza con una lectura íntegra, y queda
+        // atada al formato leído
+        if (err == ESP_OK && l->datos.valido) {
+            uint8_t v = l->datos.version;
+            huella_de_buffer(&buf[addr_huella(v)], v, &l->huella);
+        }
+    }
+    *verificada = (err == ESP_OK && (l->sin_cambios || l->datos.valido));
+    return err;
+}
+
+esp_err_t ds2431_leer_lote(ds2482_t *ds2482, ds2431_lote_t *lote,
+                           ds2431_lectura_t *lecturas, size_t n) {
+    int64_t t_lote = esp_timer_get_time();
+    size_t pendientes = n;
+    bool primero = true;
+
+    lote->ultimo_ok          = 0;
+    lote->ultimo_sin_cambios = 0;
+    lote->ultimo_fallidos    = 0;
+    lote->ultimo_reintentos  = 0;
+    for (size_t i = 0; i < n; i++) {
+        lecturas[i].err         = ESP_ERR_NOT_FINISHED;
+        lecturas[i].sin_cambios = false;
+        lecturas[i].intentos    = 0;
+        lecturas[i].latencia_us = 0;
+        lecturas[i].bus_us      = 0;
+        lecturas[i].reintentos  = 0;
+        lecturas[i].crc_fallos  = 0;
+    }
+
+    for (int pasada = 0; pasada < DS2431_LOTE_PASADAS && pendientes > 0; pasada++) {
+        for (size_t i = 0; i < n; i++) {
+            ds2431_lectura_t *l = &lecturas[i];
+            if (l->err != ESP_ERR_NOT_FINISHED) continue;
+
+            if (!primero) ds2482_pausa_us(lote->recuperacion_us);
+            primero = false;
+
+            ds2431_t esclavo = { .rom_code = l->rom };
+
+            ds2482_stats_t antes;
+            ds2482_stats_obtener(ds2482, &antes);
+            int64_t t0 = esp_timer_get_time();
+            esp_err_t err = con_overdrive(ds2482, &lote->od, &esclavo,
+                                          lote_leer_uno, l);
+            l->latencia_us = (uint32_t)(esp_timer_get_time() - t0);
+            l->bus_us     += l->latencia_us;
+            l->intentos++;
+            // Lo que el driver contó durante este intento es de esta ROM
+            l->reintentos += (uint16_t)(ds2482->stats.reintentos - antes.reintentos);
+            l->crc_fallos += (uint16_t)(ds2482->stats.crc_fallos - antes.crc_fallos);
+            if (pasada > 0) lote->ultimo_reintentos++;
+
+            bool definitivo = (err == ESP_OK) || pasada + 1 == DS2431_LOTE_PASADAS;
+            if (err == ESP_OK) {
+                lote->recuperacion_us -= lote->recuperacion_us / 4;
+            } else {
+                // El reintento vuelve a direccionar con Match ROM completo
+                ds2482_rom_olvidar(ds2482);
+                if (!definitivo) {
+                    ds2482_stats_reintento(ds2482);
+                    l->reintentos++;
+                }
+                uint32_t r = lote->recuperacion_us * 2;
+                if (r < LOTE_RECUP_FALLO_US) r = LOTE_RECUP_FALLO_US;
+                lote->recuperacion_us = (r < LOTE_RECUP_MAX_US) ? r : LOTE_RECUP_MAX_US;
+                ESP_LOGD(TAG, "Lote: %016llX falló (%s) — recuperación %lu us",
+                         (unsigned long long)l->rom, esp_err_to_name(err),
+                         (unsigned long)lote->recuperacion_us);
+            }
+            if (definitivo) {
+                l->err = err;
+                pendientes--;
+                if (err == ESP_OK) lote->ultimo_ok++;
+                else               lote->ultimo_fallidos++;
+                if (l->sin_cambios) lote->ultimo_sin_cambios++;
+            }
+        }
+    }
+
+    lote->ultimo_total_us = (uint32_t)(esp_timer_get_time() - t_lote);
+    ESP_LOGI(TAG, "Lote EEPROM: %d esclavos en %lu ms (ok=%d sin_cambios=%d fallidos=%d reintentos=%d, recuperación %lu us)",
+             (int)n, (unsigned long)(lote->ultimo_total_us / 1000),
+             lote->ultimo_ok, lote->ultimo_sin_cambios, lote->ultimo_fallidos, lote->ultimo_reintentos,
+             (unsigned long)lote->recuperacion_us);
+    if (lote->od.habilitado) {
+        ESP_LOGI(TAG, "Lote EEPROM: overdrive %lu lecturas, %lu fallbacks a velocidad estándar (acumulado)",
+                 (unsigned long)lote->od.lecturas_od, (unsigned long)lote->od.fallbacks);
+    }
     return ESP_OK;
-}
\ No newline at end of file
+}
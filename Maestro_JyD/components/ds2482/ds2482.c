@@ -1,306 +1,845 @@
-#include "ds2482.h"
+#include "ds2482_priv.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "string.h"
 
+#if CONFIG_DS2482_BACKEND_SIM
+#include "ds2482_sim.h"
+#endif
+
 #define TAG "DS2482"
 
-static i2c_port_t g_i2c_num;
-static uint8_t g_i2c_addr;
-
-#define DS2482_CMD_DEVICE_RESET   0xF0
-#define DS2482_CMD_SET_READ_PTR   0xE1
-#define DS2482_CMD_WRITE_BYTE     0xA5
-#define DS2482_CMD_READ_BYTE      0x96
-#define DS2482_CMD_1WIRE_RESET    0xB4
-#define DS2482_CMD_1WIRE_SINGLE   0x87
-#define DS2482_CMD_1WIRE_TRIPLET  0x78
-
-#define DS2482_REG_STATUS         0xF0
-#define DS2482_STATUS_BUSY        0x01
-#define DS2482_STATUS_PPD         0x02
-#define DS2482_STATUS_SD          0x04
-#define DS2482_STATUS_LL          0x08
-#define DS2482_STATUS_RST         0x10
-#define DS2482_STATUS_SBR         0x20
-#define DS2482_STATUS_TSB         0x40
-#define DS2482_STATUS_DIR         0x80
+// Toda transacción I2C pasa por aquí para poder contarla
+static esp_err_t i2c_escribir(ds2482_t *dev, const uint8_t *buf, size_t len) {
+    dev->stats.i2c_transacciones++;
+#if CONFIG_DS2482_BACKEND_SIM
+    return ds2482_sim_escribir(dev->address, buf, len);
+#else
+    return i2c_master_write_to_device(dev->i2c_num, dev->address, buf, len, pdMS_TO_TICKS(100));
+#endif
+}
+
+static esp_err_t i2c_leer(ds2482_t *dev, uint8_t *buf, size_t len) {
+    dev->stats.i2c_transacciones++;
+#if CONFIG_DS2482_BACKEND_SIM
+    return ds2482_sim_leer(dev->address, buf, len);
+#else
+    return i2c_master_read_from_device(dev->i2c_num, dev->address, buf, len, pdMS_TO_TICKS(100));
+#endif
+}
+
+void ds2482_stats_obtener(const ds2482_t *dev, ds2482_stats_t *out) {
+    *out = dev->stats;
+}
+
+void ds2482_stats_reset(ds2482_t *dev) {
+    memset(&dev->stats, 0, sizeof(dev->stats));
+}
+
+void ds2482_stats_reintento(ds2482_t *dev) {
+    dev->stats.reintentos++;
+}
+
+void ds2482_stats_crc_fallo(ds2482_t *dev) {
+    dev->stats.crc_fallos++;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Perfil de tiempos del cable
+// Valores del nivel 0 en ms, los de siempre para 80 m. Se redondean a ticks
+// enteros igual que el vTaskDelay(pdMS_TO_TICKS(x)) que reemplazan; a
+// diferencia de aquel, ds2482_pausa_us() garantiza el tiempo completo.
+// ─────────────────────────────────────────────────────────────────────────────
+#define TICK_US  (portTICK_PERIOD_MS * 1000)
+#define PAUSA_NIVEL0_US(ms)  ((uint32_t)pdMS_TO_TICKS(ms) * TICK_US)
+
+void ds2482_tiempos_nivel(uint8_t nivel, ds2482_tiempos_t *out) {
+    static const ds2482_tiempos_t base = {
+        .post_reset_us    = PAUSA_NIVEL0_US(8),    // ~4-8 nF de cable
+        .post_search_us   = PAUSA_NIVEL0_US(20),   // esclavos decodifican 0xF0
+        .conflicto_us     = PAUSA_NIVEL0_US(50),   // bus capacitivo se estabiliza
+        .reintento_us     = PAUSA_NIVEL0_US(30),
+        .pre_bloque_us    = PAUSA_NIVEL0_US(15),
+        .pre_copy_us      = PAUSA_NIVEL0_US(20),
+    };
+    if (nivel >= DS2482_TIEMPOS_NIVELES - 1) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    out->post_reset_us    = base.post_reset_us    >> nivel;
+    out->post_search_us   = base.post_search_us   >> nivel;
+    out->conflicto_us     = base.conflicto_us     >> nivel;
+    out->reintento_us     = base.reintento_us     >> nivel;
+    out->pre_bloque_us    = base.pre_bloque_us    >> nivel;
+    out->pre_copy_us      = base.pre_copy_us      >> nivel;
+}
+
+void ds2482_tiempos_aplicar(ds2482_t *dev, uint8_t nivel) {
+    if (nivel >= DS2482_TIEMPOS_NIVELES) nivel = DS2482_TIEMPOS_NIVELES - 1;
+    ds2482_tiempos_nivel(nivel, &dev->tiempos);
+    dev->nivel = nivel;
+    // La vigilancia empieza una ventana nueva con el nivel nuevo
+    dev->vig_resets     = dev->hist[DS2482_OP_RESET].n;
+    dev->vig_reintentos = dev->stats.reintentos;
+}
+
+// Pausa mínima: vTaskDelay(n) vuelve en el n-ésimo flanco de tick, que puede
+// estar a casi nada si arranca justo antes de uno. Se duerme de a ticks que
+// entren en lo que falta hasta el plazo y el resto se completa en espera activa.
+void ds2482_pausa_us(uint32_t us) {
+    if (us == 0) return;
+    int64_t fin = esp_timer_get_time() + us;
+    int64_t restante = us;
+    while (restante >= TICK_US) {
+        vTaskDelay(restante / TICK_US);
+        restante = fin - esp_timer_get_time();
+    }
+    if (restante > 0) esp_rom_delay_us((uint32_t)restante);
+}
+
+bool ds2482_tiempos_vigilar(ds2482_t *dev) {
+    uint32_t resets     = dev->hist[DS2482_OP_RESET].n - dev->vig_resets;
+    uint32_t reintentos = dev->stats.reintentos - dev->vig_reintentos;
+    if (resets < DS2482_VIGILANCIA_RESETS) return false;
+
+    bool bajar = dev->nivel > 0 && reintentos * 100 > resets * CONFIG_DS2482_CALIB_ERRORES_PCT;
+    if (bajar) {
+        ESP_LOGW(TAG, "%lu reintentos en %lu resets — tiempos nivel %d → %d (0x%02X)",
+                 (unsigned long)reintentos, (unsigned long)resets,
+                 dev->nivel, dev->nivel - 1, dev->address);
+    }
+    ds2482_tiempos_aplicar(dev, bajar ? dev->nivel - 1 : dev->nivel);
+    return bajar;
+}
 
 esp_err_t ds2482_init(ds2482_t *dev, i2c_port_t i2c_num, uint8_t address) {
+    memset(dev, 0, sizeof(*dev));
     dev->i2c_num = i2c_num;
     dev->address = address;
-    g_i2c_num = i2c_num;    // <<-- agregar
-    g_i2c_addr = address;   // <<-- agregar
+    dev->canal   = DS2482_SIN_CANAL;
+    ds2482_tiempos_aplicar(dev, 0);
     return ds2482_reset(dev);
 }
 
+esp_err_t ds2482_800_init(ds2482_chip_t *chip, i2c_port_t i2c_num, uint8_t address) {
+    chip->i2c_num       = i2c_num;
+    chip->address       = address;
+    chip->canal_activo  = DS2482_SIN_CANAL;
+    chip->config_activa = 0;
+
+    ds2482_t canal0;
+    esp_err_t err = ds2482_800_canal(&canal0, chip, 0);
+    if (err != ESP_OK) return err;
+    return ds2482_reset(&canal0);
+}
+
+esp_err_t ds2482_800_canal(ds2482_t *dev, ds2482_chip_t *chip, uint8_t canal) {
+    if (canal >= DS2482_800_CANALES) return ESP_ERR_INVALID_ARG;
+    memset(dev, 0, sizeof(*dev));
+    dev->i2c_num = chip->i2c_num;
+    dev->address = chip->address;
+    dev->chip    = chip;
+    dev->canal   = canal;
+    ds2482_tiempos_aplicar(dev, 0);
+    return ESP_OK;
+}
+
 esp_err_t ds2482_reset(ds2482_t *dev) {
     uint8_t cmd = DS2482_CMD_DEVICE_RESET;
-    return i2c_master_write_to_device(dev->i2c_num, dev->address, &cmd, 1, pdMS_TO_TICKS(100));
+    esp_err_t err = i2c_escribir(dev, &cmd, 1);
+    if (err != ESP_OK) return err;
+    // El device reset deja la configuración en cero (APU/SPU/1WS apagados)
+    // y, en el -800, el canal 0 seleccionado
+    dev->config = 0;
+    ds2482_rom_olvidar(dev);
+    if (dev->chip) {
+        dev->chip->canal_activo  = 0;
+        dev->chip->config_activa = 0;
+    }
+    return ESP_OK;
 }
 
-esp_err_t ds2482_set_read_pointer(uint8_t reg) {
+esp_err_t ds2482_set_read_pointer(ds2482_t *dev, uint8_t reg) {
     uint8_t cmd[2] = { DS2482_CMD_SET_READ_PTR, reg };
-    return i2c_master_write_to_device(g_i2c_num, g_i2c_addr, cmd, 2, pdMS_TO_TICKS(100));
+    return i2c_escribir(dev, cmd, 2);
+}
+
+esp_err_t ds2482_read_register(ds2482_t *dev, uint8_t *value) {
+    return i2c_leer(dev, value, 1);
+}
+
+// Comando Write Configuration del DS2482
+#define DS2482_CMD_WRITE_CONFIG  0xD2
+
+// Escribe el registro de configuración y lo verifica
+static esp_err_t config_escribir(ds2482_t *dev, uint8_t config) {
+    // Construir el byte de configuración con complemento en nibble alto
+    uint8_t config_byte = DS2482_CFG_BYTE(config);
+
+    uint8_t buf[2] = { DS2482_CMD_WRITE_CONFIG, config_byte };
+
+    esp_err_t err = i2c_escribir(dev, buf, sizeof(buf));
+
+    if (err != ESP_OK) {
+        ESP_LOGE("DS2482", "Error escribiendo configuración: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Leer de vuelta el registro de configuración para verificar
+    // El DS2482 devuelve solo los 4 bits bajos si la escritura fue exitosa
+    uint8_t readback = 0;
+    err = ds2482_read_register(dev, &readback);
+    if (err != ESP_OK) return err;
+
+    if ((readback & 0x0F) != (config & 0x0F)) {
+        ESP_LOGE("DS2482", "Configuración rechazada por DS2482. Byte enviado: 0x%02X, recibido: 0x%02X",
+                 config_byte, readback);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (dev->chip) dev->chip->config_activa = config & 0x0F;
+    return ESP_OK;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Channel Select del DS2482-800
+//
+// El código que se escribe y el que se lee de vuelta son distintos por canal.
+// Tras el comando el read pointer queda en el registro de selección, así que
+// la verificación es una sola lectura. Solo se acepta con el 1-Wire libre.
+// ─────────────────────────────────────────────────────────────────────────────
+#define DS2482_CMD_CHANNEL_SELECT  0xC3
+
+static const uint8_t s_canal_codigo[DS2482_800_CANALES] = {
+    0xF0, 0xE1, 0xD2, 0xC3, 0xB4, 0xA5, 0x96, 0x87
+};
+static const uint8_t s_canal_lectura[DS2482_800_CANALES] = {
+    0xB8, 0xB1, 0xAA, 0xA3, 0x9C, 0x95, 0x8E, 0x87
+};
+
+static esp_err_t canal_conmutar(ds2482_t *dev) {
+    ds2482_chip_t *chip = dev->chip;
+    if (chip == NULL || chip->canal_activo == dev->canal) return ESP_OK;
+
+    uint8_t cmd[2] = { DS2482_CMD_CHANNEL_SELECT, s_canal_codigo[dev->canal] };
+    esp_err_t err = i2c_escribir(dev, cmd, sizeof(cmd));
+    if (err != ESP_OK) {
+        chip->canal_activo = DS2482_SIN_CANAL;
+        return err;
+    }
+
+    uint8_t leido = 0;
+    err = ds2482_read_register(dev, &leido);
+    if (err != ESP_OK) {
+        chip->canal_activo = DS2482_SIN_CANAL;
+        return err;
+    }
+    if (leido != s_canal_lectura[dev->canal]) {
+        ESP_LOGE(TAG, "Channel Select %d rechazado: leído 0x%02X", dev->canal, leido);
+        chip->canal_activo = DS2482_SIN_CANAL;
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    chip->canal_activo = dev->canal;
+    return ESP_OK;
 }
 
-esp_err_t ds2482_read_register(uint8_t *value) {
-    return i2c_master_read_from_device(g_i2c_num, g_i2c_addr, value, 1, pdMS_TO_TICKS(100));
+// Deja el chip apuntando a este segmento con su configuración
+static esp_err_t canal_seleccionar(ds2482_t *dev) {
+    esp_err_t err = canal_conmutar(dev);
+    if (err != ESP_OK) return err;
+    if (dev->chip && dev->chip->config_activa != dev->config) {
+        err = config_escribir(dev, dev->config);
+    }
+    return err;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Motor de espera adaptativo
+//
+// La duración de cada comando 1-Wire la fija el propio DS2482 (slots de ~69 µs
+// en estándar, ~10 µs en overdrive), así que se puede predecir: se espera lo
+// previsto con esp_rom_delay_us y recién ahí se consulta el status. Solo si la
+// espera supera un tick se cede la CPU al scheduler. Con el tick de 10 ms un
+// vTaskDelay por cada byte de ~600 µs costaba hasta 10 ms.
+//
+// Cada espera real (desde el comando hasta ver BUSY=0) alimenta un histograma
+// por tipo de comando para poder afinar instalaciones con cable largo.
+// ─────────────────────────────────────────────────────────────────────────────
+#define DS2482_ESPERA_SPIN_MAX_US 2000     // después de esto el polling cede CPU
+
+// Duración esperada de cada comando [op][velocidad: 0 = estándar, 1 = overdrive]
+static const uint16_t s_prediccion_us[DS2482_OP_NUM][2] = {
+    [DS2482_OP_RESET]   = { 1148, 146 },   // tRSTL + tRSTH
+    [DS2482_OP_WRITE]   = {  560,  84 },   // 8 slots
+    [DS2482_OP_READ]    = {  560,  84 },   // 8 slots
+    [DS2482_OP_TRIPLET] = {  210,  32 },   // 3 slots
+};
+
+static const char *const s_op_nombre[DS2482_OP_NUM] = {
+    [DS2482_OP_RESET]   = "reset",
+    [DS2482_OP_WRITE]   = "write",
+    [DS2482_OP_READ]    = "read",
+    [DS2482_OP_TRIPLET] = "triplet",
+};
+
+// Límites superiores (µs) de cada bin; el último bin es "el resto"
+static const uint16_t s_hist_limite_us[DS2482_HIST_BINS - 1] = {
+    50, 100, 200, 400, 800, 1600, 3200, 6400
+};
+
+uint32_t ds2482_prediccion_us(const ds2482_t *dev, ds2482_op_t op) {
+    return s_prediccion_us[op][(dev->config & DS2482_CFG_1WS) ? 1 : 0];
 }
 
-// Espera a que el DS2482 libere el bus 1-Wire.
-// Retorna ESP_FAIL inmediatamente si I2C falla — no loopea con bus muerto.
-esp_err_t ds2482_busy_wait() {
-    int intentos = 0;
+void ds2482_hist_registrar(ds2482_t *dev, ds2482_op_t op, uint32_t us) {
+    ds2482_hist_t *h = &dev->hist[op];
+    int bin = 0;
+    while (bin < DS2482_HIST_BINS - 1 && us >= s_hist_limite_us[bin]) bin++;
+    h->bins[bin]++;
+    h->n++;
+    h->total_us += us;
+    if (us > h->max_us) h->max_us = us;
+
+    // Todo comando 1-Wire completado pasa por acá, bloqueante o intercalado
+    dev->stats.busy_us += us;
+    if (op == DS2482_OP_RESET)   dev->stats.resets++;
+    if (op == DS2482_OP_TRIPLET) dev->stats.triplets++;
+}
+
+static esp_err_t leer_status(ds2482_t *dev, uint8_t *status) {
+    esp_err_t err = ds2482_set_read_pointer(dev, DS2482_REG_STATUS);
+    if (err != ESP_OK) return err;
+    return ds2482_read_register(dev, status);
+}
+
+// Espera a que termine un comando emitido en t_inicio. op < 0 = desconocido
+// (sin predicción ni histograma). Deja en *status el primer status sin BUSY.
+// Retorna el error I2C de inmediato — no loopea con bus muerto.
+static esp_err_t esperar_op(ds2482_t *dev, int op, int64_t t_inicio, uint8_t *status) {
+    uint32_t pred = (op >= 0) ? ds2482_prediccion_us(dev, (ds2482_op_t)op) : 0;
+
+    int64_t restante = t_inicio + pred - esp_timer_get_time();
+    if (restante >= DS2482_ESPERA_YIELD_US) {
+        vTaskDelay(restante / DS2482_ESPERA_YIELD_US);
+    } else if (restante > 0) {
+        esp_rom_delay_us((uint32_t)restante);
+    }
+
+    // Paso de polling: 1/8 de la duración prevista, acotado a 10–100 µs
+    uint32_t paso = pred / 8;
+    if (paso < 10)  paso = 10;
+    if (paso > 100) paso = 100;
+
     while (true) {
-        uint8_t status;
-        esp_err_t err = ds2482_set_read_pointer(DS2482_REG_STATUS);
-        if (err != ESP_OK) return err;
-        err = ds2482_read_register(&status);
+        esp_err_t err = leer_status(dev, status);
         if (err != ESP_OK) return err;
-        if (!(status & DS2482_STATUS_BUSY)) return ESP_OK;
-        vTaskDelay(pdMS_TO_TICKS(3));  // 3ms entre polls: reduce ruido I2C en bus capacitivo
-        if (++intentos >= 200) {
+
+        int64_t transcurrido = esp_timer_get_time() - t_inicio;
+        if (!(*status & DS2482_STATUS_BUSY)) {
+            if (op >= 0) ds2482_hist_registrar(dev, (ds2482_op_t)op, (uint32_t)transcurrido);
+            return ESP_OK;
+        }
+        if (transcurrido > DS2482_ESPERA_TIMEOUT_US) {
             ESP_LOGE(TAG, "busy_wait timeout — bus 1-Wire bloqueado");
+            dev->stats.busy_timeouts++;
             return ESP_ERR_TIMEOUT;
         }
+        if (transcurrido < (int64_t)pred * 4 + DS2482_ESPERA_SPIN_MAX_US) {
+            esp_rom_delay_us(paso);
+        } else {
+            vTaskDelay(1);
+        }
     }
 }
 
-esp_err_t ds2482_1wire_reset(bool *presence) {
-    uint8_t cmd = DS2482_CMD_1WIRE_RESET;
-    esp_err_t err;
-    err = ds2482_busy_wait();
-    if (err != ESP_OK) return err;
-    err = i2c_master_write_to_device(g_i2c_num, g_i2c_addr, &cmd, 1, pdMS_TO_TICKS(100));
-    if (err != ESP_OK) return err;
-    err = ds2482_busy_wait();
-    if (err != ESP_OK) return err;
-
+// Espera a que el DS2482 libere el bus 1-Wire (comando previo desconocido).
+esp_err_t ds2482_busy_wait(ds2482_t *dev) {
     uint8_t status;
-    ds2482_set_read_pointer(DS2482_REG_STATUS);
-    ds2482_read_register(&status);
+    return esperar_op(dev, -1, esp_timer_get_time(), &status);
+}
 
-    *presence = (status & DS2482_STATUS_PPD) != 0;
-    // Pausa post-reset: 8ms para 80m de cable (~4-8nF de capacitancia).
-    // El APU maneja el recovery del slot, pero el bus necesita estabilizarse
-    // antes de que el master empiece a enviar Match ROM.
-    vTaskDelay(pdMS_TO_TICKS(8));
-    return ESP_OK;
+// Lectura directa del status tras ds2482_ow_emitir(): sin set read pointer
+esp_err_t ds2482_ow_consultar(ds2482_t *dev, uint8_t *status) {
+    esp_err_t err = i2c_leer(dev, status, 1);
+    if (err != ESP_OK) {
+        dev->pendiente_busy = true;
+        return err;
+    }
+    return (*status & DS2482_STATUS_BUSY) ? ESP_ERR_NOT_FINISHED : ESP_OK;
 }
 
-esp_err_t ds2482_write_byte(uint8_t byte) {
-    uint8_t cmd[2] = { DS2482_CMD_WRITE_BYTE, byte };
-    esp_err_t err = ds2482_busy_wait();
-    if (err != ESP_OK) return err;
-    return i2c_master_write_to_device(g_i2c_num, g_i2c_addr, cmd, 2, pdMS_TO_TICKS(100));
+void ds2482_hist_obtener(const ds2482_t *dev, ds2482_op_t op, ds2482_hist_t *out) {
+    *out = dev->hist[op];
 }
 
-#define DS2482_REG_DATA           0xE1  // registro de datos del DS2482
+void ds2482_hist_reset(ds2482_t *dev) {
+    memset(dev->hist, 0, sizeof(dev->hist));
+}
 
-esp_err_t ds2482_read_byte(uint8_t *data) {
-    uint8_t cmd = DS2482_CMD_READ_BYTE;
-    esp_err_t err;
-    err = ds2482_busy_wait();
-    if (err != ESP_OK) return err;
-    err = i2c_master_write_to_device(g_i2c_num, g_i2c_addr, &cmd, 1, pdMS_TO_TICKS(100));
-    if (err != ESP_OK) return err;
-    err = ds2482_busy_wait();
-    if (err != ESP_OK) return err;
-    // Apuntar al registro de DATOS antes de leer — sin esto se lee status (0xF0)
-    uint8_t set_ptr[2] = { DS2482_CMD_SET_READ_PTR, DS2482_REG_DATA };
-    err = i2c_master_write_to_device(g_i2c_num, g_i2c_addr, set_ptr, 2, pdMS_TO_TICKS(100));
-    if (err != ESP_OK) return err;
-    return i2c_master_read_from_device(g_i2c_num, g_i2c_addr, data, 1, pdMS_TO_TICKS(100));
+void ds2482_hist_dump(const ds2482_t *dev) {
+    ESP_LOGI(TAG, "Busy por comando (µs) en 0x%02X | bins: <50 <100 <200 <400 <800 <1600 <3200 <6400 resto",
+             dev->address);
+    for (int op = 0; op < DS2482_OP_NUM; op++) {
+        const ds2482_hist_t *h = &dev->hist[op];
+        ESP_LOGI(TAG, "  %-7s n=%-6lu prom=%-5lu max=%-6lu | %lu %lu %lu %lu %lu %lu %lu %lu %lu",
+                 s_op_nombre[op], (unsigned long)h->n,
+                 (unsigned long)(h->n ? h->total_us / h->n : 0), (unsigned long)h->max_us,
+                 (unsigned long)h->bins[0], (unsigned long)h->bins[1], (unsigned long)h->bins[2],
+                 (unsigned long)h->bins[3], (unsigned long)h->bins[4], (unsigned long)h->bins[5],
+                 (unsigned long)h->bins[6], (unsigned long)h->bins[7], (unsigned long)h->bins[8]);
+    }
 }
 
-esp_err_t ds2482_1wire_triplet(uint8_t direction, uint8_t *status) {
-    uint8_t cmd[2] = { DS2482_CMD_1WIRE_TRIPLET, (direction ? 0x80 : 0x00) };
-    esp_err_t err;
-    err = ds2482_busy_wait();
-    if (err != ESP_OK) return err;
-    err = i2c_master_write_to_device(g_i2c_num, g_i2c_addr, cmd, 2, pdMS_TO_TICKS(100));
-    if (err != ESP_OK) return err;
-    err = ds2482_busy_wait();
-    if (err != ESP_OK) return err;
-    ds2482_set_read_pointer(DS2482_REG_STATUS);
-    return ds2482_read_register(status);
+int ds2482_hist_json(const ds2482_t *dev, char *buf, size_t len) {
+    int pos = snprintf(buf, len, "{");
+    for (int op = 0; op < DS2482_OP_NUM && pos > 0 && (size_t)pos < len; op++) {
+        const ds2482_hist_t *h = &dev->hist[op];
+        pos += snprintf(buf + pos, len - pos,
+                        "%s\"%s\":{\"n\":%lu,\"prom\":%lu,\"max\":%lu,\"hist\":[",
+                        op ? "," : "", s_op_nombre[op], (unsigned long)h->n,
+                        (unsigned long)(h->n ? h->total_us / h->n : 0),
+                        (unsigned long)h->max_us);
+        for (int b = 0; b < DS2482_HIST_BINS && (size_t)pos < len; b++) {
+            pos += snprintf(buf + pos, len - pos, "%s%lu", b ? "," : "",
+                            (unsigned long)h->bins[b]);
+        }
+        if ((size_t)pos < len) pos += snprintf(buf + pos, len - pos, "]}");
+    }
+    if (pos > 0 && (size_t)pos < len) pos += snprintf(buf + pos, len - pos, "}");
+    return ((size_t)pos < len) ? pos : -1;
 }
 
-esp_err_t ds2482_search_rom(uint64_t *rom_code) {
-    *rom_code = 0;
-    esp_err_t err;
+// Antes de cada operación 1-Wire: si la anterior terminó con el bus en estado
+// dudoso, esperar a que el DS2482 libere el 1-Wire; en el -800, seleccionar
+// el canal de este segmento.
+static esp_err_t ow_preparar(ds2482_t *dev) {
+    if (dev->pendiente_busy) {
+        esp_err_t err = ds2482_busy_wait(dev);
+        if (err != ESP_OK) return err;
+        dev->pendiente_busy = false;
+    }
+    return canal_seleccionar(dev);
+}
 
-    bool presence;
-    err = ds2482_1wire_reset(&presence);
+esp_err_t ds2482_ow_emitir(ds2482_t *dev, const uint8_t *cmd, size_t len) {
+    esp_err_t err = ow_preparar(dev);
     if (err != ESP_OK) return err;
-    if (!presence) {
-        ESP_LOGW(TAG, "No 1-Wire device present");
-        return ESP_ERR_NOT_FOUND;
+    err = i2c_escribir(dev, cmd, len);
+    if (err != ESP_OK) dev->pendiente_busy = true;
+    return err;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Backend de transacción combinada (i2c_cmd_link + repeated start)
+//
+// Tras un comando 1-Wire el read pointer del DS2482 queda en el registro de
+// status, así que en la MISMA transacción se puede leer el status varias
+// veces seguidas: cada byte leído a 100 kHz son ~90 µs, y esas lecturas hacen
+// de espera. Se leen tantos status como cubre la duración del comando y solo
+// el último importa. Si aun así quedó BUSY se cae al busy_wait clásico.
+//
+// Las escrituras/lecturas de varios bytes encadenan hasta DS2482_LINK_BYTES
+// operaciones 1-Wire por transacción: un read_memory de 40 bytes pasa de
+// ~300 transacciones I2C a ~10.
+//
+// Con el bus simulado los dos backends están compilados y se elige en
+// ejecución (ds2482_sim_transaccion_combinada), así el banco los compara
+// sobre el mismo bus.
+// ─────────────────────────────────────────────────────────────────────────────
+#define DS2482_LINK_BYTES         8
+#define DS2482_POLLS_MAX          32
+
+// Tiempo de un byte I2C (8 bits + ACK) a la frecuencia configurada
+#define DS2482_I2C_BYTE_US        (9 * 1000000 / CONFIG_DS2482_I2C_FREQ_HZ)
+
+#if CONFIG_DS2482_BACKEND_SIM
+// Cada tramo (lo que va entre dos starts) se entrega al modelo por separado;
+// el link entero cuenta como una transacción, igual que en el bus real.
+// Un byte 1-Wire leído son 4 tramos: comando, polls, set read pointer, dato.
+#define LINK_TRAMOS_MAX           (4 * DS2482_LINK_BYTES)
+
+typedef struct {
+    struct {
+        bool           leer;
+        const uint8_t *tx;
+        uint8_t       *rx;
+        size_t         len;
+    } tramo[LINK_TRAMOS_MAX];
+    size_t n;
+} link_t;
+
+static bool s_sim_link;   // arranca con el backend simple
+
+void ds2482_sim_transaccion_combinada(bool activar) {
+    s_sim_link = activar;
+}
+#define USAR_LINK  s_sim_link
+#else
+typedef struct {
+    i2c_cmd_handle_t cmd;
+} link_t;
+
+// Un byte 1-Wire leído ocupa ~13 elementos del link (comando + polls de status
+// + set read pointer + dato); la macro de IDF reserva 5 por "transacción".
+// Compartido entre todos los handles: el link se arma y ejecuta dentro de una
+// misma llamada, y el bus lo maneja una sola tarea.
+static uint8_t s_link_buf[I2C_LINK_RECOMMENDED_SIZE(3 * DS2482_LINK_BYTES)];
+
+#if CONFIG_DS2482_BACKEND_CMD_LINK
+#define USAR_LINK  true
+#else
+#define USAR_LINK  false
+#endif
+#endif // CONFIG_DS2482_BACKEND_SIM
+
+static void link_abrir(link_t *l) {
+#if CONFIG_DS2482_BACKEND_SIM
+    l->n = 0;
+#else
+    l->cmd = i2c_cmd_link_create_static(s_link_buf, sizeof(s_link_buf));
+#endif
+}
+
+// Start + dirección de escritura + buf
+static void link_escribir(const ds2482_t *dev, link_t *l, const uint8_t *buf, size_t len) {
+#if CONFIG_DS2482_BACKEND_SIM
+    if (l->n >= LINK_TRAMOS_MAX) return;
+    l->tramo[l->n].leer = false;
+    l->tramo[l->n].tx   = buf;
+    l->tramo[l->n].len  = len;
+    l->n++;
+#else
+    i2c_master_start(l->cmd);
+    i2c_master_write_byte(l->cmd, (dev->address << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_write(l->cmd, buf, len, true);
+#endif
+}
+
+// (Repeated) start + dirección de lectura + len bytes, NACK en el último
+static void link_leer(const ds2482_t *dev, link_t *l, uint8_t *buf, size_t len) {
+#if CONFIG_DS2482_BACKEND_SIM
+    if (l->n >= LINK_TRAMOS_MAX) return;
+    l->tramo[l->n].leer = true;
+    l->tramo[l->n].rx   = buf;
+    l->tramo[l->n].len  = len;
+    l->n++;
+#else
+    i2c_master_start(l->cmd);
+    i2c_master_write_byte(l->cmd, (dev->address << 1) | I2C_MASTER_READ, true);
+    i2c_master_read(l->cmd, buf, len, I2C_MASTER_LAST_NACK);
+#endif
+}
+
+static esp_err_t link_ejecutar(ds2482_t *dev, link_t *l) {
+    dev->stats.i2c_transacciones++;
+#if CONFIG_DS2482_BACKEND_SIM
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < l->n && err == ESP_OK; i++) {
+        err = l->tramo[i].leer ? ds2482_sim_leer(dev->address, l->tramo[i].rx, l->tramo[i].len)
+                               : ds2482_sim_escribir(dev->address, l->tramo[i].tx, l->tramo[i].len);
+    }
+#else
+    i2c_master_stop(l->cmd);
+    esp_err_t err = i2c_master_cmd_begin(dev->i2c_num, l->cmd, pdMS_TO_TICKS(100));
+    i2c_cmd_link_delete_static(l->cmd);
+#endif
+    // Tras un fallo no se sabe dónde quedó la secuencia: esperar antes de seguir
+    if (err != ESP_OK) dev->pendiente_busy = true;
+    return err;
+}
+
+// Lecturas de status que cubren la duración prevista del comando, o las que
+// hicieron falta la última vez que el cable fue más lento que lo previsto
+static size_t polls_para(const ds2482_t *dev, ds2482_op_t op) {
+    size_t polls = ds2482_prediccion_us(dev, op) / DS2482_I2C_BYTE_US + 1;
+    if (polls < dev->link_polls[op]) polls = dev->link_polls[op];
+    return (polls < DS2482_POLLS_MAX) ? polls : DS2482_POLLS_MAX;
+}
+
+// El comando siguió BUSY después de todos los polls: el próximo link lee el
+// doble. La operación en curso igual se pierde, pero no la siguiente.
+static void polls_ampliar(ds2482_t *dev, ds2482_op_t op, size_t polls) {
+    size_t mas = 2 * polls;
+    if (mas > DS2482_POLLS_MAX) mas = DS2482_POLLS_MAX;
+    if (mas > dev->link_polls[op]) dev->link_polls[op] = (uint8_t)mas;
+}
+
+// Duración del busy vista dentro del link: bytes I2C desde el comando hasta el
+// primer status sin BUSY (resolución de un byte I2C). -1 si nunca se liberó.
+static int32_t link_duracion_us(const uint8_t *st, size_t polls, size_t cmd_len) {
+    for (size_t i = 0; i < polls; i++) {
+        if (!(st[i] & DS2482_STATUS_BUSY)) {
+            return (int32_t)((cmd_len + 1 + i + 1) * DS2482_I2C_BYTE_US);
+        }
     }
+    return -1;
+}
+
+static void link_comando(const ds2482_t *dev, link_t *link,
+                         const uint8_t *cmd, size_t len, uint8_t *status, size_t polls) {
+    link_escribir(dev, link, cmd, len);
+    link_leer(dev, link, status, polls);
+}
 
-    err = ds2482_write_byte(0xF0);  // Search ROM
+static void link_leer_dato(const ds2482_t *dev, link_t *link, uint8_t *data) {
+    static const uint8_t set_ptr[2] = { DS2482_CMD_SET_READ_PTR, DS2482_REG_DATA };
+    link_escribir(dev, link, set_ptr, sizeof(set_ptr));
+    link_leer(dev, link, data, 1);
+}
+
+// Comando 1-Wire suelto (reset / triplet) con su status final.
+// Los comandos que duran más de un tick no se pollean dentro del link:
+// se lee un status y el resto de la espera cede la CPU.
+static esp_err_t link_ow_comando(ds2482_t *dev, ds2482_op_t op,
+                                 const uint8_t *cmd, size_t len, uint8_t *status) {
+    esp_err_t err = ow_preparar(dev);
     if (err != ESP_OK) return err;
 
-    for (int bit = 0; bit < 64; bit++) {
-        uint8_t direction = 0;
-        uint8_t status;
-        err = ds2482_1wire_triplet(direction, &status);
+    bool largo   = ds2482_prediccion_us(dev, op) >= DS2482_ESPERA_YIELD_US;
+    size_t polls = largo ? 1 : polls_para(dev, op);
+
+    uint8_t st[DS2482_POLLS_MAX];
+    int64_t t0 = esp_timer_get_time();
+    link_t link;
+    link_abrir(&link);
+    link_comando(dev, &link, cmd, len, st, polls);
+    err = link_ejecutar(dev, &link);
+    if (err != ESP_OK) return err;
+
+    int32_t dur = link_duracion_us(st, polls, len);
+    if (dur >= 0) {
+        ds2482_hist_registrar(dev, op, (uint32_t)dur);
+        *status = st[polls - 1];
+        return ESP_OK;
+    }
+    dev->stats.link_esperas++;
+    return esperar_op(dev, op, t0, status);
+}
+
+// Verifica un tramo encadenado: un BUSY intermedio significa que el comando
+// siguiente llegó con el bus ocupado y la secuencia ya no es confiable.
+static esp_err_t ow_verificar_tramo(ds2482_t *dev, ds2482_op_t op,
+                                    uint8_t st[][DS2482_POLLS_MAX],
+                                    size_t n, size_t polls, size_t cmd_len) {
+    for (size_t i = 0; i < n; i++) {
+        int32_t dur = link_duracion_us(st[i], polls, cmd_len);
+        if (dur >= 0) {
+            ds2482_hist_registrar(dev, op, (uint32_t)dur);
+            continue;
+        }
+        polls_ampliar(dev, op, polls);
+        if (i + 1 < n || op == DS2482_OP_READ) {
+            // En lecturas cualquier BUSY (incluido el último) invalida el dato
+            ESP_LOGW(TAG, "Transacción combinada desincronizada en byte %d", (int)i);
+            dev->stats.desincronizados++;
+            dev->pendiente_busy = true;
+            return ESP_ERR_INVALID_STATE;
+        } else {
+            dev->pendiente_busy = true;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t link_ow_write(ds2482_t *dev, const uint8_t *buf, size_t len) {
+    uint8_t cmd[DS2482_LINK_BYTES][2];
+    uint8_t st[DS2482_LINK_BYTES][DS2482_POLLS_MAX];
+    size_t polls = polls_para(dev, DS2482_OP_WRITE);
+
+    while (len > 0) {
+        esp_err_t err = ow_preparar(dev);
         if (err != ESP_OK) return err;
 
-        if ((status & DS2482_STATUS_SBR) && (status & DS2482_STATUS_TSB)) {
-            ESP_LOGE(TAG, "ROM search conflict");
-            return ESP_FAIL;
+        size_t n = (len < DS2482_LINK_BYTES) ? len : DS2482_LINK_BYTES;
+        link_t link;
+        link_abrir(&link);
+        for (size_t i = 0; i < n; i++) {
+            cmd[i][0] = DS2482_CMD_WRITE_BYTE;
+            cmd[i][1] = buf[i];
+            link_comando(dev, &link, cmd[i], 2, st[i], polls);
         }
+        err = link_ejecutar(dev, &link);
+        if (err != ESP_OK) return err;
+        err = ow_verificar_tramo(dev, DS2482_OP_WRITE, st, n, polls, 2);
+        if (err != ESP_OK) return err;
 
-        uint8_t bit_value = (status & DS2482_STATUS_DIR) ? 1 : 0;
-        *rom_code |= ((uint64_t)bit_value << bit);
+        buf += n;
+        len -= n;
     }
+    return ESP_OK;
+}
+
+static esp_err_t link_ow_read(ds2482_t *dev, uint8_t *buf, size_t len) {
+    static const uint8_t cmd = DS2482_CMD_READ_BYTE;
+    uint8_t st[DS2482_LINK_BYTES][DS2482_POLLS_MAX];
+    size_t polls = polls_para(dev, DS2482_OP_READ);
+
+    while (len > 0) {
+        esp_err_t err = ow_preparar(dev);
+        if (err != ESP_OK) return err;
+
+        size_t n = (len < DS2482_LINK_BYTES) ? len : DS2482_LINK_BYTES;
+        link_t link;
+        link_abrir(&link);
+        for (size_t i = 0; i < n; i++) {
+            link_comando(dev, &link, &cmd, 1, st[i], polls);
+            link_leer_dato(dev, &link, &buf[i]);
+        }
+        err = link_ejecutar(dev, &link);
+        if (err != ESP_OK) return err;
+        err = ow_verificar_tramo(dev, DS2482_OP_READ, st, n, polls, 1);
+        if (err != ESP_OK) return err;
 
+        buf += n;
+        len -= n;
+    }
     return ESP_OK;
 }
 
-esp_err_t ds2482_read_status(ds2482_t *dev, uint8_t *status) {
-    g_i2c_num = dev->i2c_num;
-    g_i2c_addr = dev->address;
-    esp_err_t err = ds2482_set_read_pointer(DS2482_REG_STATUS);
+// ─────────────────────────────────────────────────────────────────────────────
+// Backend simple: una transacción I2C por paso (busy_wait + comando +
+// busy_wait + set read pointer + lectura)
+// ─────────────────────────────────────────────────────────────────────────────
+// Emite el comando y espera su fin con el motor adaptativo
+static esp_err_t simple_ow_comando(ds2482_t *dev, ds2482_op_t op,
+                                   const uint8_t *cmd, size_t len, uint8_t *status) {
+    esp_err_t err = ds2482_busy_wait(dev);
     if (err != ESP_OK) return err;
-    return ds2482_read_register(status);
-}
-
-esp_err_t ds2482_search_rom_all(uint64_t *roms, size_t max_devices, size_t *found) {
-    *found = 0;
-    uint64_t last_rom = 0;
-    int last_discrepancy = 0;
-    int last_device_flag = 0;
-    esp_err_t err;
-
-    while (!last_device_flag && *found < max_devices) {
-        uint64_t rom = 0;
-        int current_discrepancy = 0;
-        int bit_number = 1;
-        bool conflict = false;
-
-        // Hasta 3 intentos por iteración — bus largo puede necesitar recuperación
-        for (int retry = 0; retry < 3; retry++) {
-            rom = 0;
-            current_discrepancy = 0;
-            bit_number = 1;
-            conflict = false;
-
-            bool presence;
-            err = ds2482_1wire_reset(&presence);
-            if (err != ESP_OK) return err;
-            if (!presence) {
-                ESP_LOGW(TAG, "No hay dispositivos 1-Wire presentes");
-                return ESP_ERR_NOT_FOUND;
-            }
-
-            err = ds2482_write_byte(0xF0); // Search ROM
-            if (err != ESP_OK) return err;
-
-            // Delay extra post-comando: con 80m de cable los esclavos necesitan
-            // tiempo para decodificar 0xF0 y preparar su primer bit de salida.
-            vTaskDelay(pdMS_TO_TICKS(20));
-
-            for (int byte_idx = 0; byte_idx < 8; byte_idx++) {
-                uint8_t byte_val = 0;
-
-                for (int bit = 0; bit < 8; bit++, bit_number++) {
-                    uint8_t search_direction;
-
-                    if (bit_number < last_discrepancy) {
-                        search_direction = (last_rom >> (bit_number - 1)) & 0x01;
-                    } else if (bit_number == last_discrepancy) {
-                        search_direction = 1;
-                    } else {
-                        search_direction = 0;
-                    }
-
-                    uint8_t status;
-                    err = ds2482_1wire_triplet(search_direction, &status);
-                    if (err != ESP_OK) return err;
-
-                    uint8_t id_bit     = (status & DS2482_STATUS_SBR) ? 1 : 0;
-                    uint8_t cmp_id_bit = (status & DS2482_STATUS_TSB) ? 1 : 0;
-                    uint8_t branch_dir = (status & DS2482_STATUS_DIR) ? 1 : 0;
-
-                    if (id_bit && cmp_id_bit) {
-                        // (1,1): ningún esclavo respondió — bus inestable.
-                        // 1-Wire reset (NO device reset) para limpiar el bus
-                        // sin perder la configuración APU del DS2482.
-                        ESP_LOGW(TAG, "Conflicto 1,1 en bit %d — reintento %d/3", bit_number, retry + 1);
-                        bool dummy;
-                        ds2482_1wire_reset(&dummy);
-                        vTaskDelay(pdMS_TO_TICKS(50)); // 50ms: bus capacitivo se estabiliza
-                        conflict = true;
-                        break;
-                    }
-
-                    if (!id_bit && !cmp_id_bit && search_direction == 0) {
-                        current_discrepancy = bit_number;
-                    }
-
-                    byte_val |= (branch_dir << bit);
-                }
-
-                if (conflict) break;
-                rom |= ((uint64_t)byte_val << (byte_idx * 8));
-            }
-
-            if (!conflict) break; // búsqueda exitosa: salir del loop de retries
-        }
+    dev->pendiente_busy = false;
+    err = ow_preparar(dev);
+    if (err != ESP_OK) return err;
+    err = i2c_escribir(dev, cmd, len);
+    if (err != ESP_OK) return err;
+    return esperar_op(dev, op, esp_timer_get_time(), status);
+}
 
-        if (conflict) {
-            last_device_flag = 1; // después de 3 reintentos fallidos, detenemos
-        } else {
-            roms[*found] = rom;
-            (*found)++;
-
-            if (current_discrepancy == 0) {
-                last_device_flag = 1;
-            } else {
-                last_discrepancy = current_discrepancy;
-                last_rom = rom;
-            }
-        }
+static esp_err_t simple_ow_write(ds2482_t *dev, const uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t cmd[2] = { DS2482_CMD_WRITE_BYTE, buf[i] };
+        uint8_t status;
+        esp_err_t err = simple_ow_comando(dev, DS2482_OP_WRITE, cmd, 2, &status);
+        if (err != ESP_OK) return err;
     }
+    return ESP_OK;
+}
 
+static esp_err_t simple_ow_read(ds2482_t *dev, uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t cmd = DS2482_CMD_READ_BYTE;
+        uint8_t status;
+        esp_err_t err = simple_ow_comando(dev, DS2482_OP_READ, &cmd, 1, &status);
+        if (err != ESP_OK) return err;
+        // Apuntar al registro de DATOS antes de leer — sin esto se lee status (0xF0)
+        err = ds2482_set_read_pointer(dev, DS2482_REG_DATA);
+        if (err != ESP_OK) return err;
+        err = ds2482_read_register(dev, &buf[i]);
+        if (err != ESP_OK) return err;
+    }
     return ESP_OK;
 }
 
-// Comando Write Configuration del DS2482
-#define DS2482_CMD_WRITE_CONFIG  0xD2
+// ── Backend activo ───────────────────────────────────────────────────────────
+esp_err_t ds2482_ow_comando(ds2482_t *dev, ds2482_op_t op,
+                            const uint8_t *cmd, size_t len, uint8_t *status) {
+    if (USAR_LINK) return link_ow_comando(dev, op, cmd, len, status);
+    return simple_ow_comando(dev, op, cmd, len, status);
+}
 
-esp_err_t ds2482_configure(ds2482_t *dev, uint8_t config) {
-    // Construir el byte de configuración con complemento en nibble alto
-    uint8_t config_byte = DS2482_CFG_BYTE(config);
+static esp_err_t ow_write(ds2482_t *dev, const uint8_t *buf, size_t len) {
+    if (USAR_LINK) return link_ow_write(dev, buf, len);
+    return simple_ow_write(dev, buf, len);
+}
 
-    uint8_t buf[2] = { DS2482_CMD_WRITE_CONFIG, config_byte };
+static esp_err_t ow_read(ds2482_t *dev, uint8_t *buf, size_t len) {
+    if (USAR_LINK) return link_ow_read(dev, buf, len);
+    return simple_ow_read(dev, buf, len);
+}
+
+esp_err_t ds2482_1wire_reset(ds2482_t *dev, bool *presence) {
+    uint8_t cmd = DS2482_CMD_1WIRE_RESET;
+    uint8_t status = 0;
+    esp_err_t err = ds2482_ow_comando(dev, DS2482_OP_RESET, &cmd, 1, &status);
+    if (err != ESP_OK) return err;
 
-    esp_err_t err = i2c_master_write_to_device(
-        dev->i2c_num,
-        dev->address,
-        buf,
-        sizeof(buf),
-        pdMS_TO_TICKS(100)
-    );
+    *presence = (status & DS2482_STATUS_PPD) != 0;
+    // Sin presencia el esclavo pudo perder alimentación (y su flag RC)
+    if (!*presence) ds2482_rom_olvidar(dev);
+    // Pausa post-reset según el perfil del cable (8ms en el de 80m).
+    // El APU maneja el recovery del slot, pero el bus necesita estabilizarse
+    // antes de que el master empiece a enviar Match ROM.
+    ds2482_pausa_us(dev->tiempos.post_reset_us);
+    return ESP_OK;
+}
+
+void ds2482_rom_recordar(ds2482_t *dev, uint64_t rom) {
+    dev->rom_activa        = rom;
+    dev->rom_activa_valida = true;
+}
+
+void ds2482_rom_olvidar(ds2482_t *dev) {
+    dev->rom_activa_valida = false;
+}
+
+bool ds2482_rom_es_activa(const ds2482_t *dev, uint64_t rom) {
+    return dev->rom_activa_valida && dev->rom_activa == rom;
+}
 
+esp_err_t ds2482_write_byte(ds2482_t *dev, uint8_t byte) {
+    return ow_write(dev, &byte, 1);
+}
+
+esp_err_t ds2482_write_bytes(ds2482_t *dev, const uint8_t *buf, size_t len) {
+    return ow_write(dev, buf, len);
+}
+
+esp_err_t ds2482_write_byte_spu(ds2482_t *dev, uint8_t byte) {
+    esp_err_t err = ds2482_configure(dev, dev->config | DS2482_CFG_SPU);
+    if (err != ESP_OK) return err;
+    err = ow_write(dev, &byte, 1);
+    // El chip borra SPU solo cuando termina el pull-up; si el byte no salió
+    // hay que borrarlo a mano para que no se active en el próximo
+    uint8_t sin_spu = dev->config & ~DS2482_CFG_SPU;
     if (err != ESP_OK) {
-        ESP_LOGE("DS2482", "Error escribiendo configuración: %s", esp_err_to_name(err));
+        ds2482_configure(dev, sin_spu);
         return err;
     }
+    dev->config = sin_spu;
+    return ESP_OK;
+}
 
-    // Leer de vuelta el registro de configuración para verificar
-    // El DS2482 devuelve solo los 4 bits bajos si la escritura fue exitosa
-    uint8_t readback = 0;
-    err = ds2482_read_register(&readback);
+esp_err_t ds2482_read_byte(ds2482_t *dev, uint8_t *data) {
+    return ow_read(dev, data, 1);
+}
+
+esp_err_t ds2482_read_bytes(ds2482_t *dev, uint8_t *buf, size_t len) {
+    return ow_read(dev, buf, len);
+}
+
+esp_err_t ds2482_1wire_triplet(ds2482_t *dev, uint8_t direction, uint8_t *status) {
+    uint8_t cmd[2] = { DS2482_CMD_1WIRE_TRIPLET, (direction ? 0x80 : 0x00) };
+    return ds2482_ow_comando(dev, DS2482_OP_TRIPLET, cmd, 2, status);
+}
+
+esp_err_t ds2482_read_status(ds2482_t *dev, uint8_t *status) {
+    return leer_status(dev, status);
+}
+
+esp_err_t ds2482_configure(ds2482_t *dev, uint8_t config) {
+    // En el -800 la configuración se aplica al canal seleccionado; queda
+    // guardada en el handle y se repone cada vez que se vuelve a este canal
+    esp_err_t err = canal_conmutar(dev);
     if (err != ESP_OK) return err;
+    err = config_escribir(dev, config);
+    if (err != ESP_OK) return err;
+    uint8_t anterior = dev->config;
+    dev->config = config & 0x0F;
 
-    if ((readback & 0x0F) != (config & 0x0F)) {
-        ESP_LOGE("DS2482", "Configuración rechazada por DS2482. Byte enviado: 0x%02X, recibido: 0x%02X",
-                 config_byte, readback);
-        return ESP_ERR_INVALID_RESPONSE;
-    }
+    // Los cambios de velocidad (1WS) van y vienen con cada acceso en overdrive,
+    // y SPU con cada Copy Scratchpad
+    uint8_t mudos = DS2482_CFG_1WS | DS2482_CFG_SPU;
+    if (((anterior ^ dev->config) & ~mudos) == 0 && anterior != 0) return ESP_OK;
 
     ESP_LOGI("DS2482", "Configuración aplicada: APU=%d SPU=%d 1WS=%d",
              (config & DS2482_CFG_APU) ? 1 : 0,
@@ -308,4 +847,4 @@ esp_err_t ds2482_configure(ds2482_t *dev, uint8_t config) {
              (config & DS2482_CFG_1WS) ? 1 : 0);
 
     return ESP_OK;
-}
\ No newline at end of file
+}
@@ -8,24 +8,281 @@
 // Dirección I2C por defecto del DS2482-100 (AD0 y AD1 conectados a GND)
 #define DS2482_I2C_ADDR 0x18
 
+// DS2482-800: 8 canales 1-Wire detrás de un solo master (AD0..AD2 a GND)
+#define DS2482_800_I2C_ADDR  0x18
+#define DS2482_800_CANALES   8
+#define DS2482_SIN_CANAL     0xFF   // DS2482-100: no hay Channel Select
+
+// Estado compartido por los canales de un DS2482-800: el chip tiene un único
+// master 1-Wire, un solo canal activo y un solo registro de configuración.
 typedef struct {
     i2c_port_t i2c_num;
     uint8_t address;
+    uint8_t canal_activo;    // DS2482_SIN_CANAL = desconocido
+    uint8_t config_activa;   // configuración cargada hoy en el chip
+} ds2482_chip_t;
+
+// Contadores del driver (para medir el costo real de cada operación y la
+// salud del cable: qué tramo gasta más tiempo en reintentos)
+typedef struct {
+    uint32_t i2c_transacciones;
+    uint32_t reintentos;         // pasadas de búsqueda, Match ROM y lecturas repetidas
+    uint32_t resets;             // 1-Wire reset completados
+    uint32_t triplets;
+    uint32_t conflictos;         // (1,1) en la búsqueda
+    uint32_t crc_fallos;         // CRC-8 de ROM y CRC-16 de datos (capas superiores)
+    uint32_t busy_timeouts;      // comandos que no terminaron: bus bloqueado
+    uint32_t link_esperas;       // transacción combinada: los polls no alcanzaron, busy_wait
+    uint32_t desincronizados;    // transacción combinada: un comando llegó con BUSY
+    uint64_t busy_us;            // tiempo esperando el fin de comandos 1-Wire
+} ds2482_stats_t;
+
+// ── Histograma de tiempos de busy por tipo de comando ────────────────────────
+typedef enum {
+    DS2482_OP_RESET,
+    DS2482_OP_WRITE,
+    DS2482_OP_READ,
+    DS2482_OP_TRIPLET,
+    DS2482_OP_NUM
+} ds2482_op_t;
+
+// Bins (µs): <50 <100 <200 <400 <800 <1600 <3200 <6400 y el resto
+#define DS2482_HIST_BINS  9
+
+typedef struct {
+    uint32_t n;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t bins[DS2482_HIST_BINS];
+} ds2482_hist_t;
+
+// ── Perfil de tiempos del cable ──────────────────────────────────────────────
+// Pausas de estabilización que dependen del tramo de cable. El nivel 0 es el
+// perfil de siempre, pensado para 80 m (redondeado a ticks enteros como el
+// vTaskDelay de antes); cada nivel siguiente divide las pausas por 2 y el
+// último no hace ninguna. ds2482_calibrar() busca el más rápido que el bus
+// tolera sin errores y ds2482_tiempos_vigilar() vuelve atrás si los
+// reintentos suben.
+#define DS2482_TIEMPOS_NIVELES  5
+
+typedef struct {
+    uint32_t post_reset_us;      // tras cada 1-Wire reset
+    uint32_t post_search_us;     // tras el 0xF0 de Search ROM
+    uint32_t conflicto_us;       // tras un (1,1) o un CRC-8 malo, antes de repetir la pasada
+    uint32_t reintento_us;       // entre resets sin presencia (Match ROM)
+    uint32_t pre_bloque_us;      // tras el reset que abre cada bloque escrito
+    uint32_t pre_copy_us;        // entre verificar el scratchpad y el Copy
+} ds2482_tiempos_t;
+
+// Un handle = un segmento 1-Wire: un DS2482-100 o un canal de un DS2482-800.
+// Todo el estado del driver vive en el handle, así que puede haber varios
+// bridges (misma u otra I2C) en paralelo. Cada handle lo usa una sola tarea
+// a la vez, y los canales de un mismo -800 deben quedar en la misma tarea.
+typedef struct {
+    i2c_port_t i2c_num;
+    uint8_t address;
+
+    ds2482_chip_t *chip;     // NULL en el DS2482-100
+    uint8_t canal;           // 0..7 en el DS2482-800
+
+    uint8_t config;          // configuración de este segmento (APU/SPU/1WS)
+    bool    pendiente_busy;  // la última operación dejó el bus en estado dudoso
+
+    uint64_t rom_activa;        // último esclavo direccionado con Match ROM
+    bool     rom_activa_valida; // false → el próximo acceso usa Match ROM completo
+
+    ds2482_stats_t stats;
+    ds2482_hist_t  hist[DS2482_OP_NUM];
+    uint8_t        link_polls[DS2482_OP_NUM];  // mínimo aprendido en la transacción combinada
+
+    ds2482_tiempos_t tiempos;       // perfil del nivel actual
+    uint8_t          nivel;         // 0 = conservador, DS2482_TIEMPOS_NIVELES - 1 = sin pausas
+    uint32_t         vig_resets;    // ventana de ds2482_tiempos_vigilar()
+    uint32_t         vig_reintentos;
 } ds2482_t;
 
+void ds2482_stats_obtener(const ds2482_t *dev, ds2482_stats_t *out);
+void ds2482_stats_reset(ds2482_t *dev);
+void ds2482_stats_reintento(ds2482_t *dev);   // para los reintentos de capas superiores
+void ds2482_stats_crc_fallo(ds2482_t *dev);   // CRC de datos inválido en capas superiores
+
+void ds2482_hist_obtener(const ds2482_t *dev, ds2482_op_t op, ds2482_hist_t *out);
+void ds2482_hist_reset(ds2482_t *dev);
+void ds2482_hist_dump(const ds2482_t *dev);                      // a consola (ESP_LOGI)
+int  ds2482_hist_json(const ds2482_t *dev, char *buf, size_t len); // JSON compacto; -1 si no cabe
+
+void ds2482_tiempos_nivel(uint8_t nivel, ds2482_tiempos_t *out);
+void ds2482_tiempos_aplicar(ds2482_t *dev, uint8_t nivel);   // los handles nacen en nivel 0
+void ds2482_pausa_us(uint32_t us);   // al menos us: ticks con vTaskDelay y el resto en espera activa
+
+// Vigilancia en marcha: con al menos DS2482_VIGILANCIA_RESETS resets desde la
+// ventana anterior, si los reintentos superan CONFIG_DS2482_CALIB_ERRORES_PCT %
+// de los resets baja un nivel (pausas más largas). Devuelve true si cambió.
+#define DS2482_VIGILANCIA_RESETS  200
+bool ds2482_tiempos_vigilar(ds2482_t *dev);
+
 esp_err_t ds2482_init(ds2482_t *dev, i2c_port_t i2c_num, uint8_t address);
+
+// DS2482-800: ds2482_800_init() resetea el chip; ds2482_800_canal() prepara
+// el handle de un canal. Cada canal guarda su propia configuración y el
+// driver hace el Channel Select (y repone la configuración si difiere) antes
+// de cada operación 1-Wire del canal.
+esp_err_t ds2482_800_init(ds2482_chip_t *chip, i2c_port_t i2c_num, uint8_t address);
+esp_err_t ds2482_800_canal(ds2482_t *dev, ds2482_chip_t *chip, uint8_t canal);
+
 esp_err_t ds2482_reset(ds2482_t *dev);
-esp_err_t ds2482_1wire_reset(bool *presence);
-esp_err_t ds2482_write_byte(uint8_t byte);
-esp_err_t ds2482_read_byte(uint8_t *data);
-esp_err_t ds2482_search_rom(uint64_t *rom_code);
-
-esp_err_t ds2482_set_read_pointer(uint8_t reg);
-esp_err_t ds2482_read_register(uint8_t *value);
-esp_err_t ds2482_busy_wait();
-esp_err_t ds2482_1wire_triplet(uint8_t direction, uint8_t *status);
+esp_err_t ds2482_1wire_reset(ds2482_t *dev, bool *presence);
+esp_err_t ds2482_write_byte(ds2482_t *dev, uint8_t byte);
+esp_err_t ds2482_read_byte(ds2482_t *dev, uint8_t *data);
+// Varios bytes seguidos: con el backend combinado viajan en pocas transacciones
+esp_err_t ds2482_write_bytes(ds2482_t *dev, const uint8_t *buf, size_t len);
+esp_err_t ds2482_read_bytes(ds2482_t *dev, uint8_t *buf, size_t len);
+// Escribe un byte y deja el Strong Pullup activo al terminar; el pull-up dura
+// hasta el próximo comando 1-Wire, que lo corta y borra SPU en el chip.
+esp_err_t ds2482_write_byte_spu(ds2482_t *dev, uint8_t byte);
+esp_err_t ds2482_search_rom(ds2482_t *dev, uint64_t *rom_code);
+
+// ── Resume ────────────────────────────────────────────────────────────────────
+// Los esclavos con flag RC (DS2431) quedan marcados tras un Match ROM hasta el
+// próximo comando ROM: reset + Resume (0xA5) los vuelve a seleccionar sin
+// repetir los 8 bytes de ROM. El handle recuerda el último esclavo
+// direccionado; las búsquedas, el reset del bridge y un reset sin presencia
+// lo olvidan.
+void ds2482_rom_recordar(ds2482_t *dev, uint64_t rom);
+void ds2482_rom_olvidar(ds2482_t *dev);
+bool ds2482_rom_es_activa(const ds2482_t *dev, uint64_t rom);
+
+esp_err_t ds2482_set_read_pointer(ds2482_t *dev, uint8_t reg);
+esp_err_t ds2482_read_register(ds2482_t *dev, uint8_t *value);
+esp_err_t ds2482_busy_wait(ds2482_t *dev);
+esp_err_t ds2482_1wire_triplet(ds2482_t *dev, uint8_t direction, uint8_t *status);
 esp_err_t ds2482_read_status(ds2482_t *dev, uint8_t *status);
-esp_err_t ds2482_search_rom_all(uint64_t *roms, size_t max_devices, size_t *found);
+esp_err_t ds2482_search_rom_all(ds2482_t *dev, uint64_t *roms, size_t max_devices, size_t *found);
+
+// Búsqueda dirigida a una familia: los 8 primeros bits del recorrido se fijan
+// al código de familia y el árbol solo se ramifica de ahí en adelante, así que
+// los esclavos de otras familias (sondas de temperatura, IDs) no cuestan los
+// 64 triplets de cada pasada. Con presencia pero sin esclavos de la familia
+// retorna ESP_OK y *found = 0 tras 8 triplets.
+esp_err_t ds2482_search_familia(ds2482_t *dev, uint8_t familia,
+                                uint64_t *roms, size_t max_devices, size_t *found);
+
+// Verifica que una ROM concreta siga en el bus recorriendo su rama del árbol
+// de búsqueda (64 triplets forzados). Genérico: sirve para cualquier familia.
+esp_err_t ds2482_verificar_rom(ds2482_t *dev, uint64_t rom, bool *presente);
+
+// ── Búsqueda en varios bridges a la vez ──────────────────────────────────────
+//
+// Cada bridge ejecuta su comando 1-Wire solo, así que mientras un segmento
+// está ocupado (triplet, reset, pausas de estabilización del cable largo) el
+// bus I2C queda libre para los demás. ds2482_search_rom_multi() intercala las
+// búsquedas: emite el comando en un bridge y pasa al siguiente en vez de
+// esperar. Con 3 carros la latencia total queda cerca de la de uno solo.
+//
+// En un DS2482-800 los canales comparten el master: mientras un canal espera
+// la estabilización del cable, otro canal del mismo chip ejecuta sus comandos.
+// ─────────────────────────────────────────────────────────────────────────────
+#define DS2482_SCAN_MAX  8   // segmentos por llamada
+
+// Un ds2482_t por entrada: dos entradas no pueden compartir handle. Los
+// canales de un mismo DS2482-800 se turnan el master 1-Wire: entre ellos se
+// intercalan las pausas, no los comandos.
+typedef struct {
+    ds2482_t *dev;
+    uint64_t *roms;          // salida
+    size_t    max_devices;
+    uint8_t   familia;       // 0 = todas (no hay familia 0x00)
+    uint64_t  prefijo;       // rama a recorrer: bits 1..prefijo_bits de la ROM
+    uint8_t   prefijo_bits;  // 0 = sin prefijo; si no es 0 manda sobre familia
+    size_t    found;         // salida
+    esp_err_t err;           // salida: mismo código que ds2482_search_rom_all()
+    bool      incompleto;    // salida: se agotaron los reintentos, puede faltar alguna
+} ds2482_scan_t;
+
+// Retorna el primer error I2C; el resultado de cada segmento queda en su err.
+esp_err_t ds2482_search_rom_multi(ds2482_scan_t *scans, size_t n);
+
+// ── Censo incremental ─────────────────────────────────────────────────────────
+//
+// Recuerda el último conjunto de ROMs y lo confirma con chequeos dirigidos
+// (Match ROM + lectura corta por ROM conocida) en vez de recorrer el árbol
+// completo cada ciclo. También guarda el árbol de búsqueda que forman esas
+// ROMs (las bifurcaciones sobre el camino de cada una), así que los cambios
+// se resuelven por rama:
+//  - una ROM que no confirma se recorre sola y, si no está, se descarta;
+//  - cada ciclos_barrido ciclos se recorren las ramas conocidas, y una
+//    bifurcación que el árbol no tenía (esclavo enganchado) se resuelve
+//    buscando solo el subárbol que cuelga de ella.
+// El barrido completo queda para el censo inválido o vacío, un subárbol con
+// demasiados esclavos nuevos y el censo lleno.
+// ─────────────────────────────────────────────────────────────────────────────
+#define DS2482_CENSO_MAX_ROMS  32
+
+// Confirmación dirigida de una ROM conocida. NULL → se recorre la rama de cada
+// ROM en todos los ciclos (confirma y descubre a la vez, pero es más lento).
+typedef esp_err_t (*ds2482_confirmar_fn)(ds2482_t *dev, uint64_t rom, bool *presente);
+
+typedef struct {
+    uint64_t roms[DS2482_CENSO_MAX_ROMS];   // último conjunto conocido
+    uint64_t ramas[DS2482_CENSO_MAX_ROMS];  // bits de bifurcación sobre el camino de cada ROM
+    size_t   num_roms;
+    bool     valido;                        // false → próximo ciclo barre completo
+    uint8_t  ciclos_barrido;                // cada cuántos ciclos barrer igual
+    uint8_t  ciclos_sin_barrido;
+    uint8_t  familia;                       // barridos con ds2482_search_familia(); 0 = todas
+    ds2482_confirmar_fn confirmar;
+
+    // Métricas del último ciclo
+    bool     ultimo_fue_barrido;
+    uint8_t  ultimo_recorridos;             // ramas recorridas
+    uint8_t  ultimo_subarboles;             // subárboles buscados por bifurcaciones nuevas
+    uint32_t ultimo_bus_us;
+} ds2482_censo_t;
+
+void      ds2482_censo_init(ds2482_censo_t *censo, uint8_t ciclos_barrido,
+                            uint8_t familia, ds2482_confirmar_fn confirmar);
+void      ds2482_censo_invalidar(ds2482_censo_t *censo);
+// Arranque con un conjunto ya conocido (la tabla guardada): el primer ciclo
+// confirma esas ROMs con los chequeos dirigidos en vez de barrer y el segundo
+// recorre las ramas buscando nuevas. Las que no están se descartan como
+// cualquier desenganche; si no queda ninguna, el ciclo siguiente barre.
+void      ds2482_censo_sembrar(ds2482_censo_t *censo, const uint64_t *roms, size_t n);
+esp_err_t ds2482_censo_actualizar(ds2482_t *dev, ds2482_censo_t *censo,
+                                  uint64_t *roms, size_t max_devices, size_t *found);
+
+// Censo de varios segmentos: las confirmaciones dirigidas van segmento por
+// segmento y todos los barridos completos del ciclo se hacen juntos con
+// ds2482_search_rom_multi().
+typedef struct {
+    ds2482_t       *dev;
+    ds2482_censo_t *censo;
+    uint64_t       *roms;         // salida
+    size_t          max_devices;
+    size_t          found;        // salida
+    esp_err_t       err;          // salida: mismo código que ds2482_censo_actualizar()
+} ds2482_censo_seg_t;
+
+esp_err_t ds2482_censo_actualizar_multi(ds2482_censo_seg_t *segs, size_t n);
+
+// ── Calibración del cable ─────────────────────────────────────────────────────
+// Prueba los niveles de tiempos de menor a mayor velocidad. El nivel 0 es la
+// búsqueda de referencia (sus errores son los reintentos que tuvo); en cada
+// nivel siguiente una búsqueda de la familia que tiene que devolver las mismas
+// ROMs y CONFIG_DS2482_CALIB_RONDAS rondas de confirmación de cada ROM. Un
+// reintento, una ROM de más o de menos o una confirmación fallida cuentan como
+// error. Se queda con el último nivel sin errores y lo deja aplicado.
+// ESP_ERR_NOT_FOUND si no hay esclavos de la familia: sin ellos no hay qué
+// medir y el nivel no cambia.
+typedef struct {
+    uint8_t  nivel;                              // elegido
+    uint8_t  probados;
+    size_t   roms;                               // referencia del nivel 0
+    uint32_t errores[DS2482_TIEMPOS_NIVELES];
+    uint32_t duracion_ms[DS2482_TIEMPOS_NIVELES]; // nivel 0: solo la búsqueda de referencia
+} ds2482_calib_t;
+
+esp_err_t ds2482_calibrar(ds2482_t *dev, uint8_t familia, ds2482_confirmar_fn confirmar,
+                          ds2482_calib_t *out);
 
 // Bits del registro de configuración del DS2482
 #define DS2482_CFG_APU  (1 << 0)  // Active Pullup — necesario para cables largos
@@ -0,0 +1,717 @@
+#include "ds2482_priv.h"
+#include "crc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "string.h"
+
+#define TAG "DS2482"
+
+#define OW_CMD_SEARCH_ROM  0xF0
+
+esp_err_t ds2482_search_rom(ds2482_t *dev, uint64_t *rom_code) {
+    *rom_code = 0;
+    esp_err_t err;
+    ds2482_rom_olvidar(dev);   // el Search ROM cambia qué esclavo queda seleccionado
+
+    bool presence;
+    err = ds2482_1wire_reset(dev, &presence);
+    if (err != ESP_OK) return err;
+    if (!presence) {
+        ESP_LOGW(TAG, "No 1-Wire device present");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    err = ds2482_write_byte(dev, OW_CMD_SEARCH_ROM);
+    if (err != ESP_OK) return err;
+
+    for (int bit = 0; bit < 64; bit++) {
+        uint8_t direction = 0;
+        uint8_t status;
+        err = ds2482_1wire_triplet(dev, direction, &status);
+        if (err != ESP_OK) return err;
+
+        if ((status & DS2482_STATUS_SBR) && (status & DS2482_STATUS_TSB)) {
+            ESP_LOGE(TAG, "ROM search conflict");
+            dev->stats.conflictos++;
+            return ESP_FAIL;
+        }
+
+        uint8_t bit_value = (status & DS2482_STATUS_DIR) ? 1 : 0;
+        *rom_code |= ((uint64_t)bit_value << bit);
+    }
+
+    if (crc8_maxim((const uint8_t *)rom_code, 8) != 0 || *rom_code == 0) {
+        ESP_LOGE(TAG, "ROM CRC-8 inválido (0x%016llX)", (unsigned long long)*rom_code);
+        dev->stats.crc_fallos++;
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Búsqueda de ROMs (algoritmo de Maxim) como máquina de estados por segmento
+//
+// Cada segmento ("carril") avanza de a un comando 1-Wire. Un comando se emite
+// y, en vez de esperar su fin, el planificador pasa al carril siguiente; el
+// status se lee cuando vence la duración prevista. Las pausas de
+// estabilización del cable largo tampoco bloquean: marcan t_listo y el resto
+// de los carriles sigue trabajando.
+//
+// Con un único carril no hay nada que intercalar y cada comando usa el camino
+// bloqueante (en el backend combinado, comando + polls en una transacción).
+// ─────────────────────────────────────────────────────────────────────────────
+
+// Las pausas de estabilización salen del perfil de tiempos del handle
+// (dev->tiempos), las mismas que usa el camino bloqueante.
+#define REINTENTOS_CONFLICTO    3
+
+typedef enum {
+    PASO_RESET,       // 1-Wire reset que abre cada pasada
+    PASO_SEARCH_CMD,  // byte 0xF0
+    PASO_TRIPLET,     // un bit de la ROM
+    PASO_RECUPERAR,   // reset de limpieza tras un conflicto (1,1)
+    PASO_HECHO,
+} paso_t;
+
+typedef struct {
+    ds2482_scan_t *scan;
+    paso_t      paso;
+    bool        en_vuelo;      // comando emitido, falta ver BUSY=0
+    ds2482_op_t op;
+    int64_t     t_emitido;
+    int64_t     t_listo;       // no tocar el segmento antes de este instante
+
+    // Estado del algoritmo de búsqueda
+    uint64_t last_rom;
+    int      last_discrepancy;
+    uint64_t rom;
+    int      discrepancy;
+    int      bit_number;       // 1..64
+    uint8_t  crc8;             // CRC-8 de los bytes de ROM ya completos
+    uint8_t  direccion;
+    int      retry;
+
+    // Recorrido fijo de los primeros bits (familia o rama del censo)
+    uint64_t prefijo;
+    int      prefijo_bits;
+} carril_t;
+
+// Bits 1..n de una ROM (LSB primero, el orden del árbol de búsqueda)
+static uint64_t prefijo_mascara(int bits) {
+    return (bits >= 64) ? ~0ULL : ((1ULL << bits) - 1);
+}
+
+static void carril_iniciar_pasada(carril_t *c) {
+    c->paso        = PASO_RESET;
+    c->rom         = 0;
+    c->discrepancy = 0;
+    c->bit_number  = 1;
+    c->crc8        = CRC8_INICIAL;
+}
+
+// Procesa el status final del comando en curso y decide el paso siguiente
+static void carril_avanzar(carril_t *c, uint8_t status) {
+    ds2482_scan_t *s = c->scan;
+    int64_t ahora = esp_timer_get_time();
+
+    switch (c->paso) {
+    case PASO_RESET:
+        if (!(status & DS2482_STATUS_PPD)) {
+            ESP_LOGW(TAG, "No hay dispositivos 1-Wire presentes (0x%02X)", s->dev->address);
+            s->err  = ESP_ERR_NOT_FOUND;
+            c->paso = PASO_HECHO;
+            return;
+        }
+        c->paso    = PASO_SEARCH_CMD;
+        c->t_listo = ahora + s->dev->tiempos.post_reset_us;
+        return;
+
+    case PASO_SEARCH_CMD:
+        c->paso    = PASO_TRIPLET;
+        c->t_listo = ahora + s->dev->tiempos.post_search_us;
+        return;
+
+    case PASO_TRIPLET: {
+        uint8_t id_bit     = (status & DS2482_STATUS_SBR) ? 1 : 0;
+        uint8_t cmp_id_bit = (status & DS2482_STATUS_TSB) ? 1 : 0;
+        uint8_t branch_dir = (status & DS2482_STATUS_DIR) ? 1 : 0;
+
+        if (id_bit && cmp_id_bit) {
+            // (1,1): ningún esclavo respondió — bus inestable.
+            // 1-Wire reset (NO device reset) para limpiar el bus
+            // sin perder la configuración APU del DS2482.
+            c->retry++;
+            ds2482_stats_reintento(s->dev);
+            s->dev->stats.conflictos++;
+            ESP_LOGW(TAG, "Conflicto 1,1 en bit %d — reintento %d/%d (0x%02X)",
+                     c->bit_number, c->retry, REINTENTOS_CONFLICTO, s->dev->address);
+            c->paso = PASO_RECUPERAR;
+            return;
+        }
+
+        // Dentro del prefijo no se ramifica: esa bifurcación llevaría fuera
+        // de la familia o de la rama pedida
+        bool prefijo = c->bit_number <= c->prefijo_bits;
+        if (!id_bit && !cmp_id_bit && c->direccion == 0 && !prefijo) {
+            c->discrepancy = c->bit_number;
+        }
+        c->rom |= ((uint64_t)branch_dir << (c->bit_number - 1));
+        if (c->bit_number % 8 == 0) {
+            c->crc8 = crc8_maxim_byte(c->crc8, (uint8_t)(c->rom >> (c->bit_number - 8)));
+        }
+        if (prefijo && c->bit_number == c->prefijo_bits && c->rom != c->prefijo) {
+            // Ningún esclavo siguió el prefijo: no queda ninguno por encontrar
+            c->paso = PASO_HECHO;
+            return;
+        }
+
+        if (++c->bit_number <= 64) return;
+
+        // ROM completa: el CRC-8 sobre los 8 bytes da 0. Una ROM en cero
+        // también da 0, pero es el bus clavado en bajo, no un esclavo.
+        if (c->crc8 != 0 || c->rom == 0) {
+            c->retry++;
+            ds2482_stats_reintento(s->dev);
+            s->dev->stats.crc_fallos++;
+            ESP_LOGW(TAG, "CRC-8 ROM inválido (0x%016llX) — reintento %d/%d (0x%02X)",
+                     (unsigned long long)c->rom, c->retry, REINTENTOS_CONFLICTO,
+                     s->dev->address);
+            // No se toca last_rom/last_discrepancy con una ROM mala
+            c->paso = PASO_RECUPERAR;
+            return;
+        }
+        s->roms[s->found++] = c->rom;
+        c->retry = 0;
+        if (c->discrepancy == 0 || s->found >= s->max_devices) {
+            c->paso = PASO_HECHO;
+            return;
+        }
+        c->last_discrepancy = c->discrepancy;
+        c->last_rom         = c->rom;
+        carril_iniciar_pasada(c);
+        return;
+    }
+
+    case PASO_RECUPERAR:
+        c->t_listo = ahora + s->dev->tiempos.post_reset_us + s->dev->tiempos.conflicto_us;
+        if (c->retry >= REINTENTOS_CONFLICTO) {
+            // Después de los reintentos fallidos se entrega lo encontrado,
+            // marcado como parcial
+            s->incompleto = true;
+            c->paso       = PASO_HECHO;
+            return;
+        }
+        carril_iniciar_pasada(c);
+        return;
+
+    case PASO_HECHO:
+        return;
+    }
+}
+
+// Arma el comando 1-Wire que corresponde al paso actual
+static size_t carril_comando(carril_t *c, uint8_t cmd[2]) {
+    switch (c->paso) {
+    case PASO_RESET:
+    case PASO_RECUPERAR:
+        c->op  = DS2482_OP_RESET;
+        cmd[0] = DS2482_CMD_1WIRE_RESET;
+        return 1;
+    case PASO_SEARCH_CMD:
+        c->op  = DS2482_OP_WRITE;
+        cmd[0] = DS2482_CMD_WRITE_BYTE;
+        cmd[1] = OW_CMD_SEARCH_ROM;
+        return 2;
+    case PASO_TRIPLET:
+        if (c->bit_number <= c->prefijo_bits) {
+            c->direccion = (c->prefijo >> (c->bit_number - 1)) & 0x01;
+        } else if (c->bit_number < c->last_discrepancy) {
+            c->direccion = (c->last_rom >> (c->bit_number - 1)) & 0x01;
+        } else {
+            c->direccion = (c->bit_number == c->last_discrepancy) ? 1 : 0;
+        }
+        c->op  = DS2482_OP_TRIPLET;
+        cmd[0] = DS2482_CMD_1WIRE_TRIPLET;
+        cmd[1] = c->direccion ? 0x80 : 0x00;
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static esp_err_t carril_emitir(carril_t *c, bool bloqueante) {
+    uint8_t cmd[2];
+    size_t len = carril_comando(c, cmd);
+    ds2482_t *dev = c->scan->dev;
+
+    if (bloqueante) {
+        uint8_t status;
+        esp_err_t err = ds2482_ow_comando(dev, c->op, cmd, len, &status);
+        if (err != ESP_OK) return err;
+        carril_avanzar(c, status);
+        return ESP_OK;
+    }
+
+    esp_err_t err = ds2482_ow_emitir(dev, cmd, len);
+    if (err != ESP_OK) return err;
+    c->en_vuelo  = true;
+    c->t_emitido = esp_timer_get_time();
+    c->t_listo   = c->t_emitido + ds2482_prediccion_us(dev, c->op);
+    return ESP_OK;
+}
+
+static esp_err_t carril_consultar(carril_t *c) {
+    ds2482_t *dev = c->scan->dev;
+    uint8_t status;
+    esp_err_t err = ds2482_ow_consultar(dev, &status);
+    int64_t ahora = esp_timer_get_time();
+
+    if (err == ESP_ERR_NOT_FINISHED) {
+        if (ahora - c->t_emitido > DS2482_ESPERA_TIMEOUT_US) {
+            ESP_LOGE(TAG, "busy timeout — bus 1-Wire bloqueado (0x%02X)", dev->address);
+            dev->stats.busy_timeouts++;
+            dev->pendiente_busy = true;
+            return ESP_ERR_TIMEOUT;
+        }
+        // Mismo paso de polling que el motor de espera: 1/8 de lo previsto
+        uint32_t paso = ds2482_prediccion_us(dev, c->op) / 8;
+        if (paso < 10)  paso = 10;
+        if (paso > 100) paso = 100;
+        c->t_listo = ahora + paso;
+        return ESP_OK;
+    }
+    if (err != ESP_OK) return err;
+
+    ds2482_hist_registrar(dev, c->op, (uint32_t)(ahora - c->t_emitido));
+    c->en_vuelo = false;
+    carril_avanzar(c, status);
+    return ESP_OK;
+}
+
+// Los canales de un DS2482-800 comparten el master 1-Wire: mientras uno tiene
+// un comando en vuelo, los demás del mismo chip no pueden emitir.
+static bool chip_ocupado(const carril_t *carriles, size_t n, const carril_t *c) {
+    const ds2482_chip_t *chip = c->scan->dev->chip;
+    if (chip == NULL) return false;
+    for (size_t i = 0; i < n; i++) {
+        const carril_t *o = &carriles[i];
+        if (o != c && o->en_vuelo && o->scan->dev->chip == chip) return true;
+    }
+    return false;
+}
+
+static void dormir_hasta(int64_t t) {
+    int64_t restante = t - esp_timer_get_time();
+    if (restante >= DS2482_ESPERA_YIELD_US) {
+        vTaskDelay(restante / DS2482_ESPERA_YIELD_US);
+    } else if (restante > 0) {
+        esp_rom_delay_us((uint32_t)restante);
+    }
+}
+
+esp_err_t ds2482_search_rom_multi(ds2482_scan_t *scans, size_t n) {
+    if (n == 0) return ESP_OK;
+    if (n > DS2482_SCAN_MAX) return ESP_ERR_INVALID_ARG;
+
+    carril_t carriles[DS2482_SCAN_MAX];
+    size_t activos = 0;
+    for (size_t i = 0; i < n; i++) {
+        carril_t *c = &carriles[i];
+        memset(c, 0, sizeof(*c));
+        c->scan = &scans[i];
+        if (scans[i].prefijo_bits > 0) {
+            c->prefijo_bits = (scans[i].prefijo_bits < 64) ? scans[i].prefijo_bits : 64;
+            c->prefijo      = scans[i].prefijo & prefijo_mascara(c->prefijo_bits);
+        } else if (scans[i].familia != 0) {
+            c->prefijo_bits = 8;
+            c->prefijo      = scans[i].familia;
+        }
+        ds2482_rom_olvidar(scans[i].dev);
+        scans[i].found      = 0;
+        scans[i].err        = ESP_OK;
+        scans[i].incompleto = false;
+        carril_iniciar_pasada(c);
+        if (scans[i].max_devices == 0) {
+            c->paso = PASO_HECHO;
+        } else {
+            activos++;
+        }
+    }
+
+    bool bloqueante = (n == 1);
+    esp_err_t primer_err = ESP_OK;
+
+    while (activos > 0) {
+        int64_t ahora = esp_timer_get_time();
+        for (size_t i = 0; i < n; i++) {
+            carril_t *c = &carriles[i];
+            if (c->paso == PASO_HECHO || c->t_listo > ahora) continue;
+            if (!c->en_vuelo && chip_ocupado(carriles, n, c)) continue;
+
+            esp_err_t err = c->en_vuelo ? carril_consultar(c) : carril_emitir(c, bloqueante);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Búsqueda en 0x%02X abortada: %s",
+                         c->scan->dev->address, esp_err_to_name(err));
+                c->scan->err = err;
+                c->paso      = PASO_HECHO;
+                if (primer_err == ESP_OK) primer_err = err;
+            }
+            if (c->paso == PASO_HECHO) activos--;
+            ahora = esp_timer_get_time();
+        }
+
+        // Todos los carriles esperan: dormir hasta el primero que se libere
+        int64_t proximo = INT64_MAX;
+        for (size_t i = 0; i < n; i++) {
+            if (carriles[i].paso != PASO_HECHO && carriles[i].t_listo < proximo) {
+                proximo = carriles[i].t_listo;
+            }
+        }
+        if (activos > 0) dormir_hasta(proximo);
+    }
+
+    return primer_err;
+}
+
+esp_err_t ds2482_search_rom_all(ds2482_t *dev, uint64_t *roms, size_t max_devices, size_t *found) {
+    ds2482_scan_t scan = {
+        .dev         = dev,
+        .roms        = roms,
+        .max_devices = max_devices,
+    };
+    ds2482_search_rom_multi(&scan, 1);
+    *found = scan.found;
+    return scan.err;
+}
+
+esp_err_t ds2482_search_familia(ds2482_t *dev, uint8_t familia,
+                                uint64_t *roms, size_t max_devices, size_t *found) {
+    ds2482_scan_t scan = {
+        .dev         = dev,
+        .roms        = roms,
+        .max_devices = max_devices,
+        .familia     = familia,
+    };
+    ds2482_search_rom_multi(&scan, 1);
+    *found = scan.found;
+    return scan.err;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Verificación de una ROM concreta (algoritmo "verify" de 1-Wire)
+// Se fuerza la dirección de cada triplet al bit de la ROM buscada: si en algún
+// bit el esclavo no responde por esa rama, la ROM ya no está en el bus.
+//
+// De paso se anotan en *nuevas los bits donde el bus mostró una bifurcación
+// (0,0) que no figura en "esperadas": ahí cuelga del camino un esclavo que el
+// árbol conocido no tiene.
+// ─────────────────────────────────────────────────────────────────────────────
+static esp_err_t recorrer_rama(ds2482_t *dev, uint64_t rom, int bits, uint64_t esperadas,
+                               bool *presente, uint64_t *nuevas) {
+    *presente = false;
+    *nuevas   = 0;
+    ds2482_rom_olvidar(dev);
+
+    bool presence;
+    esp_err_t err = ds2482_1wire_reset(dev, &presence);
+    if (err != ESP_OK) return err;
+    if (!presence) return ESP_OK;
+
+    err = ds2482_write_byte(dev, OW_CMD_SEARCH_ROM);
+    if (err != ESP_OK) return err;
+    ds2482_pausa_us(dev->tiempos.post_search_us);  // mismo margen que search_rom_all
+
+    for (int bit = 0; bit < bits; bit++) {
+        uint8_t dir = (rom >> bit) & 0x01;
+        uint8_t status;
+        err = ds2482_1wire_triplet(dev, dir, &status);
+        if (err != ESP_OK) return err;
+
+        bool id_bit     = (status & DS2482_STATUS_SBR) != 0;
+        bool cmp_id_bit = (status & DS2482_STATUS_TSB) != 0;
+        uint8_t tomado  = (status & DS2482_STATUS_DIR) ? 1 : 0;
+        if ((id_bit && cmp_id_bit) || tomado != dir) return ESP_OK;
+        if (!id_bit && !cmp_id_bit && !((esperadas >> bit) & 0x01)) {
+            *nuevas |= 1ULL << bit;
+        }
+    }
+
+    *presente = true;
+    return ESP_OK;
+}
+
+esp_err_t ds2482_verificar_rom(ds2482_t *dev, uint64_t rom, bool *presente) {
+    uint64_t nuevas;
+    return recorrer_rama(dev, rom, 64, ~0ULL, presente, &nuevas);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Censo incremental
+//
+// Además del conjunto de ROMs, el censo guarda el árbol de búsqueda que forman:
+// para cada ROM, los bits de su camino donde el árbol se bifurca. Un esclavo
+// que se desengancha se descarta recorriendo solo su rama, y uno que se
+// engancha aparece como una bifurcación nueva en el recorrido de alguna rama
+// conocida; entonces se busca únicamente el subárbol que cuelga de ese bit.
+// Los bits 57–64 son el CRC de los anteriores: dos ROMs no pueden separarse
+// recién ahí, así que los recorridos terminan en el 56.
+// ─────────────────────────────────────────────────────────────────────────────
+#define CENSO_RAMA_BITS        56
+#define CENSO_SUBARBOL_MAX     4     // más que esto en un subárbol: barrido completo
+
+void ds2482_censo_init(ds2482_censo_t *censo, uint8_t ciclos_barrido,
+                       uint8_t familia, ds2482_confirmar_fn confirmar) {
+    memset(censo, 0, sizeof(*censo));
+    censo->ciclos_barrido = ciclos_barrido;
+    censo->familia        = familia;
+    censo->confirmar      = confirmar;
+}
+
+void ds2482_censo_invalidar(ds2482_censo_t *censo) {
+    censo->valido = false;
+}
+
+// Dos ROMs se separan en el primer bit en que difieren: ese bit es una
+// bifurcación en el camino de las dos.
+static void censo_calcular_ramas(ds2482_censo_t *censo) {
+    memset(censo->ramas, 0, sizeof(censo->ramas));
+    for (size_t i = 0; i < censo->num_roms; i++) {
+        for (size_t j = i + 1; j < censo->num_roms; j++) {
+            uint64_t d = censo->roms[i] ^ censo->roms[j];
+            if (d == 0) continue;
+            uint64_t bit = d & (~d + 1);   // el más bajo: el primero del recorrido
+            censo->ramas[i] |= bit;
+            censo->ramas[j] |= bit;
+        }
+    }
+}
+
+void ds2482_censo_sembrar(ds2482_censo_t *censo, const uint64_t *roms, size_t n) {
+    if (n > DS2482_CENSO_MAX_ROMS) n = DS2482_CENSO_MAX_ROMS;
+    memcpy(censo->roms, roms, n * sizeof(uint64_t));
+    censo->num_roms           = n;
+    censo->valido             = n > 0;
+    // El primer ciclo solo confirma (rápido); el segundo ya recorre las ramas
+    // por si se enganchó algo mientras el equipo estaba apagado.
+    censo->ciclos_sin_barrido = (censo->ciclos_barrido > 2) ? censo->ciclos_barrido - 2 : 0;
+    censo_calcular_ramas(censo);
+}
+
+static bool censo_conoce(const ds2482_censo_t *censo, uint64_t rom) {
+    for (size_t i = 0; i < censo->num_roms; i++) {
+        if (censo->roms[i] == rom) return true;
+    }
+    return false;
+}
+
+// Recorre la rama de la ROM i y busca los subárboles que aparecieron sobre
+// ella. *barrer = true si el resultado no se puede incorporar sin un barrido
+// completo (subárbol lleno, censo lleno o bus sin presencia).
+static esp_err_t censo_rama(ds2482_t *dev, ds2482_censo_t *censo, size_t i,
+                            size_t max_devices, bool *presente, bool *barrer) {
+    uint64_t rom = censo->roms[i];
+    uint64_t nuevas;
+    censo->ultimo_recorridos++;
+    esp_err_t err = recorrer_rama(dev, rom, CENSO_RAMA_BITS, censo->ramas[i], presente, &nuevas);
+    if (err != ESP_OK) return err;
+
+    while (nuevas != 0) {
+        int bit = __builtin_ctzll(nuevas);
+        nuevas &= nuevas - 1;
+        if (censo->familia != 0 && bit < 8) continue;   // esclavo de otra familia
+
+        // Camino común hasta el bit y, en el bit, el lado que no es de esta ROM
+        uint64_t encontradas[CENSO_SUBARBOL_MAX];
+        ds2482_scan_t scan = {
+            .dev          = dev,
+            .roms         = encontradas,
+            .max_devices  = CENSO_SUBARBOL_MAX,
+            .prefijo      = (rom & prefijo_mascara(bit)) | (~rom & (1ULL << bit)),
+            .prefijo_bits = (uint8_t)(bit + 1),
+        };
+        err = ds2482_search_rom_multi(&scan, 1);
+        if (err != ESP_OK) return err;
+        censo->ultimo_subarboles++;
+        if (scan.err != ESP_OK || scan.incompleto || scan.found == CENSO_SUBARBOL_MAX) {
+            *barrer = true;
+            return ESP_OK;
+        }
+
+        for (size_t k = 0; k < scan.found; k++) {
+            if (censo_conoce(censo, encontradas[k])) continue;
+            if (censo->num_roms >= DS2482_CENSO_MAX_ROMS || censo->num_roms >= max_devices) {
+                *barrer = true;
+                return ESP_OK;
+            }
+            ESP_LOGI(TAG, "Censo: ROM %016llX nueva (rama del bit %d)",
+                     (unsigned long long)encontradas[k], bit + 1);
+            censo->roms[censo->num_roms++] = encontradas[k];
+        }
+        // Los recorridos siguientes ya esperan esta bifurcación
+        censo_calcular_ramas(censo);
+    }
+    return ESP_OK;
+}
+
+// Revisa las ROMs conocidas. Con descubrir = false cada una se confirma con el
+// chequeo dirigido y solo la que no confirma se recorre; con descubrir = true
+// (o sin chequeo dirigido) se recorren todas, lo que además encuentra los
+// esclavos nuevos. Las ROMs que se agregan durante la revisión no se revisan.
+static esp_err_t censo_revisar(ds2482_t *dev, ds2482_censo_t *censo, size_t max_devices,
+                               bool descubrir, bool *barrer) {
+    bool recorrer_todas = descubrir || censo->confirmar == NULL;
+    size_t n = censo->num_roms;
+    size_t i = 0;
+
+    while (i < n) {
+        uint64_t rom = censo->roms[i];
+        bool presente = false;
+        esp_err_t err;
+
+        if (!recorrer_todas) {
+            err = censo->confirmar(dev, rom, &presente);
+            if (err != ESP_OK) return err;
+            if (!presente) {
+                ESP_LOGI(TAG, "Censo: ROM %016llX no confirma — recorriendo su rama",
+                         (unsigned long long)rom);
+            }
+        }
+        if (recorrer_todas || !presente) {
+            err = censo_rama(dev, censo, i, max_devices, &presente, barrer);
+            if (err != ESP_OK || *barrer) return err;
+        }
+
+        if (!presente) {
+            // Desenganche: se quita del censo sin tocar el resto del árbol
+            ESP_LOGI(TAG, "Censo: ROM %016llX ya no está en el bus", (unsigned long long)rom);
+            memmove(&censo->roms[i], &censo->roms[i + 1],
+                    (censo->num_roms - i - 1) * sizeof(uint64_t));
+            censo->num_roms--;
+            n--;
+            censo_calcular_ramas(censo);
+            continue;
+        }
+        i++;
+    }
+    return ESP_OK;
+}
+
+// Incorpora al censo el resultado de un barrido completo
+static esp_err_t censo_registrar_barrido(ds2482_censo_t *censo, const ds2482_scan_t *scan) {
+    esp_err_t err   = scan->err;
+    size_t    found = scan->found;
+    if (err == ESP_ERR_NOT_FOUND) {
+        // Bus vacío: es un censo válido con cero ROMs
+        censo->num_roms = 0;
+        censo->valido   = true;
+        return err;
+    }
+    if (err != ESP_OK) {
+        censo->valido = false;
+        return err;
+    }
+
+    size_t n = (found < DS2482_CENSO_MAX_ROMS) ? found : DS2482_CENSO_MAX_ROMS;
+    memcpy(censo->roms, scan->roms, n * sizeof(uint64_t));
+    censo->num_roms = n;
+    censo_calcular_ramas(censo);
+    // Si el bus tiene más ROMs de las que el censo puede recordar, el conjunto
+    // conocido nunca lo explica completo: seguir barriendo cada ciclo. Un
+    // barrido cortado por los reintentos tampoco: los ciclos siguientes solo
+    // confirmarían ese conjunto parcial.
+    censo->valido = !scan->incompleto
+                 && (found < scan->max_devices) && (found <= DS2482_CENSO_MAX_ROMS);
+    return ESP_OK;
+}
+
+esp_err_t ds2482_censo_actualizar_multi(ds2482_censo_seg_t *segs, size_t n) {
+    if (n > DS2482_SCAN_MAX) return ESP_ERR_INVALID_ARG;
+
+    ds2482_scan_t scans[DS2482_SCAN_MAX];
+    size_t        scan_seg[DS2482_SCAN_MAX];
+    size_t        n_scans = 0;
+    esp_err_t     primer_err = ESP_OK;
+
+    // ── Revisión por ramas, segmento por segmento ────────────────────────────
+    for (size_t i = 0; i < n; i++) {
+        ds2482_censo_seg_t *seg   = &segs[i];
+        ds2482_censo_t     *censo = seg->censo;
+        int64_t t0 = esp_timer_get_time();
+        seg->found = 0;
+        seg->err   = ESP_OK;
+        censo->ultimo_fue_barrido = false;
+        censo->ultimo_recorridos  = 0;
+        censo->ultimo_subarboles  = 0;
+
+        bool barrer = !censo->valido
+                   || censo->num_roms == 0
+                   || censo->num_roms > seg->max_devices;
+        if (!barrer) {
+            // El ciclo periódico de descubrimiento recorre todas las ramas
+            bool descubrir = ++censo->ciclos_sin_barrido >= censo->ciclos_barrido;
+            if (descubrir) censo->ciclos_sin_barrido = 0;
+            seg->err = censo_revisar(seg->dev, censo, seg->max_devices, descubrir, &barrer);
+            if (seg->err != ESP_OK) {
+                censo->valido = false;
+            } else if (!barrer) {
+                memcpy(seg->roms, censo->roms, censo->num_roms * sizeof(uint64_t));
+                seg->found = censo->num_roms;   // 0: el próximo ciclo barre
+            }
+        }
+        censo->ultimo_bus_us = (uint32_t)(esp_timer_get_time() - t0);
+
+        if (barrer && seg->err == ESP_OK) {
+            seg->found = 0;
+            censo->ultimo_fue_barrido = true;
+            censo->ciclos_sin_barrido = 0;
+            scans[n_scans] = (ds2482_scan_t){
+                .dev         = seg->dev,
+                .roms        = seg->roms,
+                .max_devices = seg->max_devices,
+                .familia     = censo->familia,
+            };
+            scan_seg[n_scans++] = i;
+        }
+    }
+
+    // ── Todos los barridos del ciclo, intercalados ───────────────────────────
+    if (n_scans > 0) {
+        int64_t t0 = esp_timer_get_time();
+        ds2482_search_rom_multi(scans, n_scans);
+        uint32_t dur = (uint32_t)(esp_timer_get_time() - t0);
+
+        for (size_t k = 0; k < n_scans; k++) {
+            ds2482_censo_seg_t *seg = &segs[scan_seg[k]];
+            seg->found = scans[k].found;
+            seg->err   = censo_registrar_barrido(seg->censo, &scans[k]);
+            seg->censo->ultimo_bus_us += dur;
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        ESP_LOGD(TAG, "Censo %s: %d ROMs en %lu us (%d ramas, %d subárboles)",
+                 segs[i].censo->ultimo_fue_barrido ? "barrido" : "dirigido",
+                 (int)segs[i].found, (unsigned long)segs[i].censo->ultimo_bus_us,
+                 segs[i].censo->ultimo_recorridos, segs[i].censo->ultimo_subarboles);
+        if (primer_err == ESP_OK && segs[i].err != ESP_OK && segs[i].err != ESP_ERR_NOT_FOUND) {
+            primer_err = segs[i].err;
+        }
+    }
+    return primer_err;
+}
+
+esp_err_t ds2482_censo_actualizar(ds2482_t *dev, ds2482_censo_t *censo,
+                                  uint64_t *roms, size_t max_devices, size_t *found) {
+    ds2482_censo_seg_t seg = {
+        .dev         = dev,
+        .censo       = censo,
+        .roms        = roms,
+        .max_devices = max_devices,
+    };
+    ds2482_censo_actualizar_multi(&seg, 1);
+    *found = seg.found;
+    return seg.err;
+}
@@ -0,0 +1,86 @@
+#include <string.h>
+#include "ds2482_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define TAG "DS2482"
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Calibración del perfil de tiempos
+//
+// La referencia es la búsqueda en el nivel 0 (las pausas de 80 m), que cuenta
+// como la muestra de ese nivel. Después se acortan las pausas de a un nivel y
+// en cada uno se repite la búsqueda y se confirma cada ROM de la referencia. El primer nivel con errores corta la
+// prueba: los siguientes solo pueden ser peores.
+// ─────────────────────────────────────────────────────────────────────────────
+static uint32_t probar_nivel(ds2482_t *dev, uint8_t familia, ds2482_confirmar_fn confirmar,
+                             const uint64_t *ref, size_t n_ref) {
+    uint64_t roms[DS2482_CENSO_MAX_ROMS];
+    size_t   n = 0;
+    uint32_t errores = 0;
+    uint32_t reintentos = dev->stats.reintentos;
+
+    esp_err_t err = ds2482_search_familia(dev, familia, roms, DS2482_CENSO_MAX_ROMS, &n);
+    if (err != ESP_OK || n != n_ref || memcmp(roms, ref, n * sizeof(uint64_t)) != 0) {
+        errores++;
+    }
+
+    for (int ronda = 0; ronda < CONFIG_DS2482_CALIB_RONDAS; ronda++) {
+        for (size_t i = 0; i < n_ref; i++) {
+            bool presente = false;
+            err = confirmar ? confirmar(dev, ref[i], &presente)
+                            : ds2482_verificar_rom(dev, ref[i], &presente);
+            if (err != ESP_OK || !presente) errores++;
+        }
+    }
+
+    return errores + (dev->stats.reintentos - reintentos);
+}
+
+esp_err_t ds2482_calibrar(ds2482_t *dev, uint8_t familia, ds2482_confirmar_fn confirmar,
+                          ds2482_calib_t *out) {
+    uint64_t ref[DS2482_CENSO_MAX_ROMS];
+    size_t   n_ref = 0;
+    uint8_t  previo = dev->nivel;
+
+    memset(out, 0, sizeof(*out));
+    out->nivel = previo;
+
+    // La búsqueda de referencia es la muestra del nivel 0: repetirla en el
+    // ciclo duplicaría el nivel más lento sin aportar nada
+    ds2482_tiempos_aplicar(dev, 0);
+    uint32_t reintentos = dev->stats.reintentos;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ds2482_search_familia(dev, familia, ref, DS2482_CENSO_MAX_ROMS, &n_ref);
+    if (err == ESP_OK && n_ref == 0) err = ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK) {
+        ds2482_tiempos_aplicar(dev, previo);
+        return err;
+    }
+    out->roms           = n_ref;
+    out->errores[0]     = dev->stats.reintentos - reintentos;
+    out->duracion_ms[0] = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    out->probados       = 1;
+
+    uint8_t elegido = 0;
+    for (uint8_t nivel = 1; nivel < DS2482_TIEMPOS_NIVELES && out->errores[0] == 0; nivel++) {
+        ds2482_tiempos_aplicar(dev, nivel);
+        t0 = esp_timer_get_time();
+        out->errores[nivel]     = probar_nivel(dev, familia, confirmar, ref, n_ref);
+        out->duracion_ms[nivel] = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+        out->probados++;
+        if (out->errores[nivel] > 0) break;
+        elegido = nivel;
+    }
+
+    ds2482_tiempos_aplicar(dev, elegido);
+    out->nivel = elegido;
+
+    uint8_t ultimo = out->probados - 1;
+    ESP_LOGI(TAG, "Calibración 0x%02X: nivel %d → %d (%d ROMs, %d niveles probados, "
+             "%lu ms la ronda elegida, %lu errores en el nivel %d)",
+             dev->address, previo, elegido, (int)n_ref, out->probados,
+             (unsigned long)out->duracion_ms[elegido],
+             (unsigned long)out->errores[ultimo], ultimo);
+    return ESP_OK;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Uso interno del componente: primitivas compartidas entre ds2482.c (driver
+// del bridge) y ds2482_busqueda.c (búsqueda de ROMs y censo).
+
+#include "ds2482.h"
+
+#define DS2482_CMD_DEVICE_RESET   0xF0
+#define DS2482_CMD_SET_READ_PTR   0xE1
+#define DS2482_CMD_WRITE_BYTE     0xA5
+#define DS2482_CMD_READ_BYTE      0x96
+#define DS2482_CMD_1WIRE_RESET    0xB4
+#define DS2482_CMD_1WIRE_SINGLE   0x87
+#define DS2482_CMD_1WIRE_TRIPLET  0x78
+
+#define DS2482_REG_STATUS         0xF0
+#define DS2482_STATUS_BUSY        0x01
+#define DS2482_STATUS_PPD         0x02
+#define DS2482_STATUS_SD          0x04
+#define DS2482_STATUS_LL          0x08
+#define DS2482_STATUS_RST         0x10
+#define DS2482_STATUS_SBR         0x20
+#define DS2482_STATUS_TSB         0x40
+#define DS2482_STATUS_DIR         0x80
+
+#define DS2482_REG_DATA           0xE1  // registro de datos del DS2482
+
+#define DS2482_ESPERA_YIELD_US    (portTICK_PERIOD_MS * 1000)  // > 1 tick → ceder CPU
+#define DS2482_ESPERA_TIMEOUT_US  600000   // bus 1-Wire bloqueado
+
+// Duración prevista de un comando 1-Wire a la velocidad configurada
+uint32_t  ds2482_prediccion_us(const ds2482_t *dev, ds2482_op_t op);
+void      ds2482_hist_registrar(ds2482_t *dev, ds2482_op_t op, uint32_t us);
+
+// Comando 1-Wire completo: emite y espera su fin. *status = status final.
+esp_err_t ds2482_ow_comando(ds2482_t *dev, ds2482_op_t op,
+                            const uint8_t *cmd, size_t len, uint8_t *status);
+
+// Ejecución partida para intercalar bridges: ds2482_ow_emitir() manda el
+// comando y vuelve sin esperar; ds2482_ow_consultar() lee el status (el read
+// pointer ya quedó en status tras el comando 1-Wire) y retorna
+// ESP_ERR_NOT_FINISHED mientras siga BUSY.
+esp_err_t ds2482_ow_emitir(ds2482_t *dev, const uint8_t *cmd, size_t len);
+esp_err_t ds2482_ow_consultar(ds2482_t *dev, uint8_t *status);
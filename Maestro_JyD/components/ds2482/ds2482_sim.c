@@ -0,0 +1,724 @@
+#include "ds2482_sim.h"
+#include "ds2482_priv.h"
+#include "crc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "sdkconfig.h"
+#include "string.h"
+
+#define TAG "DS2482_SIM"
+
+// Comandos del bridge que solo interpreta el modelo
+#define SIM_CMD_WRITE_CONFIG    0xD2
+#define SIM_CMD_CHANNEL_SELECT  0xC3
+
+// Read pointer del DS2482
+#define SIM_REG_CONFIG          0xC3
+#define SIM_REG_CANAL           0xD2
+
+// Comandos ROM y de memoria que entiende el DS2431 simulado
+#define OW_SEARCH_ROM           0xF0
+#define OW_MATCH_ROM            0x55
+#define OW_SKIP_ROM             0xCC
+#define OW_RESUME               0xA5
+#define OW_OVERDRIVE_SKIP       0x3C
+#define OW_OVERDRIVE_MATCH      0x69
+#define MEM_WRITE_SCRATCHPAD    0x0F
+#define MEM_READ_SCRATCHPAD     0xAA
+#define MEM_COPY_SCRATCHPAD     0x55
+#define MEM_READ_MEMORY         0xF0
+
+#define ES_AA                   0x80   // Authorization Accepted (copia hecha)
+#define SIM_FACTORY_ADDR        0x85   // factory byte: 0xAA o 0x55
+
+// Duración nominal de cada comando 1-Wire [estándar, overdrive]
+#define SIM_RESET_US    { 1148, 146 }
+#define SIM_BYTE_US     {  560,  84 }
+#define SIM_TRIPLET_US  {  210,  32 }
+// Programación de la EEPROM tras el Copy Scratchpad (el datasheet da 10 ms de
+// máximo). Mientras dura el esclavo no contesta resets ni comandos.
+#define SIM_TPROG_US    6000
+
+static const uint8_t s_canal_codigo[DS2482_800_CANALES] = {
+    0xF0, 0xE1, 0xD2, 0xC3, 0xB4, 0xA5, 0x96, 0x87
+};
+static const uint8_t s_canal_lectura[DS2482_800_CANALES] = {
+    0xB8, 0xB1, 0xAA, 0xA3, 0x9C, 0x95, 0x8E, 0x87
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Estado del modelo
+// ─────────────────────────────────────────────────────────────────────────────
+typedef struct {
+    uint64_t rom;
+    uint8_t  puente;       // índice en s_sim.puentes
+    uint8_t  canal;
+    uint8_t  mem[DS2482_SIM_MEM_LEN];
+    uint8_t  scratch[8];
+    uint16_t ta;
+    uint8_t  es;
+    bool     rc;           // flag RC: responde a Resume
+    bool     od;           // en overdrive
+    bool     sel;          // seleccionado por el último comando ROM
+    bool     busca;        // sigue en carrera en el Search ROM
+    bool     copiado;      // la última Copy Scratchpad fue aceptada
+    int64_t  t_prog;       // programando la EEPROM hasta este instante
+} esclavo_t;
+
+typedef enum {
+    FASE_INACTIVO,         // esperando un reset
+    FASE_ROM,              // primer byte tras el reset
+    FASE_MATCH,            // recibiendo los 8 bytes de ROM
+    FASE_BUSQUEDA,         // triplets
+    FASE_FUNCION,          // comando de memoria
+    FASE_ARGS,             // TA1/TA2/E-S del comando
+    FASE_DATOS,            // bytes de datos en uno u otro sentido
+} fase_t;
+
+// Estado 1-Wire de un canal: el de los esclavos colgados de él. En el -800 el
+// Channel Select aísla el canal sin tocarlo, así que sobrevive hasta que se
+// lo vuelve a elegir.
+typedef struct {
+    fase_t   fase;
+    bool     od_match;
+    uint8_t  match[8];
+    uint8_t  n_match;
+    uint8_t  funcion;
+    uint8_t  args[3];
+    uint8_t  n_args;
+    uint16_t ptr;          // dirección (Read Memory) o índice de byte
+    uint16_t crc16;        // CRC-16 1-Wire del comando de memoria en curso
+    int      bit_busqueda;
+    int64_t  t_busqueda;   // fin del 0xF0: desde acá corre la estabilización
+} linea_t;
+
+// Un DS2482 en el bus I2C. El -800 tiene un solo master 1-Wire que trabaja
+// sobre el canal activo; el -100 usa solo el canal 0.
+typedef struct {
+    bool     conectado;    // contesta el ACK de su dirección
+    uint8_t  status;       // sin BUSY: se deriva de t_fin
+    uint8_t  data;
+    uint8_t  reg_config;
+    bool     spu;          // Strong Pullup activo desde el último byte escrito
+    uint8_t  canal;
+    uint8_t  read_ptr;
+    int64_t  t_fin;        // BUSY hasta este instante
+    linea_t  lineas[DS2482_800_CANALES];
+} puente_t;
+
+typedef struct {
+    bool     iniciado;
+    uint32_t semilla;
+    ds2482_sim_config_t config;
+    ds2482_sim_stats_t  stats;
+
+    puente_t  puentes[DS2482_SIM_PUENTES];
+    esclavo_t esclavos[DS2482_SIM_MAX_ESCLAVOS];
+    size_t    n_esclavos;
+} sim_t;
+
+static sim_t s_sim;
+static puente_t *s_puente;   // el de la transacción I2C en curso
+static linea_t  *s_linea;    // su canal activo
+
+static int puente_indice(uint8_t address) {
+    int i = (int)address - DS2482_I2C_ADDR;
+    return (i >= 0 && i < DS2482_SIM_PUENTES) ? i : -1;
+}
+
+// Esclavo colgado del canal activo del bridge en curso
+static bool en_linea(const esclavo_t *e) {
+    return e->puente == (uint8_t)(s_puente - s_sim.puentes) && e->canal == s_puente->canal;
+}
+
+static uint32_t aleatorio(void) {
+    uint32_t x = s_sim.semilla;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s_sim.semilla = x;
+    return x;
+}
+
+static bool sortear_ppm(uint32_t ppm) {
+    return ppm > 0 && (aleatorio() % 1000000) < ppm;
+}
+
+// Bits invertidos por ruido en el cable
+static uint8_t ruido(uint8_t b) {
+    for (int i = 0; i < 8; i++) {
+        if (sortear_ppm(s_sim.config.ber_ppm)) {
+            b ^= (uint8_t)(1 << i);
+            s_sim.stats.bits_invertidos++;
+        }
+    }
+    return b;
+}
+
+static uint8_t ruido_bit(uint8_t bit) {
+    if (sortear_ppm(s_sim.config.ber_ppm)) {
+        s_sim.stats.bits_invertidos++;
+        return bit ^ 1;
+    }
+    return bit;
+}
+
+uint64_t ds2482_sim_rom_nueva(uint8_t canal, uint8_t familia) {
+    uint8_t rb[8];
+    rb[0] = familia;
+    uint32_t a = aleatorio(), b = aleatorio();
+    rb[1] = (uint8_t)a;        rb[2] = (uint8_t)(a >> 8);
+    rb[3] = (uint8_t)(a >> 16); rb[4] = (uint8_t)(a >> 24);
+    rb[5] = (uint8_t)b;        rb[6] = canal;
+    rb[7] = crc8_maxim(rb, 7);
+    uint64_t rom;
+    memcpy(&rom, rb, 8);
+    return rom;
+}
+
+static void sim_iniciar(void) {
+    if (s_sim.iniciado) return;
+    s_sim.iniciado = true;
+    s_sim.semilla  = CONFIG_DS2482_SIM_SEMILLA ? CONFIG_DS2482_SIM_SEMILLA : 1;
+    s_sim.config   = (ds2482_sim_config_t){
+        .demora_cable_us = CONFIG_DS2482_SIM_DEMORA_CABLE_US,
+        .ber_ppm         = CONFIG_DS2482_SIM_BER_PPM,
+        .conflicto_ppm   = CONFIG_DS2482_SIM_CONFLICTO_PPM,
+        .estabilizacion_us = CONFIG_DS2482_SIM_ESTABILIZACION_US,
+    };
+    for (int p = 0; p < DS2482_SIM_PUENTES; p++) s_sim.puentes[p].status = DS2482_STATUS_RST;
+
+    for (uint8_t c = 0; c < DS2482_800_CANALES; c++) {
+        for (int i = 0; i < CONFIG_DS2482_SIM_ESCLAVOS; i++) {
+            ds2482_sim_agregar(DS2482_I2C_ADDR, c, ds2482_sim_rom_nueva(c, 0x2D));   // DS2431
+        }
+    }
+    ESP_LOGW(TAG, "Bus simulado: %d DS2431 por canal, cable +%lu us, BER %lu ppm, conflictos %lu ppm",
+             CONFIG_DS2482_SIM_ESCLAVOS, (unsigned long)s_sim.config.demora_cable_us,
+             (unsigned long)s_sim.config.ber_ppm, (unsigned long)s_sim.config.conflicto_ppm);
+}
+
+static bool programando(const esclavo_t *e) {
+    return esp_timer_get_time() < e->t_prog;
+}
+
+// Esclavo conectado al canal activo y a la velocidad del master
+static bool participa(const esclavo_t *e) {
+    bool od_master = (s_puente->reg_config & DS2482_CFG_1WS) != 0;
+    return en_linea(e) && e->od == od_master && !programando(e);
+}
+
+static bool overdrive(void) {
+    return (s_puente->reg_config & DS2482_CFG_1WS) != 0;
+}
+
+// Los slots de overdrive (~10 µs) no sobreviven a un cable que estira cada
+// comando más de esto: los esclavos muestrean fuera de tiempo y las lecturas
+// llegan corruptas. A velocidad estándar el mismo cable funciona.
+#define SIM_OD_CABLE_MAX_US  10
+
+static bool overdrive_degradado(void) {
+    return overdrive() && s_sim.config.demora_cable_us > SIM_OD_CABLE_MAX_US;
+}
+
+static void ocupar(const uint16_t dur_us[2]) {
+    uint32_t us = dur_us[overdrive() ? 1 : 0] + s_sim.config.demora_cable_us;
+    s_puente->t_fin = esp_timer_get_time() + us;
+    s_sim.stats.bus_us += us;
+    s_puente->read_ptr = DS2482_REG_STATUS;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// 1-Wire
+// ─────────────────────────────────────────────────────────────────────────────
+static void ow_reset(void) {
+    bool presencia = false;
+    for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+        esclavo_t *e = &s_sim.esclavos[i];
+        if (!en_linea(e)) continue;
+        // Un reset a velocidad estándar saca a todos de overdrive
+        if (!overdrive()) e->od = false;
+        e->sel   = false;
+        e->busca = false;
+        if (participa(e)) presencia = true;
+    }
+    s_linea->fase   = FASE_ROM;
+    s_puente->status = presencia ? DS2482_STATUS_PPD : 0;
+    s_sim.stats.resets++;
+}
+
+static void comando_rom(uint8_t b) {
+    switch (b) {
+    case OW_MATCH_ROM:
+    case OW_OVERDRIVE_MATCH:
+        s_linea->od_match = (b == OW_OVERDRIVE_MATCH);
+        s_linea->n_match  = 0;
+        s_linea->fase     = FASE_MATCH;
+        return;
+    case OW_SKIP_ROM:
+    case OW_OVERDRIVE_SKIP:
+    case OW_RESUME:
+    case OW_SEARCH_ROM:
+        for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+            esclavo_t *e = &s_sim.esclavos[i];
+            if (!participa(e)) continue;
+            if (b == OW_RESUME) {
+                e->sel = e->rc;
+                continue;
+            }
+            e->rc    = false;
+            e->sel   = (b != OW_SEARCH_ROM);
+            e->busca = (b == OW_SEARCH_ROM);
+            if (b == OW_OVERDRIVE_SKIP) e->od = true;
+        }
+        s_linea->bit_busqueda = 0;
+        s_linea->fase = (b == OW_SEARCH_ROM) ? FASE_BUSQUEDA : FASE_FUNCION;
+        return;
+    default:
+        s_linea->fase = FASE_INACTIVO;
+        return;
+    }
+}
+
+static void match_completo(void) {
+    uint64_t rom;
+    memcpy(&rom, s_linea->match, 8);
+    for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+        esclavo_t *e = &s_sim.esclavos[i];
+        // En el Overdrive Match el comando llegó a velocidad estándar y la
+        // ROM ya en overdrive: escuchan los que oyeron el comando
+        bool escucha = s_linea->od_match ? (en_linea(e) && !e->od) || participa(e)
+                                      : participa(e);
+        if (!escucha) continue;
+        e->sel = e->rc = (e->rom == rom);
+        if (e->sel && s_linea->od_match) e->od = true;
+    }
+    s_linea->fase = FASE_FUNCION;
+}
+
+static void args_completos(void) {
+    uint16_t addr = (uint16_t)s_linea->args[0] | ((uint16_t)s_linea->args[1] << 8);
+    for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+        esclavo_t *e = &s_sim.esclavos[i];
+        if (!e->sel || !en_linea(e)) continue;
+        switch (s_linea->funcion) {
+        case MEM_WRITE_SCRATCHPAD:
+            e->ta = addr;
+            e->es = (uint8_t)(addr & 0x07);
+            break;
+        case MEM_COPY_SCRATCHPAD:
+            e->copiado = (addr == e->ta && s_linea->args[2] == e->es);
+            if (e->copiado) {
+                uint16_t base = e->ta & ~0x07;
+                if (base < 0x80) memcpy(&e->mem[base], e->scratch, 8);
+                e->es    |= ES_AA;
+                e->t_prog = esp_timer_get_time() + SIM_TPROG_US;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    // Read Memory: dirección; Write Scratchpad: offset dentro del bloque
+    s_linea->ptr  = (s_linea->funcion == MEM_READ_MEMORY) ? addr : (addr & 0x07);
+    s_linea->fase = FASE_DATOS;
+}
+
+static void crc_sumar(uint8_t b) {
+    s_linea->crc16 = crc16_ow_actualizar(s_linea->crc16, &b, 1);
+}
+
+static void comando_funcion(uint8_t b) {
+    s_linea->funcion = b;
+    s_linea->n_args  = 0;
+    s_linea->ptr     = 0;
+    s_linea->crc16   = CRC16_OW_INICIAL;
+    crc_sumar(b);
+    switch (b) {
+    case MEM_READ_MEMORY:
+    case MEM_WRITE_SCRATCHPAD:
+    case MEM_COPY_SCRATCHPAD:
+        s_linea->fase = FASE_ARGS;
+        return;
+    case MEM_READ_SCRATCHPAD:
+        s_linea->fase = FASE_DATOS;
+        return;
+    default:
+        s_linea->fase = FASE_INACTIVO;
+        return;
+    }
+}
+
+static uint8_t args_necesarios(void) {
+    return (s_linea->funcion == MEM_COPY_SCRATCHPAD) ? 3 : 2;
+}
+
+static void ow_escribir(uint8_t b) {
+    b = ruido(b);   // lo que ven los esclavos
+    s_sim.stats.bytes++;
+
+    switch (s_linea->fase) {
+    case FASE_ROM:
+        comando_rom(b);
+        break;
+    case FASE_MATCH:
+        s_linea->match[s_linea->n_match++] = b;
+        if (s_linea->n_match == 8) match_completo();
+        break;
+    case FASE_FUNCION:
+        comando_funcion(b);
+        break;
+    case FASE_ARGS:
+        crc_sumar(b);
+        s_linea->args[s_linea->n_args++] = b;
+        if (s_linea->n_args == args_necesarios()) args_completos();
+        break;
+    case FASE_DATOS:
+        if (s_linea->funcion == MEM_WRITE_SCRATCHPAD && s_linea->ptr < 8) {
+            crc_sumar(b);
+            for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+                esclavo_t *e = &s_sim.esclavos[i];
+                if (!e->sel || !en_linea(e)) continue;
+                e->scratch[s_linea->ptr] = b;
+                e->es = (uint8_t)s_linea->ptr;
+            }
+            s_linea->ptr++;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Byte que pone un esclavo en el bus; 0xFF = no maneja la línea
+static uint8_t esclavo_byte(const esclavo_t *e) {
+    switch (s_linea->funcion) {
+    case MEM_READ_MEMORY:
+        return (s_linea->ptr < DS2482_SIM_MEM_LEN) ? e->mem[s_linea->ptr] : 0xFF;
+    case MEM_READ_SCRATCHPAD: {
+        if (s_linea->ptr == 0) return (uint8_t)e->ta;
+        if (s_linea->ptr == 1) return (uint8_t)(e->ta >> 8);
+        if (s_linea->ptr == 2) return e->es;
+        uint16_t off = (e->ta & 0x07) + (s_linea->ptr - 3);
+        // El CRC-16 invertido que sigue a los datos no se modela
+        return (off <= (e->es & 0x07)) ? e->scratch[off] : 0xFF;
+    }
+    case MEM_WRITE_SCRATCHPAD:
+        // Llegando al fin de la fila, el CRC-16 invertido, LSB primero
+        if (s_linea->ptr == 8) return (uint8_t)~s_linea->crc16;
+        if (s_linea->ptr == 9) return (uint8_t)(~s_linea->crc16 >> 8);
+        return 0xFF;
+    case MEM_COPY_SCRATCHPAD:
+        return (e->copiado && !programando(e)) ? 0xAA : 0xFF;
+    default:
+        return 0xFF;
+    }
+}
+
+static uint8_t ow_leer(void) {
+    s_sim.stats.bytes++;
+    uint8_t b = 0xFF;
+    if (s_linea->fase == FASE_DATOS) {
+        // Varios esclavos seleccionados: AND cableado
+        for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+            const esclavo_t *e = &s_sim.esclavos[i];
+            if (e->sel && en_linea(e)) b &= esclavo_byte(e);
+        }
+        s_linea->ptr++;
+        if (overdrive_degradado()) {
+            uint8_t x = (uint8_t)aleatorio();
+            s_sim.stats.bits_invertidos += (uint32_t)__builtin_popcount(x);
+            b ^= x;
+        }
+    }
+    return ruido(b);
+}
+
+// Tras el 0xF0 el cable largo necesita asentarse antes del primer triplet
+static bool asentado(void) {
+    return s_linea->bit_busqueda > 0
+        || esp_timer_get_time() >= s_linea->t_busqueda + s_sim.config.estabilizacion_us;
+}
+
+static uint8_t ow_triplet(uint8_t dir) {
+    s_sim.stats.triplets++;
+    if (s_linea->fase != FASE_BUSQUEDA) return DS2482_STATUS_SBR | DS2482_STATUS_TSB;
+
+    uint8_t id = 1, cmp = 1;
+    for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+        const esclavo_t *e = &s_sim.esclavos[i];
+        if (!e->busca || !en_linea(e)) continue;
+        uint8_t bit = (e->rom >> s_linea->bit_busqueda) & 0x01;
+        id  &= bit;
+        cmp &= bit ^ 1;
+    }
+    id  = ruido_bit(id);
+    cmp = ruido_bit(cmp);
+    if (sortear_ppm(s_sim.config.conflicto_ppm) || !asentado()) {
+        id = cmp = 1;
+        s_sim.stats.conflictos++;
+    }
+
+    uint8_t tomado = (id != cmp) ? id : dir;
+    if (id && cmp) {
+        // Nadie respondió: el esclavo pierde el hilo hasta el próximo reset
+        s_linea->fase = FASE_INACTIVO;
+    } else {
+        for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+            esclavo_t *e = &s_sim.esclavos[i];
+            if (e->busca && en_linea(e) && ((e->rom >> s_linea->bit_busqueda) & 0x01) != tomado) e->busca = false;
+        }
+        if (++s_linea->bit_busqueda == 64) {
+            for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+                esclavo_t *e = &s_sim.esclavos[i];
+                if (!en_linea(e)) continue;
+                e->sel = e->rc = e->busca;
+                e->busca = false;
+            }
+            s_linea->fase = FASE_FUNCION;
+        }
+    }
+
+    return (id ? DS2482_STATUS_SBR : 0) | (cmp ? DS2482_STATUS_TSB : 0)
+         | (tomado ? DS2482_STATUS_DIR : 0)
+         | (s_puente->status & DS2482_STATUS_PPD);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Transporte I2C
+// ─────────────────────────────────────────────────────────────────────────────
+#define SIM_I2C_BYTE_US  (uint32_t)(9 * 1000000ULL / CONFIG_DS2482_I2C_FREQ_HZ)
+
+static void i2c_demorar_us(uint32_t us) {
+    s_sim.stats.i2c_us += us;
+    esp_rom_delay_us(us);
+}
+
+static void i2c_demorar(size_t len) {
+    // Dirección + datos, 9 bits por byte, más start/stop
+    i2c_demorar_us((uint32_t)(len + 1) * SIM_I2C_BYTE_US + 10);
+}
+
+static bool ocupado(void) {
+    return esp_timer_get_time() < s_puente->t_fin;
+}
+
+// Sin bridge en la dirección nadie contesta el ACK: el master lo ve como
+// ESP_FAIL, igual que i2c_master_cmd_begin() con un NACK
+static esp_err_t puente_elegir(uint8_t address) {
+    int p = puente_indice(address);
+    if (p < 0 || !s_sim.puentes[p].conectado) return ESP_FAIL;
+    s_puente = &s_sim.puentes[p];
+    s_linea  = &s_puente->lineas[s_puente->canal];
+    return ESP_OK;
+}
+
+// El Strong Pullup termina con el próximo comando 1-Wire y el chip borra SPU.
+// Un time slot con un esclavo programando le quita la alimentación: la fila
+// queda con basura y el Copy no se confirma nunca.
+static void spu_cortar(void) {
+    for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+        esclavo_t *e = &s_sim.esclavos[i];
+        if (!en_linea(e) || !programando(e)) continue;
+        uint16_t base = e->ta & ~0x07;
+        if (base < 0x80) {
+            for (int j = 0; j < 8; j++) e->mem[base + j] = (uint8_t)aleatorio();
+        }
+        e->copiado = false;
+        e->t_prog  = 0;
+        s_sim.stats.copias_cortadas++;
+    }
+    if (!s_puente->spu) return;
+    s_puente->spu         = false;
+    s_puente->reg_config &= ~DS2482_CFG_SPU;
+}
+
+esp_err_t ds2482_sim_escribir(uint8_t address, const uint8_t *buf, size_t len) {
+    sim_iniciar();
+    if (puente_elegir(address) != ESP_OK) {
+        i2c_demorar(0);
+        return ESP_FAIL;
+    }
+    i2c_demorar(len);
+    if (len == 0) return ESP_OK;
+
+    static const uint16_t reset_us[2]   = SIM_RESET_US;
+    static const uint16_t byte_us[2]    = SIM_BYTE_US;
+    static const uint16_t triplet_us[2] = SIM_TRIPLET_US;
+
+    switch (buf[0]) {
+    case DS2482_CMD_DEVICE_RESET:
+        s_puente->status     = DS2482_STATUS_RST;
+        s_puente->reg_config = 0;
+        s_puente->spu        = false;
+        s_puente->canal      = 0;
+        s_puente->t_fin      = 0;
+        s_puente->read_ptr   = DS2482_REG_STATUS;
+        // Corta lo que estuviera haciendo el 1-Wire en cualquier canal
+        for (uint8_t c = 0; c < DS2482_800_CANALES; c++) s_puente->lineas[c].fase = FASE_INACTIVO;
+        s_linea = &s_puente->lineas[0];
+        break;
+
+    case DS2482_CMD_SET_READ_PTR:
+        if (len < 2) return ESP_ERR_INVALID_ARG;
+        if (buf[1] == DS2482_REG_STATUS || buf[1] == DS2482_REG_DATA ||
+            buf[1] == SIM_REG_CONFIG || buf[1] == SIM_REG_CANAL) {
+            s_puente->read_ptr = buf[1];
+        }
+        break;
+
+    case SIM_CMD_WRITE_CONFIG:
+        if (len < 2 || ocupado()) break;
+        // Nibble alto = complemento del bajo, si no el chip lo rechaza
+        if ((buf[1] >> 4) == (~buf[1] & 0x0F)) {
+            s_puente->reg_config = buf[1] & 0x0F;
+            if (!(s_puente->reg_config & DS2482_CFG_SPU)) s_puente->spu = false;
+            s_puente->status    &= ~DS2482_STATUS_RST;
+        }
+        s_puente->read_ptr = SIM_REG_CONFIG;
+        break;
+
+    case SIM_CMD_CHANNEL_SELECT:
+        if (len < 2 || ocupado()) break;
+        for (uint8_t c = 0; c < DS2482_800_CANALES; c++) {
+            if (s_canal_codigo[c] == buf[1]) {
+                s_puente->canal = c;
+                s_linea = &s_puente->lineas[c];
+            }
+        }
+        s_puente->read_ptr = SIM_REG_CANAL;
+        break;
+
+    case DS2482_CMD_1WIRE_RESET:
+        if (ocupado()) break;   // el chip ignora comandos 1-Wire con BUSY
+        spu_cortar();
+        ow_reset();
+        ocupar(reset_us);
+        break;
+
+    case DS2482_CMD_WRITE_BYTE:
+        if (len < 2 || ocupado()) break;
+        spu_cortar();
+        ow_escribir(buf[1]);
+        ocupar(byte_us);
+        s_puente->spu = (s_puente->reg_config & DS2482_CFG_SPU) != 0;
+        if (s_linea->fase == FASE_BUSQUEDA && s_linea->bit_busqueda == 0) s_linea->t_busqueda = s_puente->t_fin;
+        break;
+
+    case DS2482_CMD_READ_BYTE:
+        if (ocupado()) break;
+        spu_cortar();
+        s_puente->data = ow_leer();
+        ocupar(byte_us);
+        break;
+
+    case DS2482_CMD_1WIRE_TRIPLET:
+        if (len < 2 || ocupado()) break;
+        spu_cortar();
+        s_puente->status = ow_triplet((buf[1] & 0x80) ? 1 : 0);
+        ocupar(triplet_us);
+        break;
+
+    default:
+        ESP_LOGW(TAG, "Comando 0x%02X no modelado", buf[0]);
+        break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ds2482_sim_leer(uint8_t address, uint8_t *buf, size_t len) {
+    sim_iniciar();
+    // Cada byte se muestrea al terminar de salir: varios status seguidos en
+    // una lectura ven avanzar el BUSY (la espera de la transacción combinada)
+    i2c_demorar(0);
+    if (puente_elegir(address) != ESP_OK) return ESP_FAIL;
+    for (size_t i = 0; i < len; i++) {
+        i2c_demorar_us(SIM_I2C_BYTE_US);
+        switch (s_puente->read_ptr) {
+        case DS2482_REG_DATA: buf[i] = s_puente->data;                          break;
+        case SIM_REG_CONFIG:  buf[i] = s_puente->reg_config;                    break;
+        case SIM_REG_CANAL:   buf[i] = s_canal_lectura[s_puente->canal];        break;
+        default:
+            buf[i] = s_puente->status | (ocupado() ? DS2482_STATUS_BUSY : 0);
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// API del banco de pruebas
+// ─────────────────────────────────────────────────────────────────────────────
+void ds2482_sim_configurar(const ds2482_sim_config_t *cfg) {
+    sim_iniciar();
+    s_sim.config = *cfg;
+}
+
+void ds2482_sim_config_obtener(ds2482_sim_config_t *out) {
+    sim_iniciar();
+    *out = s_sim.config;
+}
+
+void ds2482_sim_vaciar(void) {
+    sim_iniciar();
+    s_sim.n_esclavos = 0;
+    for (int p = 0; p < DS2482_SIM_PUENTES; p++) {
+        for (uint8_t c = 0; c < DS2482_800_CANALES; c++) s_sim.puentes[p].lineas[c].fase = FASE_INACTIVO;
+    }
+}
+
+// Desenganche: el esclavo desaparece a mitad de lo que esté haciendo el bus
+esp_err_t ds2482_sim_quitar(uint64_t rom) {
+    sim_iniciar();
+    for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+        if (s_sim.esclavos[i].rom != rom) continue;
+        s_sim.esclavos[i] = s_sim.esclavos[--s_sim.n_esclavos];
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t ds2482_sim_agregar(uint8_t address, uint8_t canal, uint64_t rom) {
+    sim_iniciar();
+    int p = puente_indice(address);
+    if (p < 0 || canal >= DS2482_800_CANALES) return ESP_ERR_INVALID_ARG;
+    if (s_sim.n_esclavos >= DS2482_SIM_MAX_ESCLAVOS) return ESP_ERR_NO_MEM;
+    s_sim.puentes[p].conectado = true;
+
+    esclavo_t *e = &s_sim.esclavos[s_sim.n_esclavos++];
+    memset(e, 0, sizeof(*e));
+    e->rom    = rom;
+    e->puente = (uint8_t)p;
+    e->canal  = canal;
+    memset(e->mem, 0xFF, sizeof(e->mem));
+    e->mem[SIM_FACTORY_ADDR] = 0x55;
+    return ESP_OK;
+}
+
+size_t ds2482_sim_roms(uint8_t address, uint8_t canal, uint64_t *roms, size_t max) {
+    sim_iniciar();
+    int p = puente_indice(address);
+    size_t n = 0;
+    for (size_t i = 0; i < s_sim.n_esclavos && n < max; i++) {
+        const esclavo_t *e = &s_sim.esclavos[i];
+        if (e->puente == p && e->canal == canal) roms[n++] = e->rom;
+    }
+    return n;
+}
+
+uint8_t *ds2482_sim_memoria(uint64_t rom) {
+    sim_iniciar();
+    for (size_t i = 0; i < s_sim.n_esclavos; i++) {
+        if (s_sim.esclavos[i].rom == rom) return s_sim.esclavos[i].mem;
+    }
+    return NULL;
+}
+
+void ds2482_sim_stats_obtener(ds2482_sim_stats_t *out) {
+    *out = s_sim.stats;
+}
+
+void ds2482_sim_stats_reset(void) {
+    memset(&s_sim.stats, 0, sizeof(s_sim.stats));
+}
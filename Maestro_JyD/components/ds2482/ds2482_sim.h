@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// ── Bus simulado (CONFIG_DS2482_BACKEND_SIM) ──────────────────────────────────
+//
+// Modelo en software de hasta DS2482_SIM_PUENTES bridges DS2482-100/-800 en
+// el mismo bus I2C (uno por dirección, 0x18 en adelante) y de N esclavos
+// DS2431 por canal. Cada bridge tiene su propio BUSY y registros, y cada canal
+// su propia línea 1-Wire, que el Channel Select deja como estaba: las búsquedas
+// intercaladas de ds2482_search_rom_multi() se solapan como en el hardware. Una
+// dirección sin bridge no da ACK (ESP_FAIL). Todos aceptan el Channel Select
+// del -800; un handle de -100 simplemente no lo usa.
+// El driver le entrega cada transacción I2C en lugar de mandarla al bus real,
+// así que todo el stack (búsqueda, censo, lectura y escritura de EEPROM) corre
+// sin hardware y se puede medir en el banco: transacciones I2C, tiempo de bus
+// simulado y reintentos.
+//
+// Los tiempos se respetan en tiempo real: cada comando 1-Wire deja BUSY
+// durante su duración nominal más la demora de cable, y cada transacción I2C
+// demora lo que tardaría a CONFIG_DS2482_I2C_FREQ_HZ.
+// ─────────────────────────────────────────────────────────────────────────────
+#define DS2482_SIM_PUENTES       8    // 0x18..0x1F (AD0..AD2 del -800)
+#define DS2482_SIM_MAX_ESCLAVOS  48   // entre todos los bridges y canales
+#define DS2482_SIM_MEM_LEN       0x90 // 128 bytes de datos + registros
+
+typedef struct {
+    uint32_t demora_cable_us;   // se suma a cada comando 1-Wire; > 10 µs
+                                // corrompe las lecturas en overdrive
+    uint32_t ber_ppm;           // bits invertidos por millón (lectura y escritura)
+    uint32_t conflicto_ppm;     // triplets que devuelven (1,1) por millón
+    uint32_t estabilizacion_us; // tras el 0xF0 de Search ROM; antes, los triplets leen (1,1)
+} ds2482_sim_config_t;
+
+typedef struct {
+    uint32_t resets;            // 1-Wire reset
+    uint32_t bytes;             // bytes 1-Wire escritos o leídos
+    uint32_t triplets;
+    uint32_t bits_invertidos;   // errores inyectados
+    uint32_t conflictos;        // (1,1) inyectados, por ruido o por cable sin asentar
+    uint32_t copias_cortadas;   // time slots durante tPROG: fila corrompida
+    uint64_t bus_us;            // tiempo ocupado del 1-Wire
+    uint64_t i2c_us;            // tiempo ocupado del I2C
+} ds2482_sim_stats_t;
+
+// Al primer uso se conecta el bridge de DS2482_I2C_ADDR y se le cargan
+// CONFIG_DS2482_SIM_ESCLAVOS DS2431 vírgenes por canal con ROMs
+// pseudoaleatorias (semilla CONFIG_DS2482_SIM_SEMILLA). Agregar un esclavo en
+// otra dirección conecta ese bridge; vaciar saca los esclavos, no los bridges.
+void      ds2482_sim_configurar(const ds2482_sim_config_t *cfg);
+void      ds2482_sim_config_obtener(ds2482_sim_config_t *out);
+void      ds2482_sim_vaciar(void);
+esp_err_t ds2482_sim_agregar(uint8_t address, uint8_t canal, uint64_t rom);  // DS2431 virgen
+esp_err_t ds2482_sim_quitar(uint64_t rom);
+uint64_t  ds2482_sim_rom_nueva(uint8_t canal, uint8_t familia); // ROM pseudoaleatoria con CRC
+size_t    ds2482_sim_roms(uint8_t address, uint8_t canal, uint64_t *roms, size_t max);
+uint8_t  *ds2482_sim_memoria(uint64_t rom);                    // NULL si no existe
+
+// Backend del driver sobre el bus simulado: false (arranque) = una
+// transacción I2C por paso, true = transacción combinada como con
+// CONFIG_DS2482_BACKEND_CMD_LINK. Lo define ds2482.c.
+void      ds2482_sim_transaccion_combinada(bool activar);
+
+void      ds2482_sim_stats_obtener(ds2482_sim_stats_t *out);
+void      ds2482_sim_stats_reset(void);
+
+// Transporte: lo usan i2c_escribir()/i2c_leer() del driver
+esp_err_t ds2482_sim_escribir(uint8_t address, const uint8_t *buf, size_t len);
+esp_err_t ds2482_sim_leer(uint8_t address, uint8_t *buf, size_t len);
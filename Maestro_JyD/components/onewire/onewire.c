@@ -0,0 +1,204 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_task_wdt.h"
+#include "onewire.h"
+
+#define TAG "ONEWIRE"
+
+static onewire_config_t   s_cfg;
+static onewire_segmento_t s_segmentos[ONEWIRE_MAX_SEGMENTOS];
+static QueueHandle_t      s_cola;
+static TaskHandle_t       s_tarea;
+static uint32_t           s_ciclo;
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Censo de todos los segmentos
+// Primero un reset por segmento: si alguno da error I2C no se censa nada (el
+// que decide reintentar o reiniciar es quien recibe el resultado). Los
+// segmentos con presencia se censan juntos para intercalar los barridos.
+// ─────────────────────────────────────────────────────────────────────────────
+static void censar(void) {
+    // Estático: el resultado (~200 bytes) no pesa en el stack de la tarea
+    static onewire_censo_t censo;
+    ds2482_censo_seg_t multi[ONEWIRE_MAX_SEGMENTOS];
+    ds2482_stats_t     inicio[ONEWIRE_MAX_SEGMENTOS], fin;
+    size_t             idx[ONEWIRE_MAX_SEGMENTOS];
+    size_t             n = 0;
+
+    memset(&censo, 0, sizeof(censo));
+    censo.ciclo = s_ciclo++;
+
+    for (size_t s = 0; s < s_cfg.n; s++) {
+        onewire_censo_seg_t *r = &censo.seg[s];
+        r->err = ds2482_1wire_reset(s_segmentos[s].bus, &r->presencia);
+        if (r->err != ESP_OK) {
+            censo.error_bus = true;
+        } else if (!r->presencia) {
+            ESP_LOGW(TAG, "Bus vacío (segmento %d)", (int)s);
+        }
+    }
+
+    if (!censo.error_bus) {
+        for (size_t s = 0; s < s_cfg.n; s++) {
+            if (!censo.seg[s].presencia) continue;
+            const onewire_segmento_t *seg = &s_segmentos[s];
+            ds2482_stats_obtener(seg->bus, &inicio[n]);
+            multi[n] = (ds2482_censo_seg_t){
+                .dev         = seg->bus,
+                .censo       = seg->censo,
+                .roms        = seg->roms,
+                .max_devices = seg->max_roms,
+            };
+            idx[n++] = s;
+        }
+        if (n > 0) ds2482_censo_actualizar_multi(multi, n);
+
+        for (size_t k = 0; k < n; k++) {
+            const onewire_segmento_t *seg = &s_segmentos[idx[k]];
+            onewire_censo_seg_t      *r   = &censo.seg[idx[k]];
+            r->err   = multi[k].err;
+            r->found = multi[k].found;
+            if (r->err != ESP_OK) {
+                ESP_LOGE(TAG, "Error censo 1-Wire (segmento %d): %s",
+                         (int)idx[k], esp_err_to_name(r->err));
+                continue;
+            }
+            ds2482_stats_obtener(seg->bus, &fin);
+            ESP_LOGI(TAG, "Segmento %d — ROMs en bus: %d (%s, %lu ms de bus, %lu transacciones I2C)",
+                     (int)idx[k], r->found, seg->censo->ultimo_fue_barrido ? "barrido"
+                         : seg->censo->ultimo_recorridos ? "por ramas" : "dirigido",
+                     (unsigned long)(seg->censo->ultimo_bus_us / 1000),
+                     (unsigned long)(fin.i2c_transacciones - inicio[k].i2c_transacciones));
+        }
+    }
+
+    if (s_cfg.censo_hecho) s_cfg.censo_hecho(&censo, s_cfg.ctx);
+}
+
+static void atender(onewire_pedido_t *pedido) {
+    const onewire_segmento_t *seg = &s_segmentos[pedido->segmento];
+
+    switch (pedido->op) {
+    case ONEWIRE_CENSO:
+        censar();
+        pedido->err = ESP_OK;
+        break;
+    case ONEWIRE_LEER:
+        pedido->err = ds2431_leer_lote(seg->bus, seg->lote, pedido->lecturas, pedido->n);
+        break;
+    case ONEWIRE_ESCRIBIR: {
+        ds2431_t dev = { .rom_code = pedido->rom };
+        pedido->err = ds2431_escribir_datos_diff(seg->bus, &dev, pedido->datos, NULL, NULL);
+        break;
+    }
+    case ONEWIRE_CALIBRAR:
+        pedido->err = ds2482_calibrar(seg->bus, seg->censo->familia, seg->censo->confirmar,
+                                      pedido->calib);
+        break;
+    default:
+        pedido->err = ESP_ERR_INVALID_ARG;
+        break;
+    }
+
+    // El callback puede reencolar el mismo pedido: listo se lee antes
+    SemaphoreHandle_t listo = pedido->listo;
+    if (pedido->hecho) pedido->hecho(pedido);
+    if (listo) xSemaphoreGive(listo);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Lazo de la tarea: espera pedidos hasta el próximo censo. La cadencia se
+// mide desde el inicio de cada período, no desde el fin del censo anterior;
+// si un censo o un pedido largo se come uno o más períodos, se saltean en
+// lugar de encadenar censos atrasados.
+// ─────────────────────────────────────────────────────────────────────────────
+static void tarea_bus(void *arg) {
+    if (s_cfg.watchdog) esp_task_wdt_add(NULL);
+
+    vTaskDelay(pdMS_TO_TICKS(s_cfg.primer_censo_ms));
+    const TickType_t periodo = pdMS_TO_TICKS(s_cfg.periodo_ms);
+    TickType_t proximo = xTaskGetTickCount();
+
+    while (1) {
+        if (s_cfg.watchdog) esp_task_wdt_reset();
+
+        TickType_t ahora = xTaskGetTickCount();
+        if ((int32_t)(proximo - ahora) <= 0) {
+            censar();
+            ahora = xTaskGetTickCount();
+            do { proximo += periodo; } while ((int32_t)(proximo - ahora) <= 0);
+            continue;
+        }
+
+        onewire_pedido_t *pedido;
+        if (xQueueReceive(s_cola, &pedido, proximo - ahora) == pdTRUE) atender(pedido);
+    }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// API
+// ─────────────────────────────────────────────────────────────────────────────
+esp_err_t onewire_iniciar(const onewire_config_t *cfg) {
+    if (s_cola) return ESP_ERR_INVALID_STATE;
+    if (!cfg || cfg->n == 0 || cfg->n > ONEWIRE_MAX_SEGMENTOS || cfg->periodo_ms == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    s_cfg = *cfg;
+    memcpy(s_segmentos, cfg->segmentos, cfg->n * sizeof(onewire_segmento_t));
+    s_cfg.segmentos = s_segmentos;
+
+    s_cola = xQueueCreate(ONEWIRE_COLA_LEN, sizeof(onewire_pedido_t *));
+    if (!s_cola) return ESP_ERR_NO_MEM;
+
+    if (xTaskCreate(tarea_bus, "onewire", cfg->stack, NULL, cfg->prioridad, &s_tarea) != pdPASS) {
+        ESP_LOGE(TAG, "No se pudo crear la tarea del bus");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Tarea del bus: %d segmento/s, censo cada %lu ms",
+             (int)cfg->n, (unsigned long)cfg->periodo_ms);
+    return ESP_OK;
+}
+
+static esp_err_t encolar(onewire_pedido_t *pedido) {
+    if (!s_cola) return ESP_ERR_INVALID_STATE;
+    if (!pedido) return ESP_ERR_INVALID_ARG;
+    if (pedido->op != ONEWIRE_CENSO && pedido->segmento >= s_cfg.n) return ESP_ERR_INVALID_ARG;
+    if (pedido->op == ONEWIRE_LEER && (!pedido->lecturas || pedido->n == 0))
+        return ESP_ERR_INVALID_ARG;
+    if (pedido->op == ONEWIRE_ESCRIBIR && !pedido->datos) return ESP_ERR_INVALID_ARG;
+    if (pedido->op == ONEWIRE_CALIBRAR && !pedido->calib) return ESP_ERR_INVALID_ARG;
+    if (pedido->op == ONEWIRE_CENSO) pedido->segmento = 0;
+
+    if (xQueueSend(s_cola, &pedido, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Cola del bus llena");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t onewire_pedir(onewire_pedido_t *pedido) {
+    if (pedido) pedido->listo = NULL;
+    return encolar(pedido);
+}
+
+esp_err_t onewire_pedir_y_esperar(onewire_pedido_t *pedido) {
+    if (!s_cola) return ESP_ERR_INVALID_STATE;
+    if (xTaskGetCurrentTaskHandle() == s_tarea) return ESP_ERR_INVALID_STATE; // se trabaría sola
+    if (!pedido) return ESP_ERR_INVALID_ARG;
+
+    pedido->listo = xSemaphoreCreateBinary();
+    if (!pedido->listo) return ESP_ERR_NO_MEM;
+
+    esp_err_t err = encolar(pedido);
+    if (err == ESP_OK) {
+        xSemaphoreTake(pedido->listo, portMAX_DELAY);
+        err = pedido->err;
+    }
+    vSemaphoreDelete(pedido->listo);
+    pedido->listo = NULL;
+    return err;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_err.h"
+#include "ds2482.h"
+#include "ds2431.h"
+
+// ── Tarea del bus 1-Wire ──────────────────────────────────────────────────────
+//
+// Una sola tarea es dueña de los DS2482: hace el censo de todos los segmentos a
+// cadencia fija y atiende, entre censos, los pedidos que llegan por una cola
+// (censo extra, lectura de EEPROM en lote, escritura de un registro IDJ,
+// calibración de los tiempos del cable).
+// Nadie más toca el bus, así que un commit de NVS o un publish MQTT lento en
+// otra tarea ya no corren el próximo censo.
+//
+// Los avisos (resultado del censo y callbacks de pedidos) se ejecutan en la
+// tarea del bus: tienen que ser cortos y no bloquear. Pueden encolar pedidos.
+// ─────────────────────────────────────────────────────────────────────────────
+#define ONEWIRE_MAX_SEGMENTOS  8
+#define ONEWIRE_COLA_LEN       8
+
+typedef struct {
+    ds2482_t       *bus;
+    ds2482_censo_t *censo;
+    ds2431_lote_t  *lote;
+    uint64_t       *roms;            // salida del censo
+    size_t          max_roms;
+} onewire_segmento_t;
+
+// ── Resultado de un censo ─────────────────────────────────────────────────────
+typedef struct {
+    esp_err_t err;                   // del reset de presencia o del censo
+    bool      presencia;
+    size_t    found;                 // ROMs válidas en onewire_segmento_t.roms
+} onewire_censo_seg_t;
+
+typedef struct {
+    uint32_t            ciclo;       // 0 en el primer censo, +1 en cada uno
+    bool                error_bus;   // falló el reset de algún segmento: no se censó
+    onewire_censo_seg_t seg[ONEWIRE_MAX_SEGMENTOS];
+} onewire_censo_t;
+
+// El puntero vale solo durante la llamada
+typedef void (*onewire_censo_fn)(const onewire_censo_t *censo, void *ctx);
+
+// ── Pedidos ───────────────────────────────────────────────────────────────────
+typedef enum {
+    ONEWIRE_CENSO,                   // censo inmediato, fuera de la cadencia
+    ONEWIRE_LEER,                    // ds2431_leer_lote() sobre un segmento
+    ONEWIRE_ESCRIBIR,                // ds2431_escribir_datos_diff() a una ROM
+    ONEWIRE_CALIBRAR,                // ds2482_calibrar() con la familia y la confirmación del censo
+} onewire_op_t;
+
+typedef struct onewire_pedido onewire_pedido_t;
+typedef void (*onewire_hecho_fn)(onewire_pedido_t *pedido);
+
+// El pedido y sus buffers pertenecen a quien lo encola y tienen que seguir
+// vivos hasta el aviso de fin. La tarea del bus no los copia.
+struct onewire_pedido {
+    onewire_op_t         op;
+    size_t               segmento;   // todos menos CENSO: índice en la config
+
+    ds2431_lectura_t    *lecturas;   // LEER: entrada/salida
+    size_t               n;
+    uint64_t             rom;        // ESCRIBIR
+    const ds2431_data_t *datos;
+    ds2482_calib_t      *calib;      // CALIBRAR: salida
+
+    onewire_hecho_fn     hecho;      // opcional, en la tarea del bus
+    void                *ctx;
+    esp_err_t            err;        // salida
+
+    SemaphoreHandle_t    listo;      // interno: onewire_pedir_y_esperar()
+};
+
+// ── Configuración ─────────────────────────────────────────────────────────────
+typedef struct {
+    onewire_segmento_t *segmentos;   // se copian; los punteros deben seguir vivos
+    size_t              n;
+    uint32_t            periodo_ms;      // cadencia del censo
+    uint32_t            primer_censo_ms; // espera antes del primero (estabilizar el bus)
+    onewire_censo_fn    censo_hecho;
+    void               *ctx;
+    uint32_t            stack;
+    UBaseType_t         prioridad;
+    bool                watchdog;        // la tarea se suscribe al task WDT
+} onewire_config_t;
+
+esp_err_t onewire_iniciar(const onewire_config_t *cfg);
+
+// Encola sin bloquear. ESP_ERR_NO_MEM si la cola está llena.
+esp_err_t onewire_pedir(onewire_pedido_t *pedido);
+
+// Encola y espera el fin; devuelve pedido->err. No se puede llamar desde la
+// tarea del bus (ESP_ERR_INVALID_STATE).
+esp_err_t onewire_pedir_y_esperar(onewire_pedido_t *pedido);
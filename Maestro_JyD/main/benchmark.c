@@ -0,0 +1,580 @@
+// Banco de pruebas del stack 1-Wire sobre el bus simulado. Corre en el ESP32
+// al arrancar el Maestro (CONFIG_IDJ_BENCHMARK); no hay build de host.
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ds2482.h"
+#include "ds2482_sim.h"
+#include "ds2431.h"
+#include "crc.h"
+#include "benchmark.h"
+
+#define TAG "BENCH"
+
+#define BENCH_REPETICIONES  10
+#define BENCH_MAX_ROMS      DS2482_SIM_MAX_ESCLAVOS
+#define BENCH_FAMILIA_AJENA 0x28    // DS18B20
+
+typedef struct {
+    int64_t            t0;
+    ds2482_stats_t     drv;
+    ds2482_sim_stats_t sim;
+    uint32_t           fallos;
+    uint32_t           n;
+} medida_t;
+
+static void medida_iniciar(medida_t *m, ds2482_t *bus) {
+    memset(m, 0, sizeof(*m));
+    ds2482_stats_reset(bus);
+    ds2482_sim_stats_reset();
+    m->t0 = esp_timer_get_time();
+}
+
+static void medida_informar(const medida_t *m, ds2482_t *bus, const char *nombre) {
+    int64_t total_us = esp_timer_get_time() - m->t0;
+    ds2482_stats_t drv;
+    ds2482_sim_stats_t sim;
+    ds2482_stats_obtener(bus, &drv);
+    ds2482_sim_stats_obtener(&sim);
+
+    uint32_t n = m->n ? m->n : 1;
+    ESP_LOGI(TAG, "%-10s n=%-3lu %6lu us/op | I2C %4lu trans/op %6lu us/op | 1-Wire %6lu us/op | reintentos %lu | fallos %lu | ruido %lu bits, %lu (1,1)",
+             nombre, (unsigned long)m->n,
+             (unsigned long)(total_us / n),
+             (unsigned long)(drv.i2c_transacciones / n), (unsigned long)(sim.i2c_us / n),
+             (unsigned long)(sim.bus_us / n),
+             (unsigned long)drv.reintentos, (unsigned long)m->fallos,
+             (unsigned long)sim.bits_invertidos, (unsigned long)sim.conflictos);
+}
+
+// ── Censo por ramas: enganches y desenganches en un tren de 20 jaulas ────────
+// Cada evento se mide con el censo (revisión por ramas) y con el barrido
+// completo que hacía falta antes ante cualquier cambio. El bus simulado queda
+// con el tren armado.
+#define BENCH_TREN  20
+
+static void censo_ciclo(ds2482_t *bus, ds2482_censo_t *censo, uint64_t *roms,
+                        const char *nombre) {
+    medida_t m;
+    size_t found = 0;
+    medida_iniciar(&m, bus);
+    if (ds2482_censo_actualizar(bus, censo, roms, BENCH_MAX_ROMS, &found) != ESP_OK) m.fallos++;
+    m.n = 1;
+    medida_informar(&m, bus, nombre);
+    ESP_LOGI(TAG, "  censo: %d ROMs, %s, %d ramas, %d subárboles", (int)found,
+             censo->ultimo_fue_barrido ? "barrido" : "por ramas",
+             censo->ultimo_recorridos, censo->ultimo_subarboles);
+}
+
+static void barrido_referencia(ds2482_t *bus, uint64_t *roms) {
+    medida_t m;
+    size_t found = 0;
+    medida_iniciar(&m, bus);
+    if (ds2482_search_familia(bus, DS2431_FAMILY_CODE, roms, BENCH_MAX_ROMS, &found) != ESP_OK) {
+        m.fallos++;
+    }
+    m.n = 1;
+    medida_informar(&m, bus, "barrido");
+}
+
+static void benchmark_censo(ds2482_t *bus, uint8_t canal) {
+    static uint64_t tren[BENCH_TREN + 1];
+    static uint64_t roms[BENCH_MAX_ROMS];
+    static ds2482_censo_t censo;
+
+    ESP_LOGI(TAG, "--- Censo por ramas: tren de %d jaulas ---", BENCH_TREN);
+    ds2482_sim_vaciar();
+    for (size_t i = 0; i <= BENCH_TREN; i++) {
+        tren[i] = ds2482_sim_rom_nueva(canal, DS2431_FAMILY_CODE);
+        if (i < BENCH_TREN) ds2482_sim_agregar(bus->address, canal, tren[i]);
+    }
+
+    // Sin descubrimiento periódico: cada evento fuerza el suyo
+    ds2482_censo_init(&censo, UINT8_MAX, DS2431_FAMILY_CODE, ds2431_confirmar_presencia);
+    censo_ciclo(bus, &censo, roms, "inicial");
+    censo_ciclo(bus, &censo, roms, "estable");
+
+    // Desenganche de una jaula del medio
+    ds2482_sim_quitar(tren[BENCH_TREN / 2]);
+    censo_ciclo(bus, &censo, roms, "desengan.");
+    barrido_referencia(bus, roms);
+
+    // Enganche de una jaula nueva: lo ve el ciclo de descubrimiento
+    ds2482_sim_agregar(bus->address, canal, tren[BENCH_TREN]);
+    censo.ciclos_barrido = 1;
+    censo_ciclo(bus, &censo, roms, "enganche");
+    barrido_referencia(bus, roms);
+
+    // Cambio de jaula en el mismo ciclo: sale una, entra la desenganchada
+    ds2482_sim_quitar(tren[0]);
+    ds2482_sim_agregar(bus->address, canal, tren[BENCH_TREN / 2]);
+    censo_ciclo(bus, &censo, roms, "cambio");
+    barrido_referencia(bus, roms);
+}
+
+// ── Backend I2C: transacción combinada contra una por paso ───────────────────
+// El mismo Read Memory de 40 bytes (el registro IDJ completo) sobre el mismo
+// bus simulado con cada backend del driver. Con cable lento los polls dentro
+// del link no alcanzan y se ve la caída al busy_wait.
+#define BENCH_READ_LEN  40
+
+static void medir_read_memory(ds2482_t *bus, const uint64_t *roms, size_t found,
+                              bool combinada, const uint8_t (*ref)[BENCH_READ_LEN]) {
+    ds2482_sim_transaccion_combinada(combinada);
+    medida_t m;
+    medida_iniciar(&m, bus);
+    for (int r = 0; r < BENCH_REPETICIONES; r++) {
+        for (size_t i = 0; i < found; i++) {
+            ds2431_t esclavo = { .rom_code = roms[i] };
+            uint8_t buf[BENCH_READ_LEN];
+            esp_err_t err = ds2431_read_memory(bus, &esclavo, 0x00, buf, sizeof(buf));
+            if (err != ESP_OK || memcmp(buf, ref[i], sizeof(buf)) != 0) m.fallos++;
+            m.n++;
+        }
+    }
+    medida_informar(&m, bus, combinada ? "rm link" : "rm simple");
+    ds2482_stats_t drv;
+    ds2482_stats_obtener(bus, &drv);
+    ESP_LOGI(TAG, "  %lu bytes: %lu esperas busy_wait, %lu desincronizados",
+             (unsigned long)BENCH_READ_LEN, (unsigned long)drv.link_esperas,
+             (unsigned long)drv.desincronizados);
+    ds2482_sim_transaccion_combinada(false);
+}
+
+static void benchmark_backend(ds2482_t *bus, const uint64_t *roms, size_t found) {
+    static uint8_t ref[BENCH_MAX_ROMS][BENCH_READ_LEN];
+    ESP_LOGI(TAG, "--- Backend I2C: Read Memory de %d bytes ---", BENCH_READ_LEN);
+    for (size_t i = 0; i < found; i++) {
+        const uint8_t *mem = ds2482_sim_memoria(roms[i]);
+        if (mem) memcpy(ref[i], mem, BENCH_READ_LEN);
+    }
+    medir_read_memory(bus, roms, found, false, ref);
+    medir_read_memory(bus, roms, found, true, ref);
+}
+
+// ── Censo estable contra barrido, de 1 a BENCH_TREN jaulas ───────────────────
+// Tiempo de bus de un ciclo del censo sin cambios (solo confirmaciones) al
+// lado del barrido por familia que haría falta en cada ciclo sin censo. Las
+// jaulas se enganchan de a una; cada N arranca con un censo nuevo.
+static void benchmark_censo_escala(ds2482_t *bus, uint8_t canal) {
+    static uint64_t roms[BENCH_MAX_ROMS];
+    static ds2482_censo_t censo;
+
+    ESP_LOGI(TAG, "--- Censo estable vs barrido: 1 a %d jaulas ---", BENCH_TREN);
+    ds2482_sim_vaciar();
+    for (int n = 1; n <= BENCH_TREN; n++) {
+        ds2482_sim_agregar(bus->address, canal, ds2482_sim_rom_nueva(canal, DS2431_FAMILY_CODE));
+
+        size_t found = 0;
+        uint32_t fallos = 0;
+        ds2482_censo_init(&censo, UINT8_MAX, DS2431_FAMILY_CODE, ds2431_confirmar_presencia);
+        ds2482_censo_actualizar(bus, &censo, roms, BENCH_MAX_ROMS, &found);   // barrido inicial
+
+        ds2482_sim_stats_t sim;
+        ds2482_sim_stats_reset();
+        if (ds2482_censo_actualizar(bus, &censo, roms, BENCH_MAX_ROMS, &found) != ESP_OK ||
+            found != (size_t)n || censo.ultimo_fue_barrido) {
+            fallos++;
+        }
+        ds2482_sim_stats_obtener(&sim);
+        uint32_t censo_us  = censo.ultimo_bus_us;
+        uint32_t censo_1w  = (uint32_t)sim.bus_us;
+
+        ds2482_sim_stats_reset();
+        int64_t t0 = esp_timer_get_time();
+        if (ds2482_search_familia(bus, DS2431_FAMILY_CODE, roms, BENCH_MAX_ROMS, &found) != ESP_OK ||
+            found != (size_t)n) {
+            fallos++;
+        }
+        uint32_t barrido_us = (uint32_t)(esp_timer_get_time() - t0);
+        ds2482_sim_stats_obtener(&sim);
+        uint32_t barrido_1w = (uint32_t)sim.bus_us;
+
+        ESP_LOGI(TAG, "N=%2d | censo %3lu.%02lu ms (1-Wire %3lu.%02lu) | barrido %3lu.%02lu ms (1-Wire %3lu.%02lu) | fallos %lu",
+                 n,
+                 (unsigned long)(censo_us / 1000),   (unsigned long)(censo_us % 1000 / 10),
+                 (unsigned long)(censo_1w / 1000),   (unsigned long)(censo_1w % 1000 / 10),
+                 (unsigned long)(barrido_us / 1000), (unsigned long)(barrido_us % 1000 / 10),
+                 (unsigned long)(barrido_1w / 1000), (unsigned long)(barrido_1w % 1000 / 10),
+                 (unsigned long)fallos);
+    }
+}
+
+// ── Calibración de tiempos: tramo corto y cable largo ────────────────────────
+// Se calibra con el tren armado y se compara un barrido con las pausas de 80 m
+// (nivel 0) contra el nivel elegido. El cable largo se simula con una
+// estabilización tras el Search ROM que solo los primeros niveles respetan.
+static void barrido_nivel(ds2482_t *bus, uint64_t *roms, uint8_t nivel) {
+    char nombre[16];
+    snprintf(nombre, sizeof(nombre), "nivel %d", nivel);
+    ds2482_tiempos_aplicar(bus, nivel);
+    medida_t m;
+    size_t found = 0;
+    medida_iniciar(&m, bus);
+    if (ds2482_search_familia(bus, DS2431_FAMILY_CODE, roms, BENCH_MAX_ROMS, &found) != ESP_OK ||
+        found == 0) {
+        m.fallos++;
+    }
+    m.n = 1;
+    medida_informar(&m, bus, nombre);
+}
+
+static void benchmark_calibracion(ds2482_t *bus, const char *tramo, uint32_t estabilizacion_us) {
+    static uint64_t roms[BENCH_MAX_ROMS];
+    ds2482_sim_config_t previa, cfg;
+    ds2482_sim_config_obtener(&previa);
+    cfg = previa;
+    cfg.estabilizacion_us = estabilizacion_us;
+    ds2482_sim_configurar(&cfg);
+
+    ESP_LOGI(TAG, "--- Calibración: %s (estabilización %lu us) ---", tramo,
+             (unsigned long)estabilizacion_us);
+    ds2482_calib_t calib;
+    medida_t m;
+    medida_iniciar(&m, bus);
+    if (ds2482_calibrar(bus, DS2431_FAMILY_CODE, ds2431_confirmar_presencia, &calib) != ESP_OK) {
+        m.fallos++;
+    }
+    m.n = 1;
+    medida_informar(&m, bus, "calibrar");
+    for (uint8_t i = 0; i < calib.probados; i++) {
+        ESP_LOGI(TAG, "  nivel %d: %lu errores, %lu ms", i,
+                 (unsigned long)calib.errores[i], (unsigned long)calib.duracion_ms[i]);
+    }
+
+    uint8_t elegido = calib.nivel;
+    barrido_nivel(bus, roms, 0);
+    if (elegido != 0) barrido_nivel(bus, roms, elegido);
+
+    ds2482_tiempos_aplicar(bus, 0);
+    ds2482_sim_configurar(&previa);
+}
+
+// ── Varios bridges: búsqueda intercalada contra una detrás de otra ───────────
+// Dos DS2482-100 y dos canales de un DS2482-800 en el mismo I2C, cada segmento
+// con su tramo de jaulas. ds2482_search_rom_multi() usa el I2C mientras cada
+// bridge ejecuta su comando; los dos canales del -800 comparten el master y
+// se turnan (un comando en vuelo por chip). Los bridges quedan conectados.
+#define BENCH_MULTI_SEGS    4
+#define BENCH_MULTI_JAULAS  5
+
+static bool multi_completo(const ds2482_t *seg, const uint64_t *roms, size_t found) {
+    uint64_t esperadas[BENCH_MAX_ROMS];
+    uint8_t canal = seg->chip ? seg->canal : 0;
+    size_t n = ds2482_sim_roms(seg->address, canal, esperadas, BENCH_MAX_ROMS);
+    if (found != n) return false;
+    for (size_t i = 0; i < n; i++) {
+        size_t j = 0;
+        while (j < found && roms[j] != esperadas[i]) j++;
+        if (j == found) return false;
+    }
+    return true;
+}
+
+static void multi_informar(ds2482_t *segs, int64_t t0, uint32_t n, uint32_t fallos,
+                           const char *nombre) {
+    int64_t total_us = esp_timer_get_time() - t0;
+    uint32_t trans = 0;
+    for (size_t s = 0; s < BENCH_MULTI_SEGS; s++) {
+        ds2482_stats_t drv;
+        ds2482_stats_obtener(&segs[s], &drv);
+        trans += drv.i2c_transacciones;
+    }
+    ds2482_sim_stats_t sim;
+    ds2482_sim_stats_obtener(&sim);
+    ESP_LOGI(TAG, "%-10s n=%-3lu %6lu us/op | I2C %4lu trans/op %6lu us/op | 1-Wire %6lu us/op | fallos %lu",
+             nombre, (unsigned long)n, (unsigned long)(total_us / n),
+             (unsigned long)(trans / n), (unsigned long)(sim.i2c_us / n),
+             (unsigned long)(sim.bus_us / n), (unsigned long)fallos);
+}
+
+static void multi_reset(ds2482_t *segs) {
+    for (size_t s = 0; s < BENCH_MULTI_SEGS; s++) ds2482_stats_reset(&segs[s]);
+    ds2482_sim_stats_reset();
+}
+
+static void benchmark_multi(ds2482_t *bus) {
+    static ds2482_t      segs[BENCH_MULTI_SEGS];
+    static ds2482_chip_t chip;
+    static uint64_t      roms[BENCH_MULTI_SEGS][BENCH_MAX_ROMS];
+    const uint8_t dir_100[2] = { DS2482_I2C_ADDR + 1, DS2482_I2C_ADDR + 2 };
+    const uint8_t dir_800    = DS2482_I2C_ADDR + 4;
+
+    ESP_LOGI(TAG, "--- Varios bridges: 2 x DS2482-100 + 2 canales de un -800, %d jaulas c/u ---",
+             BENCH_MULTI_JAULAS);
+    for (int j = 0; j < BENCH_MULTI_JAULAS; j++) {
+        for (uint8_t i = 0; i < 2; i++) {
+            ds2482_sim_agregar(dir_100[i], 0, ds2482_sim_rom_nueva(0, DS2431_FAMILY_CODE));
+            ds2482_sim_agregar(dir_800, i, ds2482_sim_rom_nueva(i, DS2431_FAMILY_CODE));
+        }
+    }
+    esp_err_t err = ESP_OK;
+    for (uint8_t i = 0; i < 2 && err == ESP_OK; i++) {
+        err = ds2482_init(&segs[i], bus->i2c_num, dir_100[i]);
+    }
+    if (err == ESP_OK) err = ds2482_800_init(&chip, bus->i2c_num, dir_800);
+    for (uint8_t c = 0; c < 2 && err == ESP_OK; c++) {
+        err = ds2482_800_canal(&segs[2 + c], &chip, c);
+    }
+    for (size_t s = 0; s < BENCH_MULTI_SEGS && err == ESP_OK; s++) {
+        err = ds2482_configure(&segs[s], DS2482_CFG_APU);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Bridges simulados: %s", esp_err_to_name(err));
+        return;
+    }
+
+    // Una detrás de otra, como con un solo bridge
+    uint32_t fallos = 0;
+    multi_reset(segs);
+    int64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_REPETICIONES; r++) {
+        for (size_t s = 0; s < BENCH_MULTI_SEGS; s++) {
+            size_t found = 0;
+            err = ds2482_search_rom_all(&segs[s], roms[s], BENCH_MAX_ROMS, &found);
+            if (err != ESP_OK || !multi_completo(&segs[s], roms[s], found)) fallos++;
+        }
+    }
+    multi_informar(segs, t0, BENCH_REPETICIONES, fallos, "secuencial");
+
+    // Intercalada
+    ds2482_scan_t scans[BENCH_MULTI_SEGS];
+    fallos = 0;
+    multi_reset(segs);
+    t0 = esp_timer_get_time();
+    for (int r = 0; r < BENCH_REPETICIONES; r++) {
+        memset(scans, 0, sizeof(scans));
+        for (size_t s = 0; s < BENCH_MULTI_SEGS; s++) {
+            scans[s].dev         = &segs[s];
+            scans[s].roms        = roms[s];
+            scans[s].max_devices = BENCH_MAX_ROMS;
+        }
+        err = ds2482_search_rom_multi(scans, BENCH_MULTI_SEGS);
+        for (size_t s = 0; s < BENCH_MULTI_SEGS; s++) {
+            if (err != ESP_OK || scans[s].err != ESP_OK ||
+                !multi_completo(&segs[s], roms[s], scans[s].found)) {
+                fallos++;
+            }
+        }
+    }
+    multi_informar(segs, t0, BENCH_REPETICIONES, fallos, "intercal.");
+}
+
+// ── CRC: implementación elegida en menuconfig ─────────────────────────────────
+// Tiempo por byte de cada CRC en buffers del largo que usa el stack (ROM,
+// página de Read Memory, registro IDJ) y control de que alimentarlo por tramos
+// dé lo mismo que de una vez. Las tres implementaciones se comparan en la
+// prueba de host de components/crc/host_test.
+#if CONFIG_CRC_IMPL_TABLA_256
+#define CRC_IMPL_NOMBRE  "tabla 256"
+#elif CONFIG_CRC_IMPL_TABLA_16
+#define CRC_IMPL_NOMBRE  "tabla 16"
+#else
+#define CRC_IMPL_NOMBRE  "bit a bit"
+#endif
+
+#define CRC_BENCH_BYTES  (64 * 1024)
+
+static uint32_t s_crc_semilla = 1;
+
+static uint8_t crc_bench_byte(void) {
+    s_crc_semilla = s_crc_semilla * 1103515245u + 12345u;
+    return (uint8_t)(s_crc_semilla >> 16);
+}
+
+static void benchmark_crc(void) {
+    static const size_t largos[] = { 8, BENCH_READ_LEN, 128 };
+    uint8_t buf[128];
+    uint32_t fallos = 0, acum = 0;
+
+    ESP_LOGI(TAG, "--- CRC: %s ---", CRC_IMPL_NOMBRE);
+    for (size_t k = 0; k < sizeof(largos) / sizeof(largos[0]); k++) {
+        size_t len = largos[k];
+        for (size_t j = 0; j < len; j++) buf[j] = crc_bench_byte();
+
+        // Por tramos de largo aleatorio, como llegan del bus
+        for (int r = 0; r < 100; r++) {
+            uint8_t c8 = CRC8_INICIAL;
+            uint16_t c16 = CRC16_IDJ_INICIAL, cow = CRC16_OW_INICIAL;
+            size_t pos = 0;
+            while (pos < len) {
+                size_t tramo = 1 + crc_bench_byte() % (len - pos);
+                c8  = crc8_maxim_actualizar(c8, buf + pos, tramo);
+                c16 = crc16_idj_actualizar(c16, buf + pos, tramo);
+                cow = crc16_ow_actualizar(cow, buf + pos, tramo);
+                pos += tramo;
+            }
+            if (c8 != crc8_maxim(buf, len) || c16 != crc16_idj(buf, len) ||
+                cow != crc16_ow(buf, len)) {
+                fallos++;
+            }
+        }
+
+        int64_t t0 = esp_timer_get_time();
+        for (size_t n = 0; n < CRC_BENCH_BYTES; n += len) acum += crc8_maxim(buf, len);
+        int64_t t1 = esp_timer_get_time();
+        for (size_t n = 0; n < CRC_BENCH_BYTES; n += len) acum += crc16_idj(buf, len);
+        int64_t t2 = esp_timer_get_time();
+        for (size_t n = 0; n < CRC_BENCH_BYTES; n += len) acum += crc16_ow(buf, len);
+        int64_t t3 = esp_timer_get_time();
+
+        ESP_LOGI(TAG, "%3d bytes | crc8 %4lu ns/byte | crc16 idj %4lu ns/byte | crc16 1-Wire %4lu ns/byte",
+                 (int)len,
+                 (unsigned long)((t1 - t0) * 1000 / CRC_BENCH_BYTES),
+                 (unsigned long)((t2 - t1) * 1000 / CRC_BENCH_BYTES),
+                 (unsigned long)((t3 - t2) * 1000 / CRC_BENCH_BYTES));
+    }
+    ESP_LOGI(TAG, "crc: %lu fallos por tramos (control %08lx)", (unsigned long)fallos,
+             (unsigned long)acum);
+}
+
+// dolly = 0: registro sin dolly. diff: escritura diferencial sobre lo que
+// haya en la EEPROM.
+static void medir_escritura(ds2482_t *bus, const uint64_t *roms, size_t found,
+                            uint16_t dolly, bool diff, const char *nombre) {
+    medida_t m;
+    uint32_t bloques = 0;
+    medida_iniciar(&m, bus);
+    for (size_t i = 0; i < found; i++) {
+        ds2431_t esclavo = { .rom_code = roms[i] };
+        ds2431_data_t datos = {
+            .numero_jaula = (uint16_t)(1000 + i),
+            .numero_dolly = dolly,
+            .tiene_dolly  = dolly > 0,
+            .timestamp    = 1700000000 + i,
+        };
+        ds2431_generar_unidad_jaula(datos.numero_jaula, datos.unidad_jaula);
+        if (dolly) ds2431_generar_unidad_dolly(dolly, datos.unidad_dolly);
+        esp_err_t err;
+        if (diff) {
+            uint8_t escritos = 0;
+            err = ds2431_escribir_datos_diff(bus, &esclavo, &datos, NULL, &escritos);
+            bloques += (uint32_t)__builtin_popcount(escritos);
+        } else {
+            err = ds2431_escribir_datos(bus, &esclavo, &datos);
+            bloques += (uint32_t)__builtin_popcount(DS2431_BLOQUES_V3);
+        }
+        if (err != ESP_OK) m.fallos++;
+        m.n++;
+    }
+    medida_informar(&m, bus, nombre);
+    ds2482_sim_stats_t sim;
+    ds2482_sim_stats_obtener(&sim);
+    ESP_LOGI(TAG, "%s: %lu bloques grabados en %lu registros, %lu copias cortadas en tPROG",
+             nombre, (unsigned long)bloques, (unsigned long)m.n,
+             (unsigned long)sim.copias_cortadas);
+}
+
+void benchmark_bus(ds2482_t *bus) {
+    ds2482_sim_config_t cfg;
+    ds2482_sim_config_obtener(&cfg);
+    ESP_LOGI(TAG, "=== BENCHMARK 1-Wire (bus simulado: cable +%lu us, BER %lu ppm, conflictos %lu ppm) ===",
+             (unsigned long)cfg.demora_cable_us, (unsigned long)cfg.ber_ppm,
+             (unsigned long)cfg.conflicto_ppm);
+
+    // ── Búsqueda ─────────────────────────────────────────────────────────────
+    static uint64_t roms[BENCH_MAX_ROMS];   // fuera del stack de app_main
+    size_t found = 0;
+    medida_t m;
+    medida_iniciar(&m, bus);
+    for (int i = 0; i < BENCH_REPETICIONES; i++) {
+        esp_err_t err = ds2482_search_rom_all(bus, roms, BENCH_MAX_ROMS, &found);
+        if (err != ESP_OK) m.fallos++;
+        m.n++;
+    }
+    medida_informar(&m, bus, "busqueda");
+
+    if (found == 0) {
+        ESP_LOGW(TAG, "Sin esclavos en el bus simulado — nada más que medir");
+        return;
+    }
+
+    // ── Escritura del registro IDJ ───────────────────────────────────────────
+    // Con el perfil del cable de 80 m y con el del banco del programador
+    // (tramo corto, sin pausas): ahí el tiempo es casi todo programación.
+    medir_escritura(bus, roms, found, 0, false, "escritura");
+    ds2482_tiempos_aplicar(bus, DS2482_TIEMPOS_NIVELES - 1);
+    medir_escritura(bus, roms, found, 0, false, "escr banco");
+    ds2482_tiempos_aplicar(bus, 0);
+
+    // Reetiquetado: mismos datos (no graba nada), dolly agregado y quitado
+    medir_escritura(bus, roms, found, 0, true, "diff igual");
+    medir_escritura(bus, roms, found, 512, true, "diff dolly");
+    medir_escritura(bus, roms, found, 0, true, "diff quita");
+
+    // ── Lectura del registro IDJ ─────────────────────────────────────────────
+    medida_iniciar(&m, bus);
+    for (int r = 0; r < BENCH_REPETICIONES; r++) {
+        for (size_t i = 0; i < found; i++) {
+            ds2431_t esclavo = { .rom_code = roms[i] };
+            ds2431_data_t datos;
+            esp_err_t err = ds2431_leer_datos(bus, &esclavo, &datos);
+            if (err != ESP_OK || !datos.valido) m.fallos++;
+            m.n++;
+        }
+    }
+    medida_informar(&m, bus, "lectura");
+    benchmark_backend(bus, roms, found);
+
+    // ── Lectura del registro IDJ en overdrive ────────────────────────────────
+    // Tabla propia y siempre habilitada, independiente de CONFIG_DS2431_OVERDRIVE.
+    // Con cable largo las ROMs caen a estándar y la medida incluye el fallback.
+    static ds2431_od_t od;
+    ds2431_od_init(&od, true);
+    medida_iniciar(&m, bus);
+    for (int r = 0; r < BENCH_REPETICIONES; r++) {
+        for (size_t i = 0; i < found; i++) {
+            ds2431_t esclavo = { .rom_code = roms[i] };
+            ds2431_data_t datos;
+            esp_err_t err = ds2431_leer_datos_od(bus, &od, &esclavo, &datos);
+            if (err != ESP_OK || !datos.valido) m.fallos++;
+            m.n++;
+        }
+    }
+    medida_informar(&m, bus, "lectura od");
+
+    size_t od_ok = 0;
+    for (size_t i = 0; i < found; i++) {
+        if (ds2431_od_estado(&od, roms[i]) == DS2431_OD_OK) od_ok++;
+    }
+    ESP_LOGI(TAG, "overdrive: %d/%d ROMs en overdrive, %lu lecturas od, %lu fallbacks",
+             (int)od_ok, (int)found, (unsigned long)od.lecturas_od, (unsigned long)od.fallbacks);
+
+    // ── Búsqueda por familia con esclavos ajenos en el bus ───────────────────
+    // Se agregan sondas de otra familia (0x28, DS18B20) hasta duplicar el bus;
+    // quedan conectadas para el resto de la ejecución.
+    uint8_t canal = bus->chip ? bus->canal : 0;
+    size_t esperadas = 0;
+    for (size_t i = 0; i < found; i++) {
+        if ((uint8_t)roms[i] == DS2431_FAMILY_CODE) esperadas++;
+    }
+    for (size_t i = 0; i < found; i++) {
+        ds2482_sim_agregar(bus->address, canal, ds2482_sim_rom_nueva(canal, BENCH_FAMILIA_AJENA));
+    }
+    size_t found_todas = 0, found_familia = 0;
+    medida_iniciar(&m, bus);
+    for (int i = 0; i < BENCH_REPETICIONES; i++) {
+        if (ds2482_search_rom_all(bus, roms, BENCH_MAX_ROMS, &found_todas) != ESP_OK) m.fallos++;
+        m.n++;
+    }
+    medida_informar(&m, bus, "busq todas");
+    medida_iniciar(&m, bus);
+    for (int i = 0; i < BENCH_REPETICIONES; i++) {
+        esp_err_t err = ds2482_search_familia(bus, DS2431_FAMILY_CODE, roms, BENCH_MAX_ROMS,
+                                              &found_familia);
+        if (err != ESP_OK || found_familia != esperadas) m.fallos++;
+        m.n++;
+    }
+    medida_informar(&m, bus, "busq 0x2D");
+    ESP_LOGI(TAG, "familia: %d ROMs en el bus, %d DS2431", (int)found_todas, (int)found_familia);
+
+    benchmark_censo_escala(bus, canal);
+    benchmark_censo(bus, canal);
+    benchmark_calibracion(bus, "tramo corto", 0);
+    benchmark_calibracion(bus, "cable largo", 8000);
+    benchmark_multi(bus);
+    benchmark_crc();
+
+    ESP_LOGI(TAG, "=== FIN BENCHMARK ===");
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "ds2482.h"
+
+// Banco de pruebas del stack 1-Wire sobre el bus simulado
+// (CONFIG_DS2482_BACKEND_SIM): búsqueda, lectura y escritura de EEPROM con
+// transacciones I2C, tiempo de bus simulado y reintentos por operación.
+// Corre en el ESP32; las cifras son del bus simulado, no de un bus real.
+void benchmark_bus(ds2482_t *bus);
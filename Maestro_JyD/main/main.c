@@ -5,6 +5,7 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "nvs.h"
 #include "nvs_flash.h"
@@ -18,9 +19,14 @@
 #include "driver/i2c.h"
 #include "ds2482.h"
 #include "ds2431.h"
+#include "onewire.h"
 #include "esp_system.h"
 #include "esp_task_wdt.h"
 
+#if CONFIG_IDJ_BENCHMARK
+#include "benchmark.h"
+#endif
+
 #define TAG "IDJ"
 
 // Configuración del bus I2C
@@ -30,33 +36,225 @@
 #define I2C_MASTER_FREQ_HZ   100000
 
 // Parámetros de escaneo
-#define MAX_DEVICES          20
+#define MAX_JAULAS           CONFIG_IDJ_MAX_JAULAS   // pool de todos los segmentos
+#define ROMS_SEGMENTO        DS2482_CENSO_MAX_ROMS   // lo que ve un censo
 #define AUSENCIAS_EVICTAR    5
 #define SCAN_INTERVAL_MS     3000   // Ciclo base: 3 segundos
 #define BUS_ERRORES_MAX      5
 #define CICLOS_EEPROM        10     // 10 × 3s = 30s entre lecturas completas de EEPROM
+#define CICLOS_BARRIDO       5      // 5 × 3s = 15s máx. para descubrir una jaula nueva
+#define CICLOS_CALIBRACION   1200   // 1200 × 3s = 1h entre calibraciones del cable
+#define CICLOS_SALUD         20     // 20 × 3s = 1 min entre bloques de salud por MQTT
+
+// Tarea del bus 1-Wire (censo y EEPROM); la principal publica
+#define BUS_TAREA_STACK      4096
+#define BUS_TAREA_PRIORIDAD  5
+#define ESPERA_CICLO_MS      (4 * SCAN_INTERVAL_MS)
+#define ESPERA_MQTT_MS       100    // sondeo de la conexión en el arranque tibio
+
+// Tarea de persistencia: agrupa los cambios y es la única que escribe NVS
+#define NVS_TAREA_STACK      4096
+#define NVS_TAREA_PRIORIDAD  2
+#define NVS_VENTANA_MS       (CONFIG_IDJ_NVS_VENTANA_S * 1000)
+#define NVS_PRESUPUESTO_HORA CONFIG_IDJ_NVS_ENTRADAS_HORA
+#define NVS_HORA_MS          (3600 * 1000)
+
+// Segmentos 1-Wire: con el DS2482-800 cada canal es un tramo de jaulas
+#if CONFIG_IDJ_DS2482_800
+#define NUM_SEGMENTOS        CONFIG_IDJ_SEGMENTOS
+#else
+#define NUM_SEGMENTOS        1
+#endif
+
+// ── Salud de una jaula: lo que cuesta en el bus desde el arranque ───────────
+typedef struct {
+    uint32_t lecturas;           // lecturas de EEPROM (incluye sin cambios)
+    uint32_t fallos;             // lecturas que terminaron con error
+    uint32_t reintentos;         // del driver y del lote durante sus lecturas
+    uint32_t crc_fallos;
+    uint32_t bus_ms;             // tiempo de bus de sus lecturas
+    uint16_t desconexiones;      // veces que pasó a ausente
+} salud_t;
 
 // ── Estructura de dispositivo v2 (con Dolly) ─────────────────────────────────
 typedef struct {
-    uint64_t rom;
-    char     rom_str[17];
+    uint64_t rom;                // en hex solo al serializar (rom_to_string)
+    uint8_t  segmento;           // canal donde se la vio por última vez
     char     unidad[12];
     char     unidad_dolly[12];
     bool     tiene_dolly;
     bool     asignado;
     uint8_t  ausencias;
     bool     presente;
+    bool     verificado;         // algún censo la confirmó o descartó desde el arranque
+
+    // Huella (timestamp + CRC) de la última lectura completa de la EEPROM:
+    // si no cambió, el ciclo de EEPROM no relee el registro
+    bool            huella_valida;
+    ds2431_huella_t huella;
+
+    salud_t         salud;       // no se persiste
+    bool            nvs_pendiente;   // registro por grabar en el próximo guardado
 } dispositivo_t;
 
-static dispositivo_t dispositivos[MAX_DEVICES];
-static size_t num_dispositivos = 0;
-static bool nvs_dirty = false;
+// ── Pool de jaulas ───────────────────────────────────────────────────────────
+// Slots fijos compartidos por todos los segmentos. Los libres se encadenan
+// por `siguiente`, así alta y baja son O(1) y una jaula no cambia de slot
+// mientras está registrada. Fuera de la tarea del bus se la nombra con un
+// handle (generación << 16 | slot): al liberar el slot la generación sube y
+// los handles viejos dejan de resolver en vez de apuntar a otra jaula.
+typedef uint32_t jaula_h;
+#define JAULA_NULA           0
+#define SLOT_NULO            0xFFFF
+
+typedef struct {
+    dispositivo_t d;
+    uint16_t      generacion;    // nunca 0: el handle 0 es JAULA_NULA
+    uint16_t      siguiente;     // libre: próximo slot libre
+    bool          en_uso;
+} slot_jaula_t;
+
+// ── Índice de ROMs ───────────────────────────────────────────────────────────
+// Direccionamiento abierto con sondeo lineal sobre la ROM de 64 bits; cada
+// entrada guarda el slot del pool. La ROM se mezcla con hashing de
+// Fibonacci, así el byte de familia (igual en todas) no pesa. Con la tabla a
+// menos de la mitad de carga la búsqueda toca uno o dos slots.
+#if MAX_JAULAS <= 64
+#define INDICE_BITS          7
+#elif MAX_JAULAS <= 128
+#define INDICE_BITS          8
+#else
+#define INDICE_BITS          9
+#endif
+#define INDICE_SLOTS         (1 << INDICE_BITS)
+_Static_assert(INDICE_SLOTS >= 2 * MAX_JAULAS, "INDICE_BITS chico para MAX_JAULAS");
+
+// ── Segmento 1-Wire: bus + sus jaulas del pool ───────────────────────────────
+typedef struct {
+    uint8_t        id;                       // canal del DS2482-800 (0 en el -100)
+    ds2482_t       bus;
+    // Censo incremental: confirma las ROMs conocidas con Match ROM y solo
+    // recorre el árbol completo cuando algo cambió o cada CICLOS_BARRIDO ciclos.
+    ds2482_censo_t censo;
+    uint64_t       roms[ROMS_SEGMENTO];      // resultado del último censo
+    uint16_t       miembros[MAX_JAULAS];     // slots del pool, en orden de alta
+    size_t         num_miembros;
+    ds2431_lote_t  lote;                     // recuperación adaptativa entre lecturas
+
+    // Lote de EEPROM en curso en la tarea del bus. Cada lectura guarda el
+    // handle de su jaula: si la evictan antes de que termine, no resuelve.
+    ds2431_lectura_t lecturas[ROMS_SEGMENTO];
+    jaula_h          lecturas_h[ROMS_SEGMENTO];
+    size_t           n_lecturas;
+    onewire_pedido_t pedido;
+    bool             lote_en_curso;          // un censo pedido puede llegar antes del lote
+
+    // Calibración de los tiempos del cable (nivel guardado en NVS)
+    ds2482_calib_t   calib;
+    onewire_pedido_t calib_pedido;
+    bool             calibrando;
+    bool             calibrado;              // false → se calibra apenas haya esclavos
+
+    ds2482_t       bus_copia;                // histograma y nivel, tomada entre operaciones
+} segmento_t;
+
+// ── Reparto entre tareas ─────────────────────────────────────────────────────
+// La tarea del bus es la única que modifica segmentos[] y el pool (desde sus
+// avisos, con el mutex tomado). La principal copia las jaulas en uso bajo el
+// mutex a la vista y muestra y publica desde la copia, así un publish lento
+// no retiene el mutex ni frena el próximo censo; la de persistencia copia
+// solo los registros pendientes y graba fuera del mutex. Cada jaula de la
+// vista lleva su handle para volver a pedirla con jaula_leer().
+typedef struct {
+    uint8_t       id;
+    ds2482_t      bus;
+} vista_segmento_t;
+
+typedef struct {
+    jaula_h       h;
+    dispositivo_t d;
+} vista_jaula_t;
+
+// ── Registro de una jaula en NVS ─────────────────────────────────────────────
+// Un blob de tamaño fijo por jaula en el namespace "jaulas", con clave "j" y
+// los 48 bits de serie de la ROM en hex (NVS admite claves de 15 caracteres).
+// Se graban solo los registros que cambiaron y la evicción borra su clave.
+#define NVS_NS_JAULAS        "jaulas"
+#define REGISTRO_VERSION     1
+#define REGISTRO_ASIGNADO    0x01
+#define REGISTRO_DOLLY       0x02
+#define REGISTRO_HUELLA      0x04
+
+typedef struct {
+    uint8_t  version;            // REGISTRO_VERSION
+    uint8_t  flags;              // REGISTRO_*
+    uint8_t  canal;
+    uint8_t  huella_version;
+    uint32_t huella_ts;
+    uint64_t rom;
+    uint16_t huella_crc;
+    char     unidad[12];
+    char     unidad_dolly[12];
+} registro_nvs_t;
+
+// ── Desgaste de la flash ─────────────────────────────────────────────────────
+// NVS escribe en entradas de 32 bytes, 126 por página de 4 KB, y borra una
+// página cuando la recicla. Un blob ocupa una entrada de índice más la
+// cabecera y los datos del chunk; borrar una clave solo marca sus entradas.
+// Los ciclos de borrado por sector se estiman como entradas escritas sobre
+// entradas totales de la partición, porque NVS rota las páginas en orden.
+// Los acumulados se guardan en NVS una vez por hora (con el presupuesto).
+#define NVS_ENTRADA_BYTES    32
+#define NVS_ENTRADAS_BLOB(len) (2 + ((len) + NVS_ENTRADA_BYTES - 1) / NVS_ENTRADA_BYTES)
+
+typedef struct {
+    uint32_t entradas;           // acumuladas desde que hay estadística
+    uint32_t commits;
+    uint32_t registros;          // blobs de jaula grabados
+    uint32_t bajas;              // claves borradas
+    uint32_t urgentes;           // commits adelantados por una asignación nueva
+    uint32_t postergados;        // commits que esperaron por el presupuesto
+} desgaste_t;
+
+static segmento_t       segmentos[NUM_SEGMENTOS];
+static slot_jaula_t     pool[MAX_JAULAS];
+static uint16_t         pool_libre = SLOT_NULO;
+static uint16_t         indice[INDICE_SLOTS];    // slot del pool o SLOT_NULO
+static bool             visto[MAX_JAULAS];       // solo en la tarea del bus
+static vista_segmento_t vista[NUM_SEGMENTOS];
+static vista_jaula_t    vista_jaulas[MAX_JAULAS]; // agrupadas por segmento
+static size_t           vista_num;
+static uint32_t         ultimo_ciclo;
+
+// Cambios por persistir, con el mutex tomado. nvs_desde marca el primer
+// cambio sin grabar: la ventana de agrupado corre desde ahí.
+static bool             nvs_dirty = false;
+static bool             nvs_urgente;             // asignación nueva: no espera la ventana
+static TickType_t       nvs_desde;
+static uint64_t         nvs_bajas[MAX_JAULAS];   // ROMs evictadas por borrar de NVS
+static size_t           nvs_num_bajas;
+static bool             nvs_reescribir;          // bajas desbordadas: regrabar todo
+static bool             tiempos_dirty = false;
+
+static SemaphoreHandle_t tabla_mutex;
+static TaskHandle_t      tarea_principal;
+static TaskHandle_t      tarea_nvs;
+static desgaste_t        desgaste;               // solo en la tarea de persistencia
+static desgaste_t        vista_desgaste;         // copia para publicar, con el mutex
+static size_t            lotes_pendientes;       // solo en la tarea del bus
+static uint8_t           errores_bus;            // solo en la tarea del bus
+
+#if CONFIG_IDJ_DS2482_800
+static ds2482_chip_t ds2482_800;
+#endif
 
 // ── Utilidades de ROM ─────────────────────────────────────────────────────────
-void rom_to_string(uint64_t rom, char *output) {
+// Devuelve `output` (17 bytes) para usarla directo en logs y JSON
+char *rom_to_string(uint64_t rom, char *output) {
     uint8_t *bytes = (uint8_t *)&rom;
     for (int i = 0; i < 8; i++) sprintf(output + (i * 2), "%02X", bytes[i]);
     output[16] = '\0';
+    return output;
 }
 
 uint64_t string_to_rom(const char *str) {
@@ -67,91 +265,281 @@ uint64_t string_to_rom(const char *str) {
 }
 
 bool rom_es_ds2431(uint64_t rom) {
-    return ((uint8_t)(rom & 0xFF) == 0x2D);
+    return ((uint8_t)(rom & 0xFF) == DS2431_FAMILY_CODE);
 }
 
-// ── NVS ───────────────────────────────────────────────────────────────────────
-void guardar_en_nvs() {
-    nvs_handle_t handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &handle);
-    if (err != ESP_OK) { ESP_LOGE(TAG, "Error NVS: %s", esp_err_to_name(err)); return; }
+// ── Índice de ROMs ────────────────────────────────────────────────────────────
+#define INDICE_SIG(h)  (((h) + 1) & (INDICE_SLOTS - 1))
 
-    cJSON *root  = cJSON_CreateObject();
-    cJSON *array = cJSON_AddArrayToObject(root, "devices");
+static size_t indice_hash(uint64_t rom) {
+    return (size_t)((rom * 0x9E3779B97F4A7C15ULL) >> (64 - INDICE_BITS));
+}
 
-    for (size_t i = 0; i < num_dispositivos; i++) {
-        cJSON *obj = cJSON_CreateObject();
-        cJSON_AddStringToObject(obj, "rom",          dispositivos[i].rom_str);
-        cJSON_AddStringToObject(obj, "unidad",       dispositivos[i].unidad);
-        cJSON_AddStringToObject(obj, "unidad_dolly", dispositivos[i].unidad_dolly);
-        cJSON_AddBoolToObject  (obj, "tiene_dolly",  dispositivos[i].tiene_dolly);
-        cJSON_AddBoolToObject  (obj, "asignado",     dispositivos[i].asignado);
-        cJSON_AddItemToArray(array, obj);
+// Slot del pool con esa ROM, -1 si no está registrada
+static int buscar_jaula(uint64_t rom) {
+    for (size_t h = indice_hash(rom);; h = INDICE_SIG(h)) {
+        if (indice[h] == SLOT_NULO) return -1;
+        if (pool[indice[h]].d.rom == rom) return indice[h];
     }
+}
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (json_str) {
-        err = nvs_set_str(handle, "devices", json_str);
-        if (err != ESP_OK) ESP_LOGE(TAG, "Error guardando NVS: %s", esp_err_to_name(err));
-        nvs_commit(handle);
-        free(json_str);
+static void indice_insertar(uint16_t slot) {
+    size_t h = indice_hash(pool[slot].d.rom);
+    while (indice[h] != SLOT_NULO) h = INDICE_SIG(h);
+    indice[h] = slot;
+}
+
+// Borrado con corrimiento hacia atrás: sin lápidas, las búsquedas siguen
+// cortando en la primera entrada vacía
+static void indice_quitar(uint16_t slot) {
+    size_t h = indice_hash(pool[slot].d.rom);
+    while (indice[h] != slot) h = INDICE_SIG(h);
+    indice[h] = SLOT_NULO;
+    for (size_t j = INDICE_SIG(h); indice[j] != SLOT_NULO; j = INDICE_SIG(j)) {
+        size_t k = indice_hash(pool[indice[j]].d.rom);
+        // Queda donde está si su posición ideal cae en (h, j] (circular)
+        bool en_su_tramo = (h <= j) ? (h < k && k <= j) : (h < k || k <= j);
+        if (en_su_tramo) continue;
+        indice[h] = indice[j];
+        indice[j] = SLOT_NULO;
+        h = j;
+    }
+}
+
+// ── Pool de jaulas ────────────────────────────────────────────────────────────
+static void registro_init(void) {
+    for (size_t i = 0; i < MAX_JAULAS; i++) {
+        pool[i].en_uso     = false;
+        pool[i].generacion = 1;
+        pool[i].siguiente  = (i + 1 < MAX_JAULAS) ? (uint16_t)(i + 1) : SLOT_NULO;
+    }
+    pool_libre = 0;
+    memset(indice, 0xFF, sizeof(indice));
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) segmentos[s].num_miembros = 0;
+}
+
+static jaula_h jaula_handle(uint16_t slot) {
+    return ((jaula_h)pool[slot].generacion << 16) | slot;
+}
+
+// Con el mutex tomado (o desde la tarea del bus). NULL si el handle venció.
+static dispositivo_t *jaula_resolver(jaula_h h) {
+    uint16_t slot = (uint16_t)(h & 0xFFFF);
+    if (h == JAULA_NULA || slot >= MAX_JAULAS) return NULL;
+    if (!pool[slot].en_uso || pool[slot].generacion != (uint16_t)(h >> 16)) return NULL;
+    return &pool[slot].d;
+}
+
+// Copia el estado actual de una jaula de la vista (u otro handle guardado).
+// false si la jaula fue evictada desde entonces.
+bool jaula_leer(jaula_h h, dispositivo_t *out) {
+    xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+    const dispositivo_t *d = jaula_resolver(h);
+    if (d) *out = *d;
+    xSemaphoreGive(tabla_mutex);
+    return d != NULL;
+}
+
+// Toma un slot libre para `rom` y lo suma al segmento. -1 con el pool lleno.
+static int jaula_alta(segmento_t *seg, uint64_t rom) {
+    if (pool_libre == SLOT_NULO) return -1;
+    uint16_t slot = pool_libre;
+    pool_libre = pool[slot].siguiente;
+
+    dispositivo_t *d = &pool[slot].d;
+    memset(d, 0, sizeof(*d));
+    d->rom      = rom;
+    d->segmento = seg->id;
+    pool[slot].en_uso = true;
+    indice_insertar(slot);
+    seg->miembros[seg->num_miembros++] = slot;
+    return slot;
+}
+
+static void miembro_quitar(segmento_t *seg, uint16_t slot) {
+    for (size_t i = 0; i < seg->num_miembros; i++) {
+        if (seg->miembros[i] != slot) continue;
+        memmove(&seg->miembros[i], &seg->miembros[i + 1],
+                (seg->num_miembros - i - 1) * sizeof(seg->miembros[0]));
+        seg->num_miembros--;
+        return;
+    }
+}
+
+static void jaula_baja(segmento_t *seg, uint16_t slot) {
+    indice_quitar(slot);
+    miembro_quitar(seg, slot);
+    pool[slot].en_uso = false;
+    if (++pool[slot].generacion == 0) pool[slot].generacion = 1;
+    pool[slot].siguiente = pool_libre;
+    pool_libre = slot;
+}
+
+// Una jaula que aparece en otro canal (se reordenó el tren) conserva sus datos
+static void jaula_mover(uint16_t slot, segmento_t *destino) {
+    dispositivo_t *d = &pool[slot].d;
+    miembro_quitar(&segmentos[d->segmento], slot);
+    destino->miembros[destino->num_miembros++] = slot;
+    ESP_LOGI(TAG, "Jaula %s: segmento %d → %d",
+             d->unidad[0] ? d->unidad : "SIN_ASIGNAR", d->segmento, destino->id);
+    d->segmento = destino->id;
+}
+
+// ── NVS ───────────────────────────────────────────────────────────────────────
+static void clave_registro(uint64_t rom, char *clave) {
+    snprintf(clave, 16, "j%012llx", (unsigned long long)((rom >> 8) & 0xFFFFFFFFFFFFULL));
+}
+
+static void registro_armar(const dispositivo_t *d, registro_nvs_t *r) {
+    memset(r, 0, sizeof(*r));
+    r->version = REGISTRO_VERSION;
+    r->flags   = (d->asignado ? REGISTRO_ASIGNADO : 0)
+               | (d->tiene_dolly ? REGISTRO_DOLLY : 0)
+               | (d->huella_valida ? REGISTRO_HUELLA : 0);
+    r->canal   = d->segmento;
+    r->rom     = d->rom;
+    if (d->huella_valida) {
+        r->huella_version = d->huella.version;
+        r->huella_ts      = d->huella.timestamp;
+        r->huella_crc     = d->huella.crc;
+    }
+    memcpy(r->unidad,       d->unidad,       sizeof(r->unidad));
+    memcpy(r->unidad_dolly, d->unidad_dolly, sizeof(r->unidad_dolly));
+}
+
+// ── Cambios por persistir (con el mutex tomado) ──────────────────────────────
+// La tarea del bus solo marca; la tarea de persistencia despierta con el
+// primer cambio para empezar a contar la ventana, y con uno urgente.
+static void avisar_persistencia(bool urgente) {
+    if (!nvs_dirty) nvs_desde = xTaskGetTickCount();
+    bool avisar = !nvs_dirty || (urgente && !nvs_urgente);
+    nvs_dirty = true;
+    if (urgente) nvs_urgente = true;
+    if (avisar && tarea_nvs) xTaskNotifyGive(tarea_nvs);
+}
+
+static void persistir(dispositivo_t *d) {
+    d->nvs_pendiente = true;
+    avisar_persistencia(false);
+}
+
+// Una unidad recién asignada se graba sin esperar la ventana: es lo que no
+// se puede perder si se corta la alimentación
+static void persistir_urgente(dispositivo_t *d) {
+    d->nvs_pendiente = true;
+    avisar_persistencia(true);
+}
+
+static void persistir_baja(uint64_t rom) {
+    if (nvs_num_bajas < MAX_JAULAS) nvs_bajas[nvs_num_bajas++] = rom;
+    else nvs_reescribir = true;
+    avisar_persistencia(false);
+}
+
+static void persistir_tiempos(void) {
+    tiempos_dirty = true;
+    avisar_persistencia(false);
+}
+
+// Graba el pool entero sobre un namespace vacío (migración, antes de arrancar
+// la tarea del bus)
+static esp_err_t grabar_todos_nvs(size_t *n) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NS_JAULAS, NVS_READWRITE, &handle);
+    if (err != ESP_OK) { ESP_LOGE(TAG, "Error NVS: %s", esp_err_to_name(err)); return err; }
+
+    nvs_erase_all(handle);
+    *n = 0;
+    char clave[16];
+    for (size_t s = 0; s < NUM_SEGMENTOS && err == ESP_OK; s++) {
+        const segmento_t *seg = &segmentos[s];
+        for (size_t i = 0; i < seg->num_miembros && err == ESP_OK; i++) {
+            registro_nvs_t r;
+            registro_armar(&pool[seg->miembros[i]].d, &r);
+            clave_registro(r.rom, clave);
+            err = nvs_set_blob(handle, clave, &r, sizeof(r));
+            if (err == ESP_OK) {
+                (*n)++;
+                desgaste.registros++;
+                desgaste.entradas += NVS_ENTRADAS_BLOB(sizeof(r));
+            }
+        }
     }
-    cJSON_Delete(root);
+    if (err == ESP_OK) err = nvs_commit(handle);
+    desgaste.commits++;
+    if (err != ESP_OK) ESP_LOGE(TAG, "Error grabando registros: %s", esp_err_to_name(err));
     nvs_close(handle);
+    return err;
 }
 
-void cargar_desde_nvs() {
+// Tabla en el formato anterior: un JSON con todas las jaulas en "devices".
+// Se carga, se graba como registros y recién entonces se borra la clave, así
+// un corte a mitad de camino repite la migración en el próximo arranque.
+static bool migrar_json_nvs(void) {
     nvs_handle_t handle;
     esp_err_t err = nvs_open("storage", NVS_READWRITE, &handle);
-    if (err != ESP_OK) { ESP_LOGE(TAG, "Error NVS: %s", esp_err_to_name(err)); return; }
+    if (err != ESP_OK) { ESP_LOGE(TAG, "Error NVS: %s", esp_err_to_name(err)); return false; }
 
     size_t required_size = 0;
     err = nvs_get_str(handle, "devices", NULL, &required_size);
 
     if (err == ESP_OK && required_size > 0) {
         char *json_str = malloc(required_size);
-        if (!json_str) { nvs_close(handle); return; }
+        if (!json_str) { nvs_close(handle); return false; }
 
         nvs_get_str(handle, "devices", json_str, &required_size);
         cJSON *root = cJSON_Parse(json_str);
 
         if (root) {
             cJSON *array = cJSON_GetObjectItem(root, "devices");
-            num_dispositivos = 0;
 
             cJSON *item = NULL;
             cJSON_ArrayForEach(item, array) {
-                if (num_dispositivos >= MAX_DEVICES) break;
                 cJSON *rom_item    = cJSON_GetObjectItem(item, "rom");
                 cJSON *unidad_item = cJSON_GetObjectItem(item, "unidad");
                 cJSON *asig_item   = cJSON_GetObjectItem(item, "asignado");
                 if (!rom_item || !unidad_item || !asig_item) continue;
 
-                size_t idx = num_dispositivos;
+                // Registros sin "canal" (un solo segmento) van al canal 0
+                cJSON *canal_item = cJSON_GetObjectItem(item, "canal");
+                size_t canal = canal_item ? (size_t)canal_item->valueint : 0;
+                if (canal >= NUM_SEGMENTOS) continue;
+
+                // Una ROM repetida en el JSON se queda con el primer registro
                 uint64_t rom = string_to_rom(rom_item->valuestring);
-                dispositivos[idx].rom = rom;
-                rom_to_string(rom, dispositivos[idx].rom_str);
-                strncpy(dispositivos[idx].unidad, unidad_item->valuestring, 11);
-                dispositivos[idx].unidad[11] = '\0';
-                dispositivos[idx].asignado   = (bool)asig_item->valueint;
-                dispositivos[idx].presente   = false;
-                dispositivos[idx].ausencias  = 0;
+                if (buscar_jaula(rom) >= 0) continue;
+                int slot = jaula_alta(&segmentos[canal], rom);
+                if (slot < 0) {
+                    ESP_LOGW(TAG, "Pool de jaulas lleno: se descartan registros de NVS");
+                    break;
+                }
+
+                dispositivo_t *d = &pool[slot].d;
+                strncpy(d->unidad, unidad_item->valuestring, 11);
+                d->unidad[11] = '\0';
+                d->asignado   = (bool)asig_item->valueint;
+
+                cJSON *ts_item  = cJSON_GetObjectItem(item, "ts");
+                cJSON *crc_item = cJSON_GetObjectItem(item, "crc");
+                d->huella_valida = ts_item && crc_item;
+                if (d->huella_valida) {
+                    d->huella.timestamp = (uint32_t)ts_item->valuedouble;
+                    d->huella.crc       = (uint16_t)crc_item->valueint;
+                    // Las huellas guardadas antes de v3 son todas de registros v2
+                    cJSON *hv_item = cJSON_GetObjectItem(item, "hv");
+                    d->huella.version = hv_item ? (uint8_t)hv_item->valueint
+                                                : DS2431_VERSION_V2;
+                }
 
                 cJSON *dolly_item       = cJSON_GetObjectItem(item, "unidad_dolly");
                 cJSON *tiene_dolly_item = cJSON_GetObjectItem(item, "tiene_dolly");
                 if (dolly_item && tiene_dolly_item) {
-                    dispositivos[idx].tiene_dolly = (bool)tiene_dolly_item->valueint;
-                    if (dispositivos[idx].tiene_dolly) {
-                        strncpy(dispositivos[idx].unidad_dolly, dolly_item->valuestring, 11);
-                        dispositivos[idx].unidad_dolly[11] = '\0';
-                    } else {
-                        memset(dispositivos[idx].unidad_dolly, 0, 12);
+                    d->tiene_dolly = (bool)tiene_dolly_item->valueint;
+                    if (d->tiene_dolly) {
+                        strncpy(d->unidad_dolly, dolly_item->valuestring, 11);
+                        d->unidad_dolly[11] = '\0';
                     }
-                } else {
-                    dispositivos[idx].tiene_dolly = false;
-                    memset(dispositivos[idx].unidad_dolly, 0, 12);
                 }
-                num_dispositivos++;
             }
             cJSON_Delete(root);
         } else {
@@ -159,147 +547,548 @@ void cargar_desde_nvs() {
         }
         free(json_str);
     } else {
-        ESP_LOGI(TAG, "NVS vacío, iniciando sin dispositivos previos");
+        nvs_close(handle);
+        return false;
+    }
+
+    size_t n = 0;
+    if (grabar_todos_nvs(&n) == ESP_OK) {
+        nvs_erase_key(handle, "devices");
+        nvs_commit(handle);
+        ESP_LOGI(TAG, "NVS migrado de JSON a registros: %u jaulas", (unsigned)n);
     }
     nvs_close(handle);
+    return true;
 }
 
-// ── Registro de dispositivos ──────────────────────────────────────────────────
-bool existe_dispositivo_str(const char *rom_str) {
-    for (size_t i = 0; i < num_dispositivos; i++)
-        if (strcmp(dispositivos[i].rom_str, rom_str) == 0) return true;
-    return false;
+
+// Un registro por clave; los de otra versión o con la clave que no
+// corresponde a su ROM se ignoran. Si cambió la cantidad de segmentos, la
+// jaula entra al canal 0 y el censo la mueve al suyo cuando la vea.
+static size_t cargar_registros_nvs(void) {
+    nvs_handle_t handle;
+    if (nvs_open(NVS_NS_JAULAS, NVS_READONLY, &handle) != ESP_OK) return 0;
+
+    size_t n = 0;
+    char   clave[16];
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_NS_JAULAS, NVS_TYPE_BLOB, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        err = nvs_entry_next(&it);
+
+        registro_nvs_t r;
+        size_t len = sizeof(r);
+        if (nvs_get_blob(handle, info.key, &r, &len) != ESP_OK || len != sizeof(r)) continue;
+        if (r.version != REGISTRO_VERSION) continue;
+        clave_registro(r.rom, clave);
+        if (strcmp(clave, info.key) != 0 || buscar_jaula(r.rom) >= 0) continue;
+
+        size_t canal = r.canal < NUM_SEGMENTOS ? r.canal : 0;
+        int slot = jaula_alta(&segmentos[canal], r.rom);
+        if (slot < 0) {
+            ESP_LOGW(TAG, "Pool de jaulas lleno: se descartan registros de NVS");
+            break;
+        }
+        dispositivo_t *d = &pool[slot].d;
+        d->asignado      = r.flags & REGISTRO_ASIGNADO;
+        d->tiene_dolly   = r.flags & REGISTRO_DOLLY;
+        d->huella_valida = r.flags & REGISTRO_HUELLA;
+        if (d->huella_valida) {
+            d->huella.version   = r.huella_version;
+            d->huella.timestamp = r.huella_ts;
+            d->huella.crc       = r.huella_crc;
+        }
+        memcpy(d->unidad,       r.unidad,       sizeof(d->unidad));
+        memcpy(d->unidad_dolly, r.unidad_dolly, sizeof(d->unidad_dolly));
+        d->unidad[11]       = '\0';
+        d->unidad_dolly[11] = '\0';
+        n++;
+    }
+    nvs_release_iterator(it);
+    nvs_close(handle);
+    return n;
 }
 
-void agregar_dispositivo(uint64_t rom) {
-    if (num_dispositivos >= MAX_DEVICES) {
-        ESP_LOGW(TAG, "Lista llena"); return;
+// Devuelve cuántas jaulas quedaron registradas (sin verificar hasta el
+// primer censo)
+size_t cargar_desde_nvs() {
+    size_t n = 0;
+    if (migrar_json_nvs()) {
+        for (size_t s = 0; s < NUM_SEGMENTOS; s++) n += segmentos[s].num_miembros;
+        return n;
     }
-    size_t idx = num_dispositivos;
-    dispositivos[idx].rom       = rom;
-    dispositivos[idx].ausencias = 0;
-    dispositivos[idx].presente  = true;
-    dispositivos[idx].asignado  = false;
-    dispositivos[idx].tiene_dolly = false;
-    memset(dispositivos[idx].unidad,       0, 12);
-    memset(dispositivos[idx].unidad_dolly, 0, 12);
-    rom_to_string(rom, dispositivos[idx].rom_str);
-    ESP_LOGI(TAG, "Nuevo dispositivo: %s", dispositivos[idx].rom_str);
-    num_dispositivos++;
+
+    n = cargar_registros_nvs();
+    if (n == 0) ESP_LOGI(TAG, "NVS vacío, iniciando sin dispositivos previos");
+    else        ESP_LOGI(TAG, "NVS: %u jaulas cargadas", (unsigned)n);
+    return n;
 }
 
-// ── Leer EEPROM de un dispositivo y asignar sus datos ────────────────────────
+// ── Perfil de tiempos del cable ───────────────────────────────────────────────
+// Un byte por segmento con el nivel de ds2482_tiempos_aplicar(). Si cambió la
+// cantidad de segmentos el blob no sirve y se recalibra todo.
+esp_err_t guardar_tiempos_nvs(const uint8_t *niveles) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open("storage", NVS_READWRITE, &handle);
+    if (err != ESP_OK) { ESP_LOGE(TAG, "Error NVS: %s", esp_err_to_name(err)); return err; }
+    err = nvs_set_blob(handle, "ow_tiempos", niveles, NUM_SEGMENTOS);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Error guardando tiempos: %s", esp_err_to_name(err));
+    nvs_commit(handle);
+    nvs_close(handle);
+    return err;
+}
+
+void cargar_tiempos_nvs() {
+    nvs_handle_t handle;
+    if (nvs_open("storage", NVS_READONLY, &handle) != ESP_OK) return;
+
+    uint8_t niveles[NUM_SEGMENTOS];
+    size_t  len = sizeof(niveles);
+    esp_err_t err = nvs_get_blob(handle, "ow_tiempos", niveles, &len);
+    nvs_close(handle);
+    if (err != ESP_OK || len != sizeof(niveles)) {
+        ESP_LOGI(TAG, "Sin perfil de tiempos guardado — se calibra al encontrar jaulas");
+        return;
+    }
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        ds2482_tiempos_aplicar(&segmentos[s].bus, niveles[s]);
+        segmentos[s].bus_copia = segmentos[s].bus;
+        segmentos[s].calibrado = true;
+        ESP_LOGI(TAG, "Segmento %d: tiempos nivel %d (NVS)", (int)s, niveles[s]);
+    }
+}
+
+// ── Registro de dispositivos ──────────────────────────────────────────────────
+// Devuelve el slot del nuevo dispositivo, -1 si el pool está lleno
+int agregar_dispositivo(segmento_t *seg, uint64_t rom) {
+    int slot = jaula_alta(seg, rom);
+    if (slot < 0) {
+        ESP_LOGW(TAG, "Pool de jaulas lleno (%d) — segmento %d", MAX_JAULAS, seg->id);
+        return -1;
+    }
+    pool[slot].d.presente = true;
+    char rom_str[17];
+    ESP_LOGI(TAG, "Nuevo dispositivo: %s (segmento %d)", rom_to_string(rom, rom_str), seg->id);
+    return slot;
+}
+
+// ── Asignar los datos leídos de la EEPROM de un dispositivo ─────────────────
 // Devuelve true si la lectura fue exitosa.
-bool leer_eeprom_dispositivo(ds2482_t *ds2482, size_t idx) {
-    ds2431_t esclavo = { .rom_code = dispositivos[idx].rom };
-    ds2431_data_t datos;
-    esp_err_t err = ds2431_leer_datos(ds2482, &esclavo, &datos);
-
-    if (err == ESP_OK && datos.valido) {
-        strncpy(dispositivos[idx].unidad, datos.unidad_jaula, 11);
-        dispositivos[idx].unidad[11] = '\0';
-        dispositivos[idx].tiene_dolly = datos.tiene_dolly;
-        if (datos.tiene_dolly) {
-            strncpy(dispositivos[idx].unidad_dolly, datos.unidad_dolly, 11);
-            dispositivos[idx].unidad_dolly[11] = '\0';
+bool aplicar_eeprom_dispositivo(dispositivo_t *d, const ds2431_lectura_t *lectura) {
+    const ds2431_data_t *datos = &lectura->datos;
+    esp_err_t err = lectura->err;
+    char rom_str[17];
+    rom_to_string(d->rom, rom_str);
+
+    if (err == ESP_OK && lectura->sin_cambios) {
+        // La EEPROM no cambió desde la última lectura: los datos siguen válidos
+        ESP_LOGD(TAG, "EEPROM sin cambios: %s (%lu ms)", rom_str,
+                 (unsigned long)(lectura->latencia_us / 1000));
+        return true;
+    }
+
+    if (err == ESP_OK && datos->valido) {
+        bool nueva = !d->asignado || strcmp(d->unidad, datos->unidad_jaula) != 0
+                  || d->tiene_dolly != datos->tiene_dolly
+                  || (datos->tiene_dolly && strcmp(d->unidad_dolly, datos->unidad_dolly) != 0);
+        d->huella_valida = true;
+        d->huella        = lectura->huella;
+        strncpy(d->unidad, datos->unidad_jaula, 11);
+        d->unidad[11] = '\0';
+        d->tiene_dolly = datos->tiene_dolly;
+        if (datos->tiene_dolly) {
+            strncpy(d->unidad_dolly, datos->unidad_dolly, 11);
+            d->unidad_dolly[11] = '\0';
         } else {
-            memset(dispositivos[idx].unidad_dolly, 0, 12);
+            memset(d->unidad_dolly, 0, 12);
         }
-        dispositivos[idx].asignado = true;
-        nvs_dirty = true;
-        ESP_LOGI(TAG, "EEPROM leída: %s → Jaula %s | Dolly %s",
-                 dispositivos[idx].rom_str,
-                 dispositivos[idx].unidad,
-                 dispositivos[idx].tiene_dolly ? dispositivos[idx].unidad_dolly : "N/A");
+        d->asignado = true;
+        if (nueva) persistir_urgente(d);
+        else       persistir(d);
+        ESP_LOGI(TAG, "EEPROM leída: %s → Jaula %s | Dolly %s (%lu ms, %d intento/s)",
+                 rom_str,
+                 d->unidad,
+                 d->tiene_dolly ? d->unidad_dolly : "N/A",
+                 (unsigned long)(lectura->latencia_us / 1000), lectura->intentos);
         return true;
 
     } else if (err == ESP_ERR_INVALID_CRC) {
-        ESP_LOGW(TAG, "Esclavo %s con formato antiguo — reprogramar",
-                 dispositivos[idx].rom_str);
+        ESP_LOGW(TAG, "Esclavo %s con EEPROM corrupta (CRC) — reprogramar",
+                 rom_str);
+        d->huella_valida = false;
     } else {
-        ESP_LOGW(TAG, "Esclavo %s sin datos aún", dispositivos[idx].rom_str);
+        ESP_LOGW(TAG, "Esclavo %s sin datos aún", rom_str);
     }
     return false;
 }
 
-// ── Escaneo del bus 1-Wire ────────────────────────────────────────────────────
+// ── Resultado del censo (tarea del bus) ──────────────────────────────────────
 //
 // leer_eeprom = false → solo descubre ROMs y actualiza presencia (rápido, 3s)
 // leer_eeprom = true  → además lee la EEPROM de todos los presentes (30s)
 //
-void escanear_dispositivos(ds2482_t *ds2482, bool leer_eeprom) {
-    uint64_t roms[MAX_DEVICES];
-    size_t found = 0;
-
-    esp_err_t err = ds2482_search_rom_all(roms, MAX_DEVICES, &found);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error search_rom_all: %s", esp_err_to_name(err));
-        return;
+// Las tablas se actualizan con el mutex tomado y las EEPROM pendientes se
+// encolan como un pedido de lectura por segmento; cuando termina el último
+// lote (o si no hubo ninguno) se despierta a la tarea principal. En el ciclo
+// 0 se la despierta además apenas termina el censo.
+//
+static void contar_ausencia(dispositivo_t *d) {
+    d->verificado = true;   // el censo ya la buscó
+    if (d->ausencias < 250) d->ausencias++;
+    if (d->ausencias >= 3) {
+        if (d->presente) d->salud.desconexiones++;
+        d->presente = false;
     }
-    ESP_LOGI(TAG, "ROMs en bus: %d | Lectura EEPROM: %s",
-             found, leer_eeprom ? "SI" : "no");
+}
+
+static void marcar_ausentes(segmento_t *seg) {
+    for (size_t i = 0; i < seg->num_miembros; i++) contar_ausencia(&pool[seg->miembros[i]].d);
+}
 
-    // ── Fase 1: Agregar ROMs nuevos ───────────────────────────────────────────
+static void actualizar_segmento(segmento_t *seg, const uint64_t *roms, size_t found,
+                                bool leer_eeprom) {
+    // ── Fase 1: Marcar presentes y agregar ROMs nuevos ───────────────────────
+    // Una búsqueda en el índice por ROM encontrada: lineal en found
     for (size_t i = 0; i < found; i++) {
         if (!rom_es_ds2431(roms[i])) continue;
-        char rom_str[17];
-        rom_to_string(roms[i], rom_str);
-        if (!existe_dispositivo_str(rom_str)) {
-            agregar_dispositivo(roms[i]);
-            nvs_dirty = true;
+        int slot = buscar_jaula(roms[i]);
+        if (slot < 0) {
+            slot = agregar_dispositivo(seg, roms[i]);
+            if (slot < 0) continue;
+            persistir(&pool[slot].d);
+        } else if (pool[slot].d.segmento != seg->id) {
+            jaula_mover(slot, seg);
+            persistir(&pool[slot].d);
         }
+        visto[slot] = true;
     }
 
-    // ── Fase 2: Actualizar presencia y (si aplica) leer EEPROM ───────────────
-    for (size_t j = 0; j < num_dispositivos; j++) {
-        bool encontrado = false;
-        for (size_t i = 0; i < found; i++) {
-            char rom_str[17];
-            rom_to_string(roms[i], rom_str);
-            if (strcmp(dispositivos[j].rom_str, rom_str) == 0) {
-                encontrado = true;
-                break;
-            }
-        }
+    // ── Fase 2: Actualizar presencia y elegir las EEPROM a leer ─────────────
+    // Con un lote todavía en la cola sus lecturas no se tocan: lo pendiente
+    // se elige en el próximo censo
+    bool elegir = !seg->lote_en_curso;
+    if (elegir) seg->n_lecturas = 0;
 
-        if (encontrado) {
-            if (dispositivos[j].ausencias > 0)
-                ESP_LOGI(TAG, "Jaula reconectada: %s", dispositivos[j].unidad[0]
-                         ? dispositivos[j].unidad : dispositivos[j].rom_str);
-            dispositivos[j].presente  = true;
-            dispositivos[j].ausencias = 0;
+    for (size_t j = 0; j < seg->num_miembros; j++) {
+        uint16_t       slot = seg->miembros[j];
+        dispositivo_t *d    = &pool[slot].d;
+        if (visto[slot]) {
+            visto[slot] = false;
+            char rom_str[17];
+            if (d->ausencias > 0)
+                ESP_LOGI(TAG, "Jaula reconectada: %s", d->unidad[0]
+                         ? d->unidad : rom_to_string(d->rom, rom_str));
+            d->presente   = true;
+            d->verificado = true;
+            d->ausencias  = 0;
 
             // Leer EEPROM si:
             //   - Es un ciclo de lectura completa (cada 30s), O
             //   - El dispositivo no tiene datos todavía
-            if (leer_eeprom || !dispositivos[j].asignado) {
-                leer_eeprom_dispositivo(ds2482, j);
-                // Pausa entre lecturas — el bus largo necesita recuperarse
-                vTaskDelay(pdMS_TO_TICKS(300));
+            if (elegir && (leer_eeprom || !d->asignado) && seg->n_lecturas < ROMS_SEGMENTO) {
+                seg->lecturas_h[seg->n_lecturas] = jaula_handle(slot);
+                ds2431_lectura_t *l = &seg->lecturas[seg->n_lecturas++];
+                l->rom          = d->rom;
+                // Solo vale la huella si los datos cacheados vienen de esa lectura
+                l->tiene_huella = d->asignado && d->huella_valida;
+                l->huella       = d->huella;
             }
         } else {
-            if (dispositivos[j].ausencias < 250) dispositivos[j].ausencias++;
-            if (dispositivos[j].ausencias >= 3)  dispositivos[j].presente = false;
+            contar_ausencia(d);
         }
     }
 
     // ── Fase 3: Evictar ausentes prolongados ─────────────────────────────────
+    // El slot vuelve al pool con otra generación: si la jaula estaba en un
+    // lote en curso su handle ya no resuelve y el resultado se descarta.
     size_t j = 0;
-    while (j < num_dispositivos) {
-        if (dispositivos[j].ausencias >= AUSENCIAS_EVICTAR) {
+    while (j < seg->num_miembros) {
+        uint16_t             slot = seg->miembros[j];
+        const dispositivo_t *d    = &pool[slot].d;
+        if (d->ausencias >= AUSENCIAS_EVICTAR) {
+            char rom_str[17];
             ESP_LOGW(TAG, "Evictando: %s (%s)",
-                     dispositivos[j].unidad[0] ? dispositivos[j].unidad : "SIN_ASIGNAR",
-                     dispositivos[j].rom_str);
-            memmove(&dispositivos[j], &dispositivos[j + 1],
-                    (num_dispositivos - j - 1) * sizeof(dispositivo_t));
-            num_dispositivos--;
-            nvs_dirty = true;
+                     d->unidad[0] ? d->unidad : "SIN_ASIGNAR",
+                     rom_to_string(d->rom, rom_str));
+            persistir_baja(d->rom);
+            jaula_baja(seg, slot);
         } else {
             j++;
         }
     }
 }
 
+static void ciclo_terminado(void) {
+    xTaskNotifyGive(tarea_principal);
+}
+
+// Lote de EEPROM de un segmento terminado: se aplica por handle
+static void lectura_hecha(onewire_pedido_t *pedido) {
+    segmento_t *seg = pedido->ctx;
+
+    xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+    for (size_t k = 0; k < seg->n_lecturas; k++) {
+        const ds2431_lectura_t *l = &seg->lecturas[k];
+        dispositivo_t *d = jaula_resolver(seg->lecturas_h[k]);
+        if (!d) continue;
+        salud_t *salud = &d->salud;
+        salud->lecturas++;
+        if (l->err != ESP_OK) salud->fallos++;
+        salud->reintentos += l->reintentos;
+        salud->crc_fallos += l->crc_fallos;
+        salud->bus_ms     += l->bus_us / 1000;
+        aplicar_eeprom_dispositivo(d, l);
+    }
+    seg->bus_copia     = seg->bus;
+    seg->lote_en_curso = false;
+    xSemaphoreGive(tabla_mutex);
+
+    if (--lotes_pendientes == 0) ciclo_terminado();
+}
+
+// Calibración terminada: el nivel nuevo lo graba la tarea de persistencia
+static void calibracion_hecha(onewire_pedido_t *pedido) {
+    segmento_t *seg = pedido->ctx;
+    seg->calibrando = false;
+    if (pedido->err != ESP_OK) return;   // sin esclavos: se reintenta en el próximo censo
+
+    xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+    seg->calibrado = true;
+    seg->bus_copia = seg->bus;
+    persistir_tiempos();
+    xSemaphoreGive(tabla_mutex);
+}
+
+static void censo_hecho(const onewire_censo_t *censo, void *ctx) {
+    if (censo->error_bus) {
+        errores_bus++;
+        ESP_LOGE(TAG, "Error reset 1-Wire [%d/%d]", errores_bus, BUS_ERRORES_MAX);
+        if (errores_bus >= BUS_ERRORES_MAX) {
+            ESP_LOGE(TAG, "Bus irrecuperable — reiniciando");
+            esp_restart();
+        }
+        return;
+    }
+    errores_bus = 0;
+
+    // Ciclo 0 = descubrimiento al arranque: lee todas las EEPROM
+    // Cada 30s → escaneo completo con lectura de EEPROM
+    // Cada 3s  → solo presencia y ROMs nuevos
+    bool leer_eeprom = (censo->ciclo % CICLOS_EEPROM == 0);
+    if (censo->ciclo == 0)
+        ESP_LOGI(TAG, "=== DESCUBRIMIENTO INICIAL ===");
+    else if (leer_eeprom)
+        ESP_LOGI(TAG, "=== ESCANEO COMPLETO (ciclo %lu) ===", censo->ciclo);
+
+    xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+    ultimo_ciclo = censo->ciclo;
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        segmento_t *seg = &segmentos[s];
+        const onewire_censo_seg_t *r = &censo->seg[s];
+        if (!seg->lote_en_curso) seg->n_lecturas = 0;
+        if (!r->presencia) {
+            if (censo->ciclo == 0)
+                ESP_LOGW(TAG, "Segmento %d vacío al arranque — esperando jaulas", (int)s);
+            marcar_ausentes(seg);
+        } else if (r->err == ESP_OK) {
+            actualizar_segmento(seg, seg->roms, r->found, leer_eeprom);
+        }
+        // Si los reintentos suben, el segmento vuelve a pausas más largas
+        if (ds2482_tiempos_vigilar(&seg->bus)) persistir_tiempos();
+        seg->bus_copia = seg->bus;
+    }
+    xSemaphoreGive(tabla_mutex);
+
+    // Todas las EEPROM pendientes de un segmento en un lote: la pausa entre
+    // esclavos se adapta al bus y solo se reintentan los fallidos
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        segmento_t *seg = &segmentos[s];
+        if (seg->lote_en_curso || seg->n_lecturas == 0) continue;
+        seg->pedido = (onewire_pedido_t){
+            .op       = ONEWIRE_LEER,
+            .segmento = s,
+            .lecturas = seg->lecturas,
+            .n        = seg->n_lecturas,
+            .hecho    = lectura_hecha,
+            .ctx      = seg,
+        };
+        if (onewire_pedir(&seg->pedido) == ESP_OK) {
+            seg->lote_en_curso = true;
+            lotes_pendientes++;
+        }
+    }
+    // En el descubrimiento inicial la presencia se publica ya, con las
+    // unidades guardadas, sin esperar a que terminen las EEPROM
+    if (lotes_pendientes == 0 || censo->ciclo == 0) ciclo_terminado();
+
+    // Calibración del cable: apenas haya esclavos si no hay perfil guardado y
+    // después cada hora, para volver a acortar las pausas si el bus mejoró
+    bool toca = censo->ciclo > 0 && censo->ciclo % CICLOS_CALIBRACION == 0;
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        segmento_t *seg = &segmentos[s];
+        const onewire_censo_seg_t *r = &censo->seg[s];
+        if (seg->calibrando || !r->presencia || r->err != ESP_OK || r->found == 0) continue;
+        if (seg->calibrado && !toca) continue;
+        seg->calib_pedido = (onewire_pedido_t){
+            .op       = ONEWIRE_CALIBRAR,
+            .segmento = s,
+            .calib    = &seg->calib,
+            .hecho    = calibracion_hecha,
+            .ctx      = seg,
+        };
+        if (onewire_pedir(&seg->calib_pedido) == ESP_OK) seg->calibrando = true;
+    }
+}
+
+// ── Tarea de persistencia ────────────────────────────────────────────────────
+// Junta los cambios durante NVS_VENTANA_MS desde el primero y los graba con
+// un solo commit; una asignación nueva adelanta el commit. Si en la hora ya
+// se escribieron NVS_PRESUPUESTO_HORA entradas, lo que no es urgente espera
+// a la hora siguiente. La tarea del bus y la principal nunca esperan a la
+// flash: solo toman el mutex para marcar o para que esta copie lo pendiente.
+static registro_nvs_t nvs_lote[MAX_JAULAS];
+static jaula_h        nvs_lote_h[MAX_JAULAS];
+static uint64_t       nvs_lote_bajas[MAX_JAULAS];
+
+static void guardar_desgaste_nvs(void) {
+    nvs_handle_t handle;
+    if (nvs_open("storage", NVS_READWRITE, &handle) != ESP_OK) return;
+    if (nvs_set_blob(handle, "nvs_desgaste", &desgaste, sizeof(desgaste)) == ESP_OK)
+        desgaste.entradas += NVS_ENTRADAS_BLOB(sizeof(desgaste));
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static void cargar_desgaste_nvs(void) {
+    nvs_handle_t handle;
+    if (nvs_open("storage", NVS_READONLY, &handle) != ESP_OK) return;
+    size_t len = sizeof(desgaste);
+    if (nvs_get_blob(handle, "nvs_desgaste", &desgaste, &len) != ESP_OK || len != sizeof(desgaste))
+        memset(&desgaste, 0, sizeof(desgaste));
+    nvs_close(handle);
+}
+
+// Graba lo copiado por tarea_persistencia() con un solo commit. Un registro
+// que no se pudo grabar vuelve a quedar pendiente si la jaula sigue.
+static void grabar_lote_nvs(size_t n, size_t bajas, bool reescribir) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NVS_NS_JAULAS, NVS_READWRITE, &handle);
+    if (err != ESP_OK) { ESP_LOGE(TAG, "Error NVS: %s", esp_err_to_name(err)); return; }
+
+    char clave[16];
+    if (reescribir) nvs_erase_all(handle);
+    for (size_t i = 0; i < bajas && !reescribir; i++) {
+        clave_registro(nvs_lote_bajas[i], clave);
+        err = nvs_erase_key(handle, clave);
+        if (err == ESP_OK) desgaste.bajas++;
+        else if (err != ESP_ERR_NVS_NOT_FOUND)
+            ESP_LOGE(TAG, "Error borrando %s: %s", clave, esp_err_to_name(err));
+    }
+    for (size_t i = 0; i < n; i++) {
+        clave_registro(nvs_lote[i].rom, clave);
+        err = nvs_set_blob(handle, clave, &nvs_lote[i], sizeof(nvs_lote[i]));
+        if (err == ESP_OK) {
+            desgaste.registros++;
+            desgaste.entradas += NVS_ENTRADAS_BLOB(sizeof(registro_nvs_t));
+            continue;
+        }
+        ESP_LOGE(TAG, "Error guardando %s: %s", clave, esp_err_to_name(err));
+        xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+        dispositivo_t *d = jaula_resolver(nvs_lote_h[i]);
+        if (d) persistir(d);
+        xSemaphoreGive(tabla_mutex);
+    }
+    err = nvs_commit(handle);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Error en commit NVS: %s", esp_err_to_name(err));
+    desgaste.commits++;
+    nvs_close(handle);
+    ESP_LOGD(TAG, "NVS: %u registros grabados, %u borrados", (unsigned)n,
+             (unsigned)(reescribir ? 0 : bajas));
+}
+
+static void tarea_persistencia(void *arg) {
+    TickType_t hora_desde   = xTaskGetTickCount();
+    uint32_t   entradas_ini = desgaste.entradas;   // al empezar la hora
+    bool       avisado      = false;
+
+    while (1) {
+        TickType_t ahora = xTaskGetTickCount();
+        if (ahora - hora_desde >= pdMS_TO_TICKS(NVS_HORA_MS)) {
+            ESP_LOGI(TAG, "NVS: %lu entradas en la última hora (presupuesto %d)",
+                     (unsigned long)(desgaste.entradas - entradas_ini), NVS_PRESUPUESTO_HORA);
+            guardar_desgaste_nvs();
+            hora_desde   = ahora;
+            entradas_ini = desgaste.entradas;
+            avisado      = false;
+        }
+        bool sin_presupuesto = desgaste.entradas - entradas_ini >= NVS_PRESUPUESTO_HORA;
+        TickType_t fin_hora  = hora_desde + pdMS_TO_TICKS(NVS_HORA_MS) - ahora;
+
+        // ── Decidir y copiar lo pendiente bajo el mutex ─────────────────────
+        xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+        TickType_t espera = portMAX_DELAY;
+        bool grabar = false;
+        if (nvs_dirty) {
+            TickType_t pasado = ahora - nvs_desde;
+            bool vencida = pasado >= pdMS_TO_TICKS(NVS_VENTANA_MS);
+            if (nvs_urgente) {
+                grabar = true;
+                desgaste.urgentes++;
+            } else if (vencida && !sin_presupuesto) {
+                grabar = true;
+            } else if (vencida) {
+                if (!avisado) desgaste.postergados++;
+                avisado = true;
+                espera  = fin_hora;
+            } else {
+                espera = pdMS_TO_TICKS(NVS_VENTANA_MS) - pasado;
+            }
+        }
+
+        size_t  n = 0, bajas = 0;
+        bool    reescribir = false, tiempos = false;
+        uint8_t niveles[NUM_SEGMENTOS];
+        if (grabar) {
+            reescribir = nvs_reescribir;
+            for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+                const segmento_t *seg = &segmentos[s];
+                for (size_t i = 0; i < seg->num_miembros; i++) {
+                    uint16_t slot = seg->miembros[i];
+                    if (!reescribir && !pool[slot].d.nvs_pendiente) continue;
+                    registro_armar(&pool[slot].d, &nvs_lote[n]);
+                    nvs_lote_h[n++] = jaula_handle(slot);
+                    pool[slot].d.nvs_pendiente = false;
+                }
+                niveles[s] = seg->bus_copia.nivel;
+            }
+            bajas = nvs_num_bajas;
+            memcpy(nvs_lote_bajas, nvs_bajas, bajas * sizeof(nvs_bajas[0]));
+            tiempos        = tiempos_dirty;
+            nvs_num_bajas  = 0;
+            nvs_reescribir = false;
+            nvs_dirty      = false;
+            nvs_urgente    = false;
+            tiempos_dirty  = false;
+        }
+        xSemaphoreGive(tabla_mutex);
+
+        if (grabar) {
+            if (n > 0 || bajas > 0 || reescribir) grabar_lote_nvs(n, bajas, reescribir);
+            if (tiempos && guardar_tiempos_nvs(niveles) == ESP_OK)
+                desgaste.entradas += NVS_ENTRADAS_BLOB(NUM_SEGMENTOS);
+            avisado = false;
+            xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+            vista_desgaste = desgaste;
+            xSemaphoreGive(tabla_mutex);
+            continue;   // puede haber llegado algo mientras se grababa
+        }
+        if (espera == portMAX_DELAY || espera > fin_hora) espera = fin_hora;
+        ulTaskNotifyTake(pdTRUE, espera);
+    }
+}
+
 // ── Publicar estado por MQTT ──────────────────────────────────────────────────
 void publicar_mqtt() {
     cJSON *json = cJSON_CreateObject();
@@ -307,20 +1096,24 @@ void publicar_mqtt() {
 
     cJSON *jaulas_array = cJSON_AddArrayToObject(json, "jaulas");
 
-    for (size_t i = 0; i < num_dispositivos; i++) {
-        if (!dispositivos[i].presente) continue;
+    for (size_t i = 0; i < vista_num; i++) {
+        const dispositivo_t *d = &vista_jaulas[i].d;
+        // Las que ningún censo buscó todavía salen de la tabla guardada
+        if (!d->presente && d->verificado) continue;
+        char rom_str[17];
         cJSON *obj = cJSON_CreateObject();
-        cJSON_AddStringToObject(obj, "rom", dispositivos[i].rom_str);
-        if (dispositivos[i].asignado) {
-            cJSON_AddStringToObject(obj, "unidad", dispositivos[i].unidad);
+        cJSON_AddStringToObject(obj, "rom", rom_to_string(d->rom, rom_str));
+        if (d->asignado) {
+            cJSON_AddStringToObject(obj, "unidad", d->unidad);
             cJSON_AddStringToObject(obj, "dolly",
-                                    dispositivos[i].tiene_dolly
-                                        ? dispositivos[i].unidad_dolly
-                                        : "SIN_DOLLY");
+                                    d->tiene_dolly ? d->unidad_dolly : "SIN_DOLLY");
         } else {
             cJSON_AddStringToObject(obj, "unidad", "SIN_ASIGNAR");
             cJSON_AddStringToObject(obj, "dolly",  "SIN_DOLLY");
         }
+        // Con un solo segmento el mensaje queda igual que antes
+        if (NUM_SEGMENTOS > 1) cJSON_AddNumberToObject(obj, "canal", d->segmento);
+        if (!d->verificado)    cJSON_AddBoolToObject(obj, "verificado", false);
         cJSON_AddItemToArray(jaulas_array, obj);
     }
 
@@ -333,10 +1126,117 @@ void publicar_mqtt() {
     cJSON_Delete(json);
 }
 
+// ── Publicar histograma de tiempos del DS2482 ────────────────────────────────
+// Sirve para afinar instalaciones con cable largo: cuánto tarda realmente
+// cada tipo de comando 1-Wire en este camión.
+// Con varios segmentos cada canal publica en GIO/IDJ/ds2482/<canal>.
+void publicar_tiempos_bus(const vista_segmento_t *seg) {
+    ds2482_hist_dump(&seg->bus);
+
+    char json_str[768];
+    if (ds2482_hist_json(&seg->bus, json_str, sizeof(json_str)) < 0) {
+        ESP_LOGE(TAG, "Histograma DS2482 no cabe en el buffer");
+        return;
+    }
+    char topic[32] = "GIO/IDJ/ds2482";
+    if (NUM_SEGMENTOS > 1) snprintf(topic, sizeof(topic), "GIO/IDJ/ds2482/%d", seg->id);
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, json_str, 0, 0, 0);
+    if (msg_id == -1) ESP_LOGE(TAG, "Error publicando tiempos DS2482");
+}
+
+// ── Publicar salud del bus y de cada jaula ───────────────────────────────────
+// Bloque compacto en GIO/IDJ/salud, más espaciado que la lista de jaulas:
+// contadores acumulados desde el arranque, por segmento y por ROM, para ver
+// qué jaulas y qué tramos de cable se llevan el tiempo de reintentos.
+void publicar_salud() {
+    cJSON *json = cJSON_CreateObject();
+    if (!json) { ESP_LOGE(TAG, "Fallo al crear JSON"); return; }
+
+    // Desgaste de la flash: lo escrito por la persistencia y lo que queda
+    cJSON *flash = cJSON_AddObjectToObject(json, "nvs");
+    cJSON_AddNumberToObject(flash, "entradas", vista_desgaste.entradas);
+    cJSON_AddNumberToObject(flash, "bytes",    (double)vista_desgaste.entradas * NVS_ENTRADA_BYTES);
+    cJSON_AddNumberToObject(flash, "commits",  vista_desgaste.commits);
+    cJSON_AddNumberToObject(flash, "reg",      vista_desgaste.registros);
+    cJSON_AddNumberToObject(flash, "bajas",    vista_desgaste.bajas);
+    cJSON_AddNumberToObject(flash, "urg",      vista_desgaste.urgentes);
+    cJSON_AddNumberToObject(flash, "post",     vista_desgaste.postergados);
+    nvs_stats_t st_nvs;
+    if (nvs_get_stats(NVS_DEFAULT_PART_NAME, &st_nvs) == ESP_OK && st_nvs.total_entries > 0) {
+        cJSON_AddNumberToObject(flash, "libres", st_nvs.free_entries);
+        cJSON_AddNumberToObject(flash, "ciclos",
+                                (double)vista_desgaste.entradas / st_nvs.total_entries);
+    }
+
+    cJSON *buses = cJSON_AddArrayToObject(json, "buses");
+    cJSON *roms  = cJSON_AddArrayToObject(json, "roms");
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        const ds2482_stats_t *st = &vista[s].bus.stats;
+        cJSON *b = cJSON_CreateObject();
+        cJSON_AddNumberToObject(b, "canal",    vista[s].id);
+        cJSON_AddNumberToObject(b, "resets",   st->resets);
+        cJSON_AddNumberToObject(b, "triplets", st->triplets);
+        cJSON_AddNumberToObject(b, "confl",    st->conflictos);
+        cJSON_AddNumberToObject(b, "crc",      st->crc_fallos);
+        cJSON_AddNumberToObject(b, "reint",    st->reintentos);
+        cJSON_AddNumberToObject(b, "busy_ms",  (double)(st->busy_us / 1000));
+        cJSON_AddNumberToObject(b, "tmo",      st->busy_timeouts);
+        cJSON_AddNumberToObject(b, "nivel",    vista[s].bus.nivel);
+        cJSON_AddItemToArray(buses, b);
+    }
+    for (size_t i = 0; i < vista_num; i++) {
+        const dispositivo_t *d = &vista_jaulas[i].d;
+        char rom_str[17];
+        cJSON *r = cJSON_CreateObject();
+        cJSON_AddStringToObject(r, "rom",    rom_to_string(d->rom, rom_str));
+        if (NUM_SEGMENTOS > 1) cJSON_AddNumberToObject(r, "canal", d->segmento);
+        cJSON_AddNumberToObject(r, "lect",   d->salud.lecturas);
+        cJSON_AddNumberToObject(r, "fallos", d->salud.fallos);
+        cJSON_AddNumberToObject(r, "reint",  d->salud.reintentos);
+        cJSON_AddNumberToObject(r, "crc",    d->salud.crc_fallos);
+        cJSON_AddNumberToObject(r, "bus_ms", d->salud.bus_ms);
+        cJSON_AddNumberToObject(r, "desc",   d->salud.desconexiones);
+        cJSON_AddItemToArray(roms, r);
+    }
+
+    char *json_str = cJSON_PrintUnformatted(json);
+    if (json_str) {
+        int msg_id = esp_mqtt_client_publish(mqtt_client, "GIO/IDJ/salud", json_str, 0, 0, 0);
+        if (msg_id == -1) ESP_LOGE(TAG, "Error publicando salud");
+        free(json_str);
+    }
+    cJSON_Delete(json);
+}
+
+// ── Copia para publicar ──────────────────────────────────────────────────────
+// La copia recorre solo las jaulas en uso: no crece con MAX_JAULAS.
+// Devuelve el último ciclo de censo.
+static uint32_t copiar_vista(void) {
+    xSemaphoreTake(tabla_mutex, portMAX_DELAY);
+    vista_num = 0;
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        const segmento_t *seg = &segmentos[s];
+        vista[s].id  = seg->id;
+        vista[s].bus = seg->bus_copia;
+        for (size_t i = 0; i < seg->num_miembros; i++) {
+            uint16_t slot = seg->miembros[i];
+            vista_jaulas[vista_num].h = jaula_handle(slot);
+            vista_jaulas[vista_num].d = pool[slot].d;
+            vista_num++;
+        }
+    }
+    uint32_t ciclo = ultimo_ciclo;
+    xSemaphoreGive(tabla_mutex);
+    return ciclo;
+}
+
 // ── App main ──────────────────────────────────────────────────────────────────
 void app_main(void) {
     init_nvs_component();
-    cargar_desde_nvs();
+    registro_init();
+    cargar_desgaste_nvs();
+    size_t guardadas = cargar_desde_nvs();
+    vista_desgaste = desgaste;
 
     wifi_init_sta();
     mqtt_app_start();
@@ -352,14 +1252,44 @@ void app_main(void) {
     i2c_param_config(I2C_MASTER_NUM, &conf);
     i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
 
-    ds2482_t ds2482;
-    esp_err_t err = ds2482_init(&ds2482, I2C_MASTER_NUM, DS2482_I2C_ADDR);
+#if CONFIG_IDJ_DS2482_800
+    esp_err_t err = ds2482_800_init(&ds2482_800, I2C_MASTER_NUM, DS2482_800_I2C_ADDR);
+    if (err != ESP_OK) { ESP_LOGE(TAG, "DS2482-800 no detectado"); return; }
+    ESP_LOGI(TAG, "DS2482-800 OK (%d segmentos)", NUM_SEGMENTOS);
+#else
+    esp_err_t err = ds2482_init(&segmentos[0].bus, I2C_MASTER_NUM, DS2482_I2C_ADDR);
     if (err != ESP_OK) { ESP_LOGE(TAG, "DS2482 no detectado"); return; }
     ESP_LOGI(TAG, "DS2482 OK");
+#endif
 
-    ds2482_configure(&ds2482, DS2482_CFG_APU);
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        segmento_t *seg = &segmentos[s];
+        seg->id = (uint8_t)s;
+#if CONFIG_IDJ_DS2482_800
+        ds2482_800_canal(&seg->bus, &ds2482_800, seg->id);
+#endif
+        ds2482_configure(&seg->bus, DS2482_CFG_APU);
+        ds2482_censo_init(&seg->censo, CICLOS_BARRIDO, DS2431_FAMILY_CODE,
+                          ds2431_confirmar_presencia);
+        ds2431_lote_init(&seg->lote);
+    }
+
+#if CONFIG_IDJ_BENCHMARK
+    benchmark_bus(&segmentos[0].bus);
+#endif
+    cargar_tiempos_nvs();
+
+    // Arranque tibio: el primer censo confirma las jaulas guardadas con Match
+    // ROM en vez de barrer el bus, y el siguiente busca las nuevas
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        segmento_t *seg = &segmentos[s];
+        size_t n = 0;
+        for (size_t i = 0; i < seg->num_miembros && n < ROMS_SEGMENTO; i++)
+            seg->roms[n++] = pool[seg->miembros[i]].d.rom;
+        ds2482_censo_sembrar(&seg->censo, seg->roms, n);
+    }
 
-    // Watchdog 30s
+    // Watchdog 30s: la tarea del bus y la principal
     esp_task_wdt_config_t wdt_cfg = {
         .timeout_ms = 30000, .idle_core_mask = 0, .trigger_panic = true,
     };
@@ -367,87 +1297,100 @@ void app_main(void) {
         ESP_ERROR_CHECK(esp_task_wdt_init(&wdt_cfg));
     ESP_ERROR_CHECK(esp_task_wdt_add(NULL));
 
-    // ── Descubrimiento inicial al arranque ────────────────────────────────────
-    // Espera que el bus se estabilice antes del primer escaneo
-    ESP_LOGI(TAG, "Estabilizando bus 1-Wire...");
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    // ── Tarea del bus ─────────────────────────────────────────────────────────
+    // Desde acá solo ella toca los DS2482. El primer censo (ciclo 0) es el
+    // descubrimiento inicial, después de esperar que el bus se estabilice:
+    // confirma la tabla guardada y lee todas las EEPROM.
+    tabla_mutex     = xSemaphoreCreateMutex();
+    tarea_principal = xTaskGetCurrentTaskHandle();
 
-    ESP_LOGI(TAG, "=== DESCUBRIMIENTO INICIAL ===");
-    bool presence_boot = false;
-    ds2482_1wire_reset(&presence_boot);
-    if (presence_boot) {
-        escanear_dispositivos(&ds2482, true);  // Leer EEPROM completo al arranque
-    } else {
-        ESP_LOGW(TAG, "Bus vacío al arranque — esperando jaulas");
+    onewire_segmento_t bus_segs[NUM_SEGMENTOS];
+    for (size_t s = 0; s < NUM_SEGMENTOS; s++) {
+        bus_segs[s] = (onewire_segmento_t){
+            .bus      = &segmentos[s].bus,
+            .censo    = &segmentos[s].censo,
+            .lote     = &segmentos[s].lote,
+            .roms     = segmentos[s].roms,
+            .max_roms = ROMS_SEGMENTO,
+        };
     }
-    if (nvs_dirty) { guardar_en_nvs(); nvs_dirty = false; }
-    publicar_mqtt();
+    onewire_config_t bus_cfg = {
+        .segmentos       = bus_segs,
+        .n               = NUM_SEGMENTOS,
+        .periodo_ms      = SCAN_INTERVAL_MS,
+        .primer_censo_ms = 2000,
+        .censo_hecho     = censo_hecho,
+        .stack           = BUS_TAREA_STACK,
+        .prioridad       = BUS_TAREA_PRIORIDAD,
+        .watchdog        = true,
+    };
+    ESP_LOGI(TAG, "Estabilizando bus 1-Wire...");
+    ESP_ERROR_CHECK(onewire_iniciar(&bus_cfg));
 
-    // ── Ciclo principal ───────────────────────────────────────────────────────
-    uint32_t ciclo      = 0;
-    uint8_t errores_bus = 0;
+    // ── Tarea de persistencia ────────────────────────────────────────────────
+    // Más baja que la del bus y que la principal: graba cuando nadie más corre
+    xTaskCreate(tarea_persistencia, "persistencia", NVS_TAREA_STACK, NULL,
+                NVS_TAREA_PRIORIDAD, &tarea_nvs);
+
+    // ── Ciclo principal: mostrar y publicar ──────────────────────────────────
+    // Corre al ritmo de los censos pero sin retenerlos: si MQTT se demora,
+    // los avisos se juntan y se publica el último estado.
+    // Mientras no haya censo, la tabla guardada se publica una vez apenas
+    // conecte MQTT, cada jaula marcada "verificado": false.
+    uint32_t publicado_tiempos = 0;
+    uint32_t publicado_salud   = 0;
+    bool     tibio             = guardadas > 0;
 
     while (1) {
         esp_task_wdt_reset();
-        ciclo++;
-
-        bool presence = false;
-        err = ds2482_1wire_reset(&presence);
-
-        if (err != ESP_OK) {
-            errores_bus++;
-            ESP_LOGE(TAG, "Error reset 1-Wire [%d/%d]", errores_bus, BUS_ERRORES_MAX);
-            if (errores_bus >= BUS_ERRORES_MAX) {
-                ESP_LOGE(TAG, "Bus irrecuperable — reiniciando");
-                esp_restart();
+        uint32_t espera = tibio ? ESPERA_MQTT_MS : ESPERA_CICLO_MS;
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(espera)) == 0) {
+            if (tibio) {
+                if (mqtt_status) {
+                    copiar_vista();
+                    ESP_LOGI(TAG, "Arranque tibio: %u jaulas guardadas, sin verificar",
+                             (unsigned)vista_num);
+                    publicar_mqtt();
+                    tibio = false;
+                }
+                continue;
             }
-            vTaskDelay(pdMS_TO_TICKS(SCAN_INTERVAL_MS));
+            ESP_LOGW(TAG, "Sin ciclos del bus en %d ms", ESPERA_CICLO_MS);
             continue;
         }
+        tibio = false;   // ya hay censo: se publica lo confirmado
 
-        errores_bus = 0;
-
-        if (!presence) {
-            ESP_LOGW(TAG, "Bus vacío");
-            for (size_t i = 0; i < num_dispositivos; i++) {
-                if (dispositivos[i].ausencias < 250) dispositivos[i].ausencias++;
-                if (dispositivos[i].ausencias >= 3)  dispositivos[i].presente = false;
-            }
-        } else {
-            // Cada 30s → escaneo completo con lectura de EEPROM
-            // Cada 3s  → solo presencia y ROMs nuevos
-            bool es_ciclo_eeprom = (ciclo % CICLOS_EEPROM == 0);
-            if (es_ciclo_eeprom)
-                ESP_LOGI(TAG, "=== ESCANEO COMPLETO (ciclo %lu) ===", ciclo);
-
-            escanear_dispositivos(&ds2482, es_ciclo_eeprom);
-        }
-
-        if (nvs_dirty) { guardar_en_nvs(); nvs_dirty = false; }
+        uint32_t ciclo = copiar_vista();
 
         // ── Display consola ───────────────────────────────────────────────────
         ESP_LOGI(TAG, "============================================");
         ESP_LOGI(TAG, "   JAULAS ENGANCHADAS | ciclo=%lu", ciclo);
         ESP_LOGI(TAG, "============================================");
         int enganchadas = 0;
-        for (size_t i = 0; i < num_dispositivos; i++) {
-            if (!dispositivos[i].presente) continue;
+        for (size_t i = 0; i < vista_num; i++) {
+            const dispositivo_t *d = &vista_jaulas[i].d;
+            if (!d->presente) continue;
             enganchadas++;
-            if (dispositivos[i].asignado) {
-                ESP_LOGI(TAG, "[OK] Jaula: %-12s | Dolly: %-12s | ROM: %s",
-                         dispositivos[i].unidad,
-                         dispositivos[i].tiene_dolly
-                             ? dispositivos[i].unidad_dolly : "N/A",
-                         dispositivos[i].rom_str);
+            char rom_str[17];
+            rom_to_string(d->rom, rom_str);
+            if (d->asignado) {
+                ESP_LOGI(TAG, "[OK] S%d Jaula: %-12s | Dolly: %-12s | ROM: %s", d->segmento,
+                         d->unidad, d->tiene_dolly ? d->unidad_dolly : "N/A", rom_str);
             } else {
-                ESP_LOGI(TAG, "[??] SIN ASIGNAR | ROM: %s", dispositivos[i].rom_str);
+                ESP_LOGI(TAG, "[??] S%d SIN ASIGNAR | ROM: %s", d->segmento, rom_str);
             }
         }
         if (enganchadas == 0) ESP_LOGI(TAG, "   >>> SIN JAULAS <<<");
         ESP_LOGI(TAG, "============================================\n");
 
         publicar_mqtt();
-
-        vTaskDelay(pdMS_TO_TICKS(SCAN_INTERVAL_MS));
+        if (ciclo / CICLOS_EEPROM != publicado_tiempos / CICLOS_EEPROM) {
+            for (size_t s = 0; s < NUM_SEGMENTOS; s++) publicar_tiempos_bus(&vista[s]);
+            publicado_tiempos = ciclo;
+        }
+        if (ciclo / CICLOS_SALUD != publicado_salud / CICLOS_SALUD) {
+            publicar_salud();
+            publicado_salud = ciclo;
+        }
     }
-}
\ No newline at end of file
+}
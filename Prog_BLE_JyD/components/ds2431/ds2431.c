@@ -1,33 +1,42 @@
+#include <stdio.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 #include "ds2431.h"
+#include "crc.h"
 
 #define TAG "DS2431"
 
+// Un sdkconfig viejo puede traer un valor por debajo del rango actual
+#if CONFIG_DS2431_COPY_SPU_US < DS2431_TPROG_MAX_US
+#define COPY_SPU_US          DS2431_TPROG_MAX_US
+#else
+#define COPY_SPU_US          CONFIG_DS2431_COPY_SPU_US
+#endif
+
 // ─────────────────────────────────────────────────────────────────────────────
-// CRC-16 (polinomio 0x8005, usado por DS2431)
+// CRC-16 (polinomio 0x8005, usado por DS2431) — ver componente crc
 // ─────────────────────────────────────────────────────────────────────────────
 uint16_t ds2431_crc16(const uint8_t *data, size_t len) {
-    uint16_t crc = 0x0000;
-    for (size_t i = 0; i < len; i++) {
-        crc ^= (uint16_t)data[i] << 8;
-        for (int j = 0; j < 8; j++) {
-            crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : (crc << 1);
-        }
-    }
-    return crc;
+    return crc16_idj(data, len);
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
 // Match ROM — selecciona un esclavo específico en el bus 1-Wire
+//
+// Si el esclavo es el último direccionado, basta con Resume: el DS2431
+// conserva su flag RC hasta el próximo comando ROM. Un reset que necesitó
+// reintentos vuelve al Match ROM completo.
 // ─────────────────────────────────────────────────────────────────────────────
 esp_err_t ds2431_match_rom(ds2482_t *ds2482, ds2431_t *dev) {
     esp_err_t err;
     bool presence = false;
 
-    for (int intento = 0; intento < 3; intento++) {
+    int intento;
+    for (intento = 0; intento < 3; intento++) {
         err = ds2482_1wire_reset(&presence);
         if (err == ESP_OK && presence) break;
         vTaskDelay(pdMS_TO_TICKS(10));
@@ -40,6 +49,18 @@ esp_err_t ds2431_match_rom(ds2482_t *ds2482, ds2431_t *dev) {
         return ESP_ERR_NOT_FOUND;
     }
 
+#if CONFIG_DS2431_RESUME
+    if (intento == 0 && ds2482_rom_es_activa(dev->rom_code)) {
+        err = ds2482_write_byte(OW_CMD_RESUME);
+        if (err != ESP_OK) {
+            ds2482_rom_olvidar();
+            ESP_LOGE(TAG, "Error enviando Resume");
+        }
+        return err;
+    }
+#endif
+
+    ds2482_rom_olvidar();
     err = ds2482_write_byte(OW_CMD_MATCH_ROM);
     if (err != ESP_OK) return err;
 
@@ -51,9 +72,60 @@ esp_err_t ds2431_match_rom(ds2482_t *ds2482, ds2431_t *dev) {
             return err;
         }
     }
+
+    ds2482_rom_recordar(dev->rom_code);
     return ESP_OK;
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+// Overdrive Skip / Match ROM
+// El byte de comando se envía a velocidad estándar; lo que sigue (la ROM en
+// el Match, y todo el tráfico posterior) va en overdrive.
+// ─────────────────────────────────────────────────────────────────────────────
+static esp_err_t overdrive_comando(ds2482_t *ds2482, uint8_t cmd) {
+    esp_err_t err = ds2482_configure(ds2482, DS2482_CFG_APU);
+    if (err != ESP_OK) return err;
+
+    bool presence = false;
+    err = ds2482_1wire_reset(&presence);
+    if (err != ESP_OK) return err;
+    if (!presence) return ESP_ERR_NOT_FOUND;
+
+    err = ds2482_write_byte(cmd);
+    if (err != ESP_OK) return err;
+    return ds2482_configure(ds2482, DS2482_CFG_APU | DS2482_CFG_1WS);
+}
+
+esp_err_t ds2431_overdrive_match(ds2482_t *ds2482, ds2431_t *dev) {
+    ds2482_rom_olvidar();
+    esp_err_t err = overdrive_comando(ds2482, OW_CMD_OVERDRIVE_MATCH);
+    if (err != ESP_OK) return err;
+
+    uint8_t *rom_bytes = (uint8_t *)&dev->rom_code;
+    for (int i = 0; i < 8; i++) {
+        err = ds2482_write_byte(rom_bytes[i]);
+        if (err != ESP_OK) return err;
+    }
+
+    ds2482_rom_recordar(dev->rom_code);
+    return ESP_OK;
+}
+
+esp_err_t ds2431_overdrive_skip(ds2482_t *ds2482) {
+    // Skip ROM limpia el flag RC de todos los esclavos
+    ds2482_rom_olvidar();
+    return overdrive_comando(ds2482, OW_CMD_OVERDRIVE_SKIP);
+}
+
+esp_err_t ds2431_velocidad_estandar(ds2482_t *ds2482) {
+    esp_err_t err = ds2482_configure(ds2482, DS2482_CFG_APU);
+    if (err != ESP_OK) return err;
+
+    // Un reset a velocidad estándar saca de overdrive a todos los esclavos
+    bool presence;
+    return ds2482_1wire_reset(&presence);
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
 // Write Scratchpad — escribe hasta 8 bytes en dirección alineada
 // ─────────────────────────────────────────────────────────────────────────────
@@ -67,22 +139,34 @@ esp_err_t ds2431_write_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
     esp_err_t err = ds2431_match_rom(ds2482, dev);
     if (err != ESP_OK) return err;
 
-    err = ds2482_write_byte(DS2431_CMD_WRITE_SCRATCHPAD);
-    if (err != ESP_OK) return err;
-
-    err = ds2482_write_byte((uint8_t)(addr & 0xFF));
-    if (err != ESP_OK) return err;
-    err = ds2482_write_byte((uint8_t)(addr >> 8));
-    if (err != ESP_OK) return err;
+    uint8_t cmd[3 + 8] = {
+        DS2431_CMD_WRITE_SCRATCHPAD, (uint8_t)(addr & 0xFF), (uint8_t)(addr >> 8)
+    };
+    memcpy(&cmd[3], data, len);
 
-    for (size_t i = 0; i < len; i++) {
-        err = ds2482_write_byte(data[i]);
+    for (size_t i = 0; i < 3 + len; i++) {
+        err = ds2482_write_byte(cmd[i]);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Error escribiendo byte %d en scratchpad", i);
             return err;
         }
     }
 
+    // Si la escritura llega al fin de la fila, el DS2431 contesta con el
+    // CRC-16 invertido de comando + dirección + datos tal como los recibió
+    if ((addr & 0x07) + len == 8) {
+        uint8_t rx[2];
+        err = ds2482_read_byte(&rx[0]); if (err != ESP_OK) return err;
+        err = ds2482_read_byte(&rx[1]); if (err != ESP_OK) return err;
+        uint16_t esperado = (uint16_t)~crc16_ow(cmd, 3 + len);
+        uint16_t recibido = (uint16_t)rx[0] | ((uint16_t)rx[1] << 8);
+        if (recibido != esperado) {
+            ESP_LOGW(TAG, "Write Scratchpad @ 0x%02X: CRC 0x%04X, esperado 0x%04X",
+                     addr, recibido, esperado);
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+
     ESP_LOGD(TAG, "Write Scratchpad OK @ 0x%02X, %d bytes", addr, len);
     return ESP_OK;
 }
@@ -90,8 +174,8 @@ esp_err_t ds2431_write_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
 // ─────────────────────────────────────────────────────────────────────────────
 // Read Scratchpad — verifica antes del commit
 // ─────────────────────────────────────────────────────────────────────────────
-esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
-                                  uint16_t *addr_es, uint8_t *data, size_t len) {
+esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev, uint16_t *addr_es,
+                                  uint8_t *es_byte, uint8_t *data, size_t len) {
     esp_err_t err = ds2431_match_rom(ds2482, dev);
     if (err != ESP_OK) return err;
 
@@ -104,6 +188,7 @@ esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
     err = ds2482_read_byte(&es);  if (err != ESP_OK) return err;
 
     if (addr_es) *addr_es = (uint16_t)ta1 | ((uint16_t)ta2 << 8);
+    if (es_byte) *es_byte = es;
 
     for (size_t i = 0; i < len; i++) {
         err = ds2482_read_byte(&data[i]);
@@ -118,7 +203,7 @@ esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// Copy Scratchpad — commit a EEPROM (espera pasiva 15ms)
+// Copy Scratchpad — commit a EEPROM con Strong Pullup y polling del fin
 // ─────────────────────────────────────────────────────────────────────────────
 esp_err_t ds2431_copy_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
                                   uint16_t addr, uint8_t es_byte) {
@@ -130,12 +215,42 @@ esp_err_t ds2431_copy_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
 
     err = ds2482_write_byte((uint8_t)(addr & 0xFF)); if (err != ESP_OK) return err;
     err = ds2482_write_byte((uint8_t)(addr >> 8));   if (err != ESP_OK) return err;
-    err = ds2482_write_byte(es_byte);                if (err != ESP_OK) return err;
 
-    ESP_LOGI(TAG, "Copy Scratchpad addr=0x%02X es=0x%02X — grabando...", addr, es_byte);
-    vTaskDelay(pdMS_TO_TICKS(15));  // DS2431 tarda máx 10ms; 15ms por margen
-
-    return ESP_OK;
+    // El E/S arranca la programación: va con Strong Pullup, que el DS2482
+    // sostiene hasta el próximo comando 1-Wire y después borra solo
+    err = ds2482_configure(ds2482, DS2482_CFG_APU | DS2482_CFG_SPU);
+    if (err != ESP_OK) return err;
+    err = ds2482_write_byte(es_byte);
+    if (err != ESP_OK) {
+        ds2482_configure(ds2482, DS2482_CFG_APU);
+        return err;
+    }
+    int64_t t0 = esp_timer_get_time();
+    esp_rom_delay_us(COPY_SPU_US);
+
+    // Ningún time slot mientras programa: el primero corta el Strong Pullup.
+    // Pasado tPROG máx. la lectura solo confirma el resultado (0xAA/0x55
+    // alternados; 0xFF si el esclavo todavía no terminó).
+    uint8_t fin = 0xFF;
+    uint32_t us = 0;
+    do {
+        err = ds2482_read_byte(&fin);
+        if (err != ESP_OK) return err;
+        us = (uint32_t)(esp_timer_get_time() - t0);
+    } while (fin == 0xFF && us < DS2431_COPY_TIMEOUT_US);
+
+    if (fin == 0xAA || fin == 0x55) {
+        ESP_LOGI(TAG, "Copy Scratchpad addr=0x%02X es=0x%02X OK en %lu us",
+                 addr, es_byte, (unsigned long)us);
+        return ESP_OK;
+    }
+    if (fin == 0xFF) {
+        ESP_LOGE(TAG, "Copy Scratchpad addr=0x%02X sin confirmar en %lu us",
+                 addr, (unsigned long)us);
+        return ESP_ERR_TIMEOUT;
+    }
+    ESP_LOGE(TAG, "Copy Scratchpad addr=0x%02X: fin inválido 0x%02X", addr, fin);
+    return ESP_ERR_INVALID_RESPONSE;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -162,161 +277,256 @@ esp_err_t ds2431_read_memory(ds2482_t *ds2482, ds2431_t *dev,
     return ESP_OK;
 }
 
+static uint16_t leer_u16(const uint8_t *p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t leer_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8)
+         | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void poner_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
-// API alto nivel: escribir datos IDJ v2 (jaula + dolly opcional)
+// Códigos de unidad: salen del número, v3 ya no los guarda
+// ─────────────────────────────────────────────────────────────────────────────
+void ds2431_generar_unidad_jaula(uint16_t jaula, char *out) {
+    snprintf(out, 12, "T0603-%04d", jaula);
+}
+
+void ds2431_generar_unidad_dolly(uint16_t dolly, char *out) {
+    snprintf(out, 12, "T0605-%04d", dolly);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Imagen IDJ v3 de la EEPROM
 //
 // Layout del buffer (40 bytes = 5 bloques de 8):
-//   Block 0  0x00–0x07  Magic + numero_jaula + unidad_jaula[0..3]
-//   Block 1  0x08–0x0F  unidad_jaula[4..11]
-//   Block 2  0x10–0x17  numero_dolly + unidad_dolly[0..5]
-//   Block 3  0x18–0x1F  unidad_dolly[6..11] + padding
-//   Block 4  0x20–0x27  timestamp + CRC-16 + padding
+//   Block 0  0x00–0x07  Magic + versión + numero_jaula + numero_dolly + timestamp[0..1]
+//   Block 1  0x08–0x0F  timestamp[2..3] + CRC-16 + reservado
+//   Bloques 2 y 4       en cero (anulan la huella de un registro v1/v2); el 3 no se toca
 // ─────────────────────────────────────────────────────────────────────────────
-esp_err_t ds2431_escribir_datos(ds2482_t *ds2482, ds2431_t *dev,
-                                 const ds2431_data_t *datos) {
-    uint8_t buf[DS2431_EEPROM_BUF_LEN];
-    memset(buf, 0x00, sizeof(buf));
-
-    // ── Magic ──────────────────────────────────────────────────────────────────
-    buf[DS2431_ADDR_MAGIC]     = DS2431_MAGIC_BYTE0;
-    buf[DS2431_ADDR_MAGIC + 1] = DS2431_MAGIC_BYTE1;
-
-    // ── Jaula ──────────────────────────────────────────────────────────────────
-    buf[DS2431_ADDR_JAULA]     = (uint8_t)(datos->numero_jaula & 0xFF);
-    buf[DS2431_ADDR_JAULA + 1] = (uint8_t)(datos->numero_jaula >> 8);
-    memcpy(&buf[DS2431_ADDR_UNIDAD_JAULA], datos->unidad_jaula, 12);
-
-    // ── Dolly (0 = sin dolly, unidad queda en 0x00) ───────────────────────────
-    buf[DS2431_ADDR_DOLLY]     = (uint8_t)(datos->numero_dolly & 0xFF);
-    buf[DS2431_ADDR_DOLLY + 1] = (uint8_t)(datos->numero_dolly >> 8);
-    if (datos->tiene_dolly && datos->numero_dolly > 0) {
-        memcpy(&buf[DS2431_ADDR_UNIDAD_DOLLY], datos->unidad_dolly, 12);
-    }
+void ds2431_armar_imagen(const ds2431_data_t *datos, uint8_t *buf) {
+    memset(buf, 0x00, DS2431_EEPROM_BUF_LEN);
+
+    // ── Magic y versión ───────────────────────────────────────────────────────
+    buf[DS2431_ADDR_MAGIC]   = DS2431_MAGIC_BYTE0;
+    buf[DS2431_ADDR_VERSION] = DS2431_VERSION_V3;
+
+    // ── Jaula y dolly (0 = sin dolly) ─────────────────────────────────────────
+    poner_u16(&buf[DS2431_ADDR_JAULA], datos->numero_jaula);
+    poner_u16(&buf[DS2431_V3_ADDR_DOLLY], datos->tiene_dolly ? datos->numero_dolly : 0);
 
     // ── Timestamp ─────────────────────────────────────────────────────────────
-    buf[DS2431_ADDR_TIMESTAMP]     = (uint8_t)(datos->timestamp & 0xFF);
-    buf[DS2431_ADDR_TIMESTAMP + 1] = (uint8_t)((datos->timestamp >> 8)  & 0xFF);
-    buf[DS2431_ADDR_TIMESTAMP + 2] = (uint8_t)((datos->timestamp >> 16) & 0xFF);
-    buf[DS2431_ADDR_TIMESTAMP + 3] = (uint8_t)((datos->timestamp >> 24) & 0xFF);
-
-    // ── CRC-16 sobre los primeros 36 bytes (0x00–0x23) ────────────────────────
-    uint16_t crc = ds2431_crc16(buf, DS2431_CRC_DATA_LEN);
-    buf[DS2431_ADDR_CRC16]     = (uint8_t)(crc & 0xFF);
-    buf[DS2431_ADDR_CRC16 + 1] = (uint8_t)(crc >> 8);
-
-    // ── Escribir en 5 bloques de 8 bytes ─────────────────────────────────────
-    size_t pos = 0;
-    while (pos < DS2431_EEPROM_BUF_LEN) {
-        uint16_t addr = (uint16_t)pos;
-
-        // Reset del bridge antes de cada bloque
-        ds2482_1wire_reset(&(bool){false});
-        vTaskDelay(pdMS_TO_TICKS(5));
-
-        // 1. Escribir scratchpad
-        esp_err_t err = ds2431_write_scratchpad(ds2482, dev, addr, &buf[pos], 8);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error write_scratchpad bloque 0x%02X", addr);
-            return err;
-        }
+    buf[DS2431_V3_ADDR_TIMESTAMP]     = (uint8_t)(datos->timestamp & 0xFF);
+    buf[DS2431_V3_ADDR_TIMESTAMP + 1] = (uint8_t)((datos->timestamp >> 8)  & 0xFF);
+    buf[DS2431_V3_ADDR_TIMESTAMP + 2] = (uint8_t)((datos->timestamp >> 16) & 0xFF);
+    buf[DS2431_V3_ADDR_TIMESTAMP + 3] = (uint8_t)((datos->timestamp >> 24) & 0xFF);
+
+    // ── CRC-16 sobre los primeros 10 bytes (0x00–0x09) ────────────────────────
+    poner_u16(&buf[DS2431_V3_ADDR_CRC16], ds2431_crc16(buf, DS2431_V3_CRC_DATA_LEN));
+}
 
-        // 2. Leer y verificar scratchpad
-        uint8_t ta1, ta2, es_byte;
-        uint8_t verify[8];
-        ds2431_match_rom(ds2482, dev);
-        ds2482_write_byte(DS2431_CMD_READ_SCRATCHPAD);
-        ds2482_read_byte(&ta1);
-        ds2482_read_byte(&ta2);
-        ds2482_read_byte(&es_byte);
-        for (int i = 0; i < 8; i++) ds2482_read_byte(&verify[i]);
-
-        if (memcmp(&buf[pos], verify, 8) != 0) {
+// Un bloque de 8 bytes: Write Scratchpad, verificación y Copy
+static esp_err_t escribir_bloque(ds2482_t *ds2482, ds2431_t *dev, uint16_t addr,
+                                 const uint8_t *bloque) {
+    // Reset del bridge antes de cada bloque
+    ds2482_1wire_reset(&(bool){false});
+    vTaskDelay(pdMS_TO_TICKS(5));
+
+    // 1. Escribir scratchpad, verificado por el CRC-16 del esclavo. Con el
+    //    CRC bien la fila está completa y el E/S es el offset final (7)
+    uint8_t es_byte = 0x07;
+    esp_err_t err = ds2431_write_scratchpad(ds2482, dev, addr, bloque, 8);
+    if (err == ESP_ERR_INVALID_CRC) {
+        // 2. CRC malo (escritura o respuesta corrupta): releer y comparar
+        uint8_t  verify[8];
+        uint16_t ta;
+        err = ds2431_read_scratchpad(ds2482, dev, &ta, &es_byte, verify, sizeof(verify));
+        if (err != ESP_OK) return err;
+
+        if (ta != addr || memcmp(bloque, verify, 8) != 0) {
             ESP_LOGE(TAG, "Validación scratchpad falló en 0x%02X", addr);
+            ds2482_rom_olvidar();
             return ESP_ERR_INVALID_RESPONSE;
         }
+    } else if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error write_scratchpad bloque 0x%02X", addr);
+        return err;
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(10));
+    vTaskDelay(pdMS_TO_TICKS(10));
 
-        // 3. Commit a EEPROM
-        err = ds2431_copy_scratchpad(ds2482, dev, addr, es_byte);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error copy_scratchpad bloque 0x%02X", addr);
-            return err;
-        }
+    // 3. Commit a EEPROM
+    err = ds2431_copy_scratchpad(ds2482, dev, addr, es_byte);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error copy_scratchpad bloque 0x%02X", addr);
+        return err;
+    }
+
+    // Programación confirmada por el Copy: sin pausa antes del siguiente
+    ESP_LOGI(TAG, "Bloque 0x%02X grabado OK", addr);
+    return ESP_OK;
+}
+
+// Graba los bloques de DS2431_BLOQUES_V3 que difieren de `actual` (todos si
+// es NULL), de mayor a menor: primero se anulan las huellas viejas (4 y 2) y
+// el registro v3 va al final, así una grabación cortada nunca deja una
+// huella vieja que el maestro siga aceptando.
+static esp_err_t escribir_imagen(ds2482_t *ds2482, ds2431_t *dev, const uint8_t *buf,
+                                 const uint8_t *actual, uint8_t *escritos) {
+    if (escritos) *escritos = 0;
+    for (int b = DS2431_BLOQUES - 1; b >= 0; b--) {
+        if (!(DS2431_BLOQUES_V3 & (1 << b))) continue;
+        uint16_t addr = (uint16_t)(b * 8);
+        if (actual && memcmp(&actual[addr], &buf[addr], 8) == 0) continue;
+        esp_err_t err = escribir_bloque(ds2482, dev, addr, &buf[addr]);
+        if (err != ESP_OK) return err;
+        if (escritos) *escritos |= (uint8_t)(1 << b);
+    }
+    return ESP_OK;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// API alto nivel: escribir datos IDJ v3 (jaula + dolly opcional)
+// ─────────────────────────────────────────────────────────────────────────────
+esp_err_t ds2431_escribir_datos(ds2482_t *ds2482, ds2431_t *dev,
+                                 const ds2431_data_t *datos) {
+    uint8_t buf[DS2431_EEPROM_BUF_LEN];
+    ds2431_armar_imagen(datos, buf);
+    return escribir_imagen(ds2482, dev, buf, NULL, NULL);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Escritura diferencial: solo los bloques que difieren de la imagen actual.
+// Reprogramar los mismos datos no graba nada; pasar una jaula v2 a v3 graba
+// los bloques 0–2 y 4 una sola vez. Si no se pasa la imagen actual se lee
+// acá, y si esa lectura falla se graban todos.
+// ─────────────────────────────────────────────────────────────────────────────
+esp_err_t ds2431_escribir_datos_diff(ds2482_t *ds2482, ds2431_t *dev,
+                                      const ds2431_data_t *datos, const uint8_t *actual,
+                                      uint8_t *escritos) {
+    uint8_t buf[DS2431_EEPROM_BUF_LEN];
+    uint8_t leido[DS2431_EEPROM_BUF_LEN];
+    ds2431_armar_imagen(datos, buf);
 
-        ESP_LOGI(TAG, "Bloque 0x%02X grabado OK", addr);
-        pos += 8;
-        vTaskDelay(pdMS_TO_TICKS(20));
+    if (!actual) {
+        if (ds2431_read_memory(ds2482, dev, 0x00, leido, sizeof(leido)) == ESP_OK) {
+            actual = leido;
+        } else {
+            ESP_LOGW(TAG, "Sin imagen actual de la EEPROM — se graban todos los bloques");
+        }
     }
 
+    uint8_t mascara = 0;
+    esp_err_t err = escribir_imagen(ds2482, dev, buf, actual, &mascara);
+    if (escritos) *escritos = mascara;
+    if (err != ESP_OK) return err;
+
+    ESP_LOGI(TAG, "Escritura diferencial: %d de %d bloques",
+             __builtin_popcount(mascara), __builtin_popcount(DS2431_BLOQUES_V3));
     return ESP_OK;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// API alto nivel: leer y validar datos IDJ v2
+// API alto nivel: leer y validar datos IDJ (v1, v2 o v3)
 //
-// Detecta automáticamente si la EEPROM tiene formato antiguo (v1, CRC en 0x14)
-// y lo informa, indicando que requiere reprogramación.
+// v3 se reconoce por el byte de versión en 0x01; v1 y v2 comparten el magic
+// 'I','D' y se distinguen por cuál de los dos CRC cierra. v1 no tiene dolly.
 // ─────────────────────────────────────────────────────────────────────────────
 esp_err_t ds2431_leer_datos(ds2482_t *ds2482, ds2431_t *dev,
                              ds2431_data_t *datos) {
     uint8_t buf[DS2431_EEPROM_BUF_LEN];
     memset(datos, 0, sizeof(ds2431_data_t));
 
-    esp_err_t err = ds2431_read_memory(ds2482, dev, 0x00, buf, DS2431_EEPROM_BUF_LEN);
+    // Con los 12 bytes de v3 alcanza; v1/v2 siguen en el mismo Read Memory
+    esp_err_t err = ds2431_read_memory(ds2482, dev, 0x00, buf, DS2431_V3_LEN);
     if (err != ESP_OK) return err;
+    if (buf[0] == DS2431_MAGIC_BYTE0 && buf[1] == DS2431_MAGIC_BYTE1) {
+        for (size_t i = DS2431_V3_LEN; i < DS2431_EEPROM_BUF_LEN; i++) {
+            err = ds2482_read_byte(&buf[i]);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Error leyendo memoria byte %d", i);
+                return err;
+            }
+        }
+    }
+    return ds2431_parsear_imagen(buf, datos);
+}
+
+uint8_t ds2431_version_imagen(const uint8_t *buf) {
+    if (buf[0] != DS2431_MAGIC_BYTE0) return 0;
+
+    if (buf[1] == DS2431_VERSION_V3) {
+        return leer_u16(&buf[DS2431_V3_ADDR_CRC16]) == ds2431_crc16(buf, DS2431_V3_CRC_DATA_LEN)
+             ? DS2431_VERSION_V3 : 0;
+    }
+    if (buf[1] != DS2431_MAGIC_BYTE1) return 0;
+    if (leer_u16(&buf[DS2431_ADDR_CRC16]) == ds2431_crc16(buf, DS2431_CRC_DATA_LEN)) {
+        return DS2431_VERSION_V2;
+    }
+    if (leer_u16(&buf[DS2431_V1_ADDR_CRC16]) == ds2431_crc16(buf, DS2431_V1_CRC_DATA_LEN)) {
+        return DS2431_VERSION_V1;
+    }
+    return 0;
+}
+
+esp_err_t ds2431_parsear_imagen(const uint8_t *buf, ds2431_data_t *datos) {
+    memset(datos, 0, sizeof(ds2431_data_t));
 
     // ── Verificar magic ───────────────────────────────────────────────────────
-    if (buf[0] != DS2431_MAGIC_BYTE0 || buf[1] != DS2431_MAGIC_BYTE1) {
+    if (buf[0] != DS2431_MAGIC_BYTE0
+        || (buf[1] != DS2431_MAGIC_BYTE1 && buf[1] != DS2431_VERSION_V3)) {
         ESP_LOGW(TAG, "EEPROM virgen (magic=0x%02X%02X)", buf[0], buf[1]);
         datos->valido = false;
         return ESP_OK;
     }
 
-    // ── Verificar CRC v2 (36 bytes, CRC en 0x24) ──────────────────────────────
-    uint16_t crc_leido     = (uint16_t)buf[DS2431_ADDR_CRC16]
-                           | ((uint16_t)buf[DS2431_ADDR_CRC16 + 1] << 8);
-    uint16_t crc_calculado = ds2431_crc16(buf, DS2431_CRC_DATA_LEN);
-
-    if (crc_leido != crc_calculado) {
-        // Intentar detectar formato antiguo v1 (CRC sobre 20 bytes en 0x14–0x15)
-        uint16_t crc_v1_leido     = (uint16_t)buf[0x14] | ((uint16_t)buf[0x15] << 8);
-        uint16_t crc_v1_calculado = ds2431_crc16(buf, 20);
-
-        if (crc_v1_leido == crc_v1_calculado) {
-            ESP_LOGW(TAG, "EEPROM con formato ANTIGUO (v1) — requiere reprogramación con firmware v2");
-        } else {
-            ESP_LOGE(TAG, "CRC inválido: leído=0x%04X calculado=0x%04X — datos corruptos",
-                     crc_leido, crc_calculado);
-        }
+    // ── Verificar CRC de la versión ───────────────────────────────────────────
+    uint8_t version = ds2431_version_imagen(buf);
+    if (version == 0) {
+        ESP_LOGE(TAG, "CRC inválido (magic=0x%02X%02X) — datos corruptos", buf[0], buf[1]);
         datos->valido = false;
         return ESP_ERR_INVALID_CRC;
     }
 
-    // ── Parsear jaula ─────────────────────────────────────────────────────────
-    datos->numero_jaula = (uint16_t)buf[DS2431_ADDR_JAULA]
-                        | ((uint16_t)buf[DS2431_ADDR_JAULA + 1] << 8);
-    memcpy(datos->unidad_jaula, &buf[DS2431_ADDR_UNIDAD_JAULA], 12);
-    datos->unidad_jaula[11] = '\0';
-
-    // ── Parsear dolly ─────────────────────────────────────────────────────────
-    datos->numero_dolly = (uint16_t)buf[DS2431_ADDR_DOLLY]
-                        | ((uint16_t)buf[DS2431_ADDR_DOLLY + 1] << 8);
-    datos->tiene_dolly  = (datos->numero_dolly > 0);
-    if (datos->tiene_dolly) {
-        memcpy(datos->unidad_dolly, &buf[DS2431_ADDR_UNIDAD_DOLLY], 12);
-        datos->unidad_dolly[11] = '\0';
-    }
+    // ── Parsear según la versión ──────────────────────────────────────────────
+    datos->numero_jaula = leer_u16(&buf[DS2431_ADDR_JAULA]);
+    switch (version) {
+    case DS2431_VERSION_V3:
+        datos->numero_dolly = leer_u16(&buf[DS2431_V3_ADDR_DOLLY]);
+        datos->timestamp    = leer_u32(&buf[DS2431_V3_ADDR_TIMESTAMP]);
+        ds2431_generar_unidad_jaula(datos->numero_jaula, datos->unidad_jaula);
+        if (datos->numero_dolly > 0) {
+            ds2431_generar_unidad_dolly(datos->numero_dolly, datos->unidad_dolly);
+        }
+        break;
 
-    // ── Parsear timestamp ─────────────────────────────────────────────────────
-    datos->timestamp = (uint32_t)buf[DS2431_ADDR_TIMESTAMP]
-                     | ((uint32_t)buf[DS2431_ADDR_TIMESTAMP + 1] << 8)
-                     | ((uint32_t)buf[DS2431_ADDR_TIMESTAMP + 2] << 16)
-                     | ((uint32_t)buf[DS2431_ADDR_TIMESTAMP + 3] << 24);
+    case DS2431_VERSION_V2:
+        memcpy(datos->unidad_jaula, &buf[DS2431_ADDR_UNIDAD_JAULA], 12);
+        datos->numero_dolly = leer_u16(&buf[DS2431_ADDR_DOLLY]);
+        if (datos->numero_dolly > 0) {
+            memcpy(datos->unidad_dolly, &buf[DS2431_ADDR_UNIDAD_DOLLY], 12);
+        }
+        datos->timestamp = leer_u32(&buf[DS2431_ADDR_TIMESTAMP]);
+        break;
 
-    datos->valido = true;
+    default:
+        memcpy(datos->unidad_jaula, &buf[DS2431_ADDR_UNIDAD_JAULA], 12);
+        datos->timestamp = leer_u32(&buf[DS2431_V1_ADDR_TIMESTAMP]);
+        break;
+    }
+    datos->unidad_jaula[11] = '\0';
+    datos->unidad_dolly[11] = '\0';
+    datos->tiene_dolly = (datos->numero_dolly > 0);
+    datos->version     = version;
+    datos->valido      = true;
 
-    ESP_LOGI(TAG, "EEPROM OK — Jaula #%d '%s' | Dolly %s",
+    ESP_LOGI(TAG, "EEPROM OK (v%d) — Jaula #%d '%s' | Dolly %s", version,
              datos->numero_jaula, datos->unidad_jaula,
              datos->tiene_dolly ? datos->unidad_dolly : "N/A");
 
@@ -7,6 +7,9 @@
 // Comandos ROM 1-Wire
 #define OW_CMD_MATCH_ROM        0x55
 #define OW_CMD_SKIP_ROM         0xCC
+#define OW_CMD_RESUME           0xA5  // reselecciona el último esclavo de Match ROM
+#define OW_CMD_OVERDRIVE_SKIP   0x3C
+#define OW_CMD_OVERDRIVE_MATCH  0x69
 
 // Comandos de memoria DS2431
 #define DS2431_CMD_WRITE_SCRATCHPAD  0x0F
@@ -14,7 +17,35 @@
 #define DS2431_CMD_COPY_SCRATCHPAD   0x55
 #define DS2431_CMD_READ_MEMORY       0xF0
 
-// ── Mapa de EEPROM IDJ v2 (con soporte Dolly) ─────────────────────────────────
+// ── Mapa de EEPROM IDJ v3 (compacto) ──────────────────────────────────────────
+//
+//  Block 0  (0x00–0x07)
+//    0x00       Magic           'I' (0x49)
+//    0x01       Versión         0x03 (en v1/v2 acá va la 'D' del magic)
+//    0x02–0x03  numero_jaula    uint16_t little-endian (1-9999, 0 = sin asignar)
+//    0x04–0x05  numero_dolly    uint16_t little-endian (0 = sin dolly)
+//    0x06–0x07  timestamp       bytes 0..1
+//
+//  Block 1  (0x08–0x0F)
+//    0x08–0x09  timestamp       bytes 2..3 (uint32_t unix time)
+//    0x0A–0x0B  CRC-16          sobre bytes 0x00–0x09 (10 bytes)
+//    0x0C–0x0F  reservado       0x00
+//
+//  Las unidades ("T0603-xxxx", "T0605-xxxx") no se guardan: se generan del
+//  número al leer. Al grabar v3 los bloques 2 y 4 se ponen en cero para que
+//  el maestro no siga aceptando la huella (timestamp + CRC) de un v1/v2.
+// ─────────────────────────────────────────────────────────────────────────────
+
+#define DS2431_ADDR_MAGIC           0x00  // 1 byte: magic 'I'
+#define DS2431_ADDR_VERSION         0x01  // 1 byte: versión (v3)
+#define DS2431_ADDR_JAULA           0x02  // 2 bytes: numero_jaula uint16_t
+#define DS2431_V3_ADDR_DOLLY        0x04  // 2 bytes: numero_dolly uint16_t
+#define DS2431_V3_ADDR_TIMESTAMP    0x06  // 4 bytes: unix time uint32_t
+#define DS2431_V3_ADDR_CRC16        0x0A  // 2 bytes: CRC-16
+#define DS2431_V3_CRC_DATA_LEN      10    // Bytes cubiertos por el CRC (0x00–0x09)
+#define DS2431_V3_LEN               12    // Registro completo con CRC
+
+// ── Mapa de EEPROM IDJ v2 (con soporte Dolly, solo lectura) ───────────────────
 //
 //  Block 0  (0x00–0x07)
 //    0x00–0x01  Magic bytes     'I','D'  (0x49, 0x44)
@@ -37,32 +68,43 @@
 //    0x24–0x25  CRC-16          sobre bytes 0x00–0x23 (36 bytes)
 //    0x26–0x27  padding         0x00
 //
-//  Total: 40 bytes = 5 bloques de 8 bytes
+//  v1 es el mismo block 0–1 sin dolly: timestamp en 0x10 y CRC-16 en 0x14
+//  sobre 0x00–0x13.
 // ─────────────────────────────────────────────────────────────────────────────
 
-#define DS2431_ADDR_MAGIC           0x00  // 2 bytes: magic 'I','D'
-#define DS2431_ADDR_JAULA           0x02  // 2 bytes: numero_jaula uint16_t
 #define DS2431_ADDR_UNIDAD_JAULA    0x04  // 12 bytes: "T0603-xxxx\0\0"
 #define DS2431_ADDR_DOLLY           0x10  // 2 bytes: numero_dolly uint16_t (0 = sin dolly)
 #define DS2431_ADDR_UNIDAD_DOLLY    0x12  // 12 bytes: "T0605-xxxx\0\0"
 #define DS2431_ADDR_TIMESTAMP       0x20  // 4 bytes: unix time uint32_t
 #define DS2431_ADDR_CRC16           0x24  // 2 bytes: CRC-16
-
 #define DS2431_CRC_DATA_LEN         36    // Bytes cubiertos por el CRC (0x00–0x23)
-#define DS2431_EEPROM_DATA_LEN      38    // Bytes útiles totales (sin padding final)
-#define DS2431_EEPROM_BUF_LEN       40    // Buffer de trabajo = 5 × 8 bytes
+
+#define DS2431_V1_ADDR_TIMESTAMP    0x10
+#define DS2431_V1_ADDR_CRC16        0x14
+#define DS2431_V1_CRC_DATA_LEN      20
+
+#define DS2431_EEPROM_BUF_LEN       40    // Buffer de trabajo = 5 × 8 bytes (registro v2)
+#define DS2431_BLOQUES              (DS2431_EEPROM_BUF_LEN / 8)
+// Bloques que graba v3: registro (0–1) y los que anulan la huella v1/v2 (2, 4)
+#define DS2431_BLOQUES_V3           0x17
 
 #define DS2431_MAGIC_BYTE0          0x49  // 'I'
-#define DS2431_MAGIC_BYTE1          0x44  // 'D'
+#define DS2431_MAGIC_BYTE1          0x44  // 'D' (v1/v2)
+
+#define DS2431_VERSION_V1           1
+#define DS2431_VERSION_V2           2
+#define DS2431_VERSION_V3           3
 
-// Tiempo de escritura EEPROM (máx 10ms por bloque según datasheet DS2431)
-#define DS2431_COPY_SCRATCHPAD_DELAY_MS  10
+// Tiempo de escritura EEPROM (máx 10ms por bloque según datasheet DS2431).
+// Mientras programa el bus lee 0xFF; al terminar, 0xAA/0x55 alternados.
+#define DS2431_TPROG_MAX_US          10000
+#define DS2431_COPY_TIMEOUT_US       (2 * DS2431_TPROG_MAX_US)
 
 typedef struct {
     uint64_t rom_code;
 } ds2431_t;
 
-// ── Estructura de datos IDJ v2 ────────────────────────────────────────────────
+// ── Estructura de datos IDJ ───────────────────────────────────────────────────
 typedef struct {
     // Jaula
     uint16_t numero_jaula;       // 1–9999 (0 = sin asignar)
@@ -76,24 +118,65 @@ typedef struct {
     // Metadata
     uint32_t timestamp;          // Unix time de la última programación
     bool     valido;             // true si magic y CRC son correctos
+    uint8_t  version;            // formato leído (DS2431_VERSION_*), 0 si no es válido
 } ds2431_data_t;
 
 // ── API de bajo nivel ─────────────────────────────────────────────────────────
+// Direcciona el esclavo. Si es el mismo del acceso anterior usa Resume
+// (reset + 1 byte) en vez de Match ROM (reset + 9 bytes), salvo que
+// CONFIG_DS2431_RESUME esté apagado.
 esp_err_t ds2431_match_rom(ds2482_t *ds2482, ds2431_t *dev);
+
+// Overdrive: el comando ROM va a velocidad estándar y desde ahí el esclavo
+// (o todos, con Skip) queda en overdrive y el bridge pasa a 1WS.
+// ds2431_velocidad_estandar() apaga 1WS y emite un reset a velocidad
+// estándar, que devuelve a todos los esclavos.
+esp_err_t ds2431_overdrive_match(ds2482_t *ds2482, ds2431_t *dev);
+esp_err_t ds2431_overdrive_skip(ds2482_t *ds2482);
+esp_err_t ds2431_velocidad_estandar(ds2482_t *ds2482);
+// Si la escritura termina en el fin de la fila (offset 7) lee el CRC-16
+// invertido que manda el esclavo y devuelve ESP_ERR_INVALID_CRC si no cierra.
 esp_err_t ds2431_write_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
                                    uint16_t addr, const uint8_t *data, size_t len);
-esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
-                                  uint16_t *addr_es, uint8_t *data, size_t len);
+// addr_es y es_byte (opcionales) devuelven la dirección destino y el E/S que
+// hay que repetir en el Copy Scratchpad.
+esp_err_t ds2431_read_scratchpad(ds2482_t *ds2482, ds2431_t *dev, uint16_t *addr_es,
+                                  uint8_t *es_byte, uint8_t *data, size_t len);
+// Emite el Copy con Strong Pullup y vuelve cuando el esclavo confirma el fin
+// de la programación. ESP_ERR_TIMEOUT si no lo confirma en
+// DS2431_COPY_TIMEOUT_US (Copy rechazado o esclavo desconectado).
 esp_err_t ds2431_copy_scratchpad(ds2482_t *ds2482, ds2431_t *dev,
                                   uint16_t addr, uint8_t es_byte);
 esp_err_t ds2431_read_memory(ds2482_t *ds2482, ds2431_t *dev,
                               uint16_t addr, uint8_t *data, size_t len);
 
 // ── API de alto nivel IDJ ─────────────────────────────────────────────────────
+// Las escrituras graban siempre v3 (los bloques de DS2431_BLOQUES_V3)
 esp_err_t ds2431_escribir_datos(ds2482_t *ds2482, ds2431_t *dev,
                                  const ds2431_data_t *datos);
+// Lee y decodifica v1, v2 o v3: los 12 bytes de v3 y, solo si el magic es de
+// v1/v2, el resto en el mismo Read Memory
 esp_err_t ds2431_leer_datos(ds2482_t *ds2482, ds2431_t *dev,
                              ds2431_data_t *datos);
+// Graba solo los bloques que difieren de `actual` (los DS2431_EEPROM_BUF_LEN
+// bytes desde 0x00, o NULL para leerlos antes). `escritos` (opcional)
+// devuelve la máscara de bloques grabados, bit 0 = 0x00.
+// No verifica el registro completo: eso queda para verificar_eeprom().
+esp_err_t ds2431_escribir_datos_diff(ds2482_t *ds2482, ds2431_t *dev,
+                                      const ds2431_data_t *datos, const uint8_t *actual,
+                                      uint8_t *escritos);
+// Imagen de los DS2431_EEPROM_BUF_LEN bytes (registro v3 y el resto en cero)
+// y su decodificación (lo mismo que ds2431_leer_datos() sobre una imagen ya
+// leída completa). ds2431_version_imagen() devuelve la versión cuyo CRC
+// cierra, 0 si ninguna.
+void      ds2431_armar_imagen(const ds2431_data_t *datos, uint8_t *buf);
+esp_err_t ds2431_parsear_imagen(const uint8_t *buf, ds2431_data_t *datos);
+uint8_t   ds2431_version_imagen(const uint8_t *buf);
+
+// Códigos de unidad que se derivan del número ("T0603-0230", "T0605-0045").
+// `out` de 12 bytes.
+void ds2431_generar_unidad_jaula(uint16_t jaula, char *out);
+void ds2431_generar_unidad_dolly(uint16_t dolly, char *out);
 
 // ── Utilidades ────────────────────────────────────────────────────────────────
 uint16_t  ds2431_crc16(const uint8_t *data, size_t len);
@@ -7,6 +7,9 @@
 static i2c_port_t g_i2c_num;
 static uint8_t g_i2c_addr;
 
+static uint64_t g_rom_activa;
+static bool     g_rom_activa_valida;
+
 #define DS2482_CMD_DEVICE_RESET   0xF0
 #define DS2482_CMD_SET_READ_PTR   0xE1
 #define DS2482_CMD_WRITE_BYTE     0xA5
@@ -35,6 +38,7 @@ esp_err_t ds2482_init(ds2482_t *dev, i2c_port_t i2c_num, uint8_t address) {
 
 esp_err_t ds2482_reset(ds2482_t *dev) {
     uint8_t cmd = DS2482_CMD_DEVICE_RESET;
+    ds2482_rom_olvidar();
     return i2c_master_write_to_device(dev->i2c_num, dev->address, &cmd, 1, pdMS_TO_TICKS(100));
 }
 
@@ -68,9 +72,24 @@ esp_err_t ds2482_1wire_reset(bool *presence) {
     ds2482_read_register(&status);
 
     *presence = (status & DS2482_STATUS_PPD) != 0;
+    // Sin presencia el esclavo pudo perder alimentación (y su flag RC)
+    if (!*presence) ds2482_rom_olvidar();
     return ESP_OK;
 }
 
+void ds2482_rom_recordar(uint64_t rom) {
+    g_rom_activa        = rom;
+    g_rom_activa_valida = true;
+}
+
+void ds2482_rom_olvidar(void) {
+    g_rom_activa_valida = false;
+}
+
+bool ds2482_rom_es_activa(uint64_t rom) {
+    return g_rom_activa_valida && g_rom_activa == rom;
+}
+
 esp_err_t ds2482_write_byte(uint8_t byte) {
     uint8_t cmd[2] = { DS2482_CMD_WRITE_BYTE, byte };
     ESP_ERROR_CHECK(ds2482_busy_wait());
@@ -106,6 +125,7 @@ esp_err_t ds2482_1wire_triplet(uint8_t direction, uint8_t *status) {
 
 esp_err_t ds2482_search_rom(uint64_t *rom_code) {
     *rom_code = 0;
+    ds2482_rom_olvidar();   // el Search ROM cambia qué esclavo queda seleccionado
 
     bool presence;
     ESP_ERROR_CHECK(ds2482_1wire_reset(&presence));
@@ -143,6 +163,7 @@ esp_err_t ds2482_read_status(ds2482_t *dev, uint8_t *status) {
 
 esp_err_t ds2482_search_rom_all(uint64_t *roms, size_t max_devices, size_t *found) {
     *found = 0;
+    ds2482_rom_olvidar();
     uint64_t last_rom = 0;
     int last_discrepancy = 0;
     int last_device_flag = 0;
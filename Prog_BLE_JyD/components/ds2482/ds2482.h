@@ -20,6 +20,12 @@ esp_err_t ds2482_write_byte(uint8_t byte);
 esp_err_t ds2482_read_byte(uint8_t *data);
 esp_err_t ds2482_search_rom(uint64_t *rom_code);
 
+// Último esclavo direccionado con Match ROM, para el Resume (0xA5) del DS2431.
+// Las búsquedas, el reset del bridge y un reset sin presencia lo olvidan.
+void ds2482_rom_recordar(uint64_t rom);
+void ds2482_rom_olvidar(void);
+bool ds2482_rom_es_activa(uint64_t rom);
+
 esp_err_t ds2482_set_read_pointer(uint8_t reg);
 esp_err_t ds2482_read_register(uint8_t *value);
 esp_err_t ds2482_busy_wait();
@@ -6,6 +6,7 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "driver/i2c.h"
 
@@ -23,15 +24,6 @@
 // Cola para recibir órdenes de programación de jaula desde BLE
 QueueHandle_t cola_programacion_jaula;
 
-// ── Generadores de código de unidad ──────────────────────────────────────────
-void generar_unidad_jaula(uint16_t jaula, char *out) {
-    snprintf(out, 12, "T0603-%04d", jaula);
-}
-
-void generar_unidad_dolly(uint16_t dolly, char *out) {
-    snprintf(out, 12, "T0605-%04d", dolly);
-}
-
 // ── Imprime volcado hexadecimal de la EEPROM ──────────────────────────────────
 void imprimir_eeprom_cruda(uint8_t *raw, size_t len) {
     printf("\n  Addr  | 00 01 02 03 04 05 06 07\n");
@@ -45,12 +37,46 @@ void imprimir_eeprom_cruda(uint8_t *raw, size_t len) {
     }
 }
 
+// ── Lectura cruda en overdrive, con fallback a velocidad estándar ─────────────
+// El tramo del banco es corto, así que el volcado de verificación intenta
+// overdrive. Si no pasa el CRC y a velocidad estándar sí, cuenta como fallo
+// del banco; tras OD_FALLOS_MAX seguidos queda en estándar hasta reiniciar.
+#define OD_FALLOS_MAX  2
+static uint8_t s_od_fallos = 0;
+
+static bool crudo_verificado(const uint8_t *raw) {
+    return ds2431_version_imagen(raw) != 0;
+}
+
+static esp_err_t leer_crudo(ds2482_t *ds2482, ds2431_t *esclavo, uint8_t *raw, size_t len) {
+    if (s_od_fallos >= OD_FALLOS_MAX) {
+        return ds2431_read_memory(ds2482, esclavo, 0x00, raw, len);
+    }
+
+    esp_err_t err = ds2431_overdrive_match(ds2482, esclavo);
+    if (err == ESP_OK) err = ds2431_read_memory(ds2482, esclavo, 0x00, raw, len);
+    ds2431_velocidad_estandar(ds2482);
+    if (err == ESP_OK && crudo_verificado(raw)) {
+        s_od_fallos = 0;
+        return ESP_OK;
+    }
+
+    // Virgen, corrupta o sin respuesta: se confirma a velocidad estándar
+    ds2482_rom_olvidar();
+    err = ds2431_read_memory(ds2482, esclavo, 0x00, raw, len);
+    if (err == ESP_OK && crudo_verificado(raw) && ++s_od_fallos >= OD_FALLOS_MAX) {
+        ESP_LOGW(TAG, "Overdrive falló %d veces seguidas — el banco sigue a velocidad estándar",
+                 s_od_fallos);
+    }
+    return err;
+}
+
 // ── Lee y verifica la EEPROM, muestra resultado detallado ─────────────────────
 bool verificar_eeprom(ds2482_t *ds2482, ds2431_t *esclavo) {
-    printf("\n--- Verificación EEPROM (v2) ---\n");
+    printf("\n--- Verificación EEPROM (v3) ---\n");
 
     uint8_t raw[DS2431_EEPROM_BUF_LEN];
-    esp_err_t err = ds2431_read_memory(ds2482, esclavo, 0x00, raw, sizeof(raw));
+    esp_err_t err = leer_crudo(ds2482, esclavo, raw, sizeof(raw));
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "ERROR: No se pudo leer la memoria (%s)", esp_err_to_name(err));
         return false;
@@ -58,31 +84,34 @@ bool verificar_eeprom(ds2482_t *ds2482, ds2431_t *esclavo) {
 
     imprimir_eeprom_cruda(raw, sizeof(raw));
 
+    // Se decodifica lo que ya se leyó: no hace falta otro Read Memory
     ds2431_data_t leido;
-    err = ds2431_leer_datos(ds2482, esclavo, &leido);
+    err = ds2431_parsear_imagen(raw, &leido);
 
     if (err != ESP_OK || !leido.valido) {
         if (raw[0] == 0xFF && raw[1] == 0xFF) {
             ESP_LOGW(TAG, "Estado: EEPROM VIRGEN (sin programar)");
         } else if (err == ESP_ERR_INVALID_CRC) {
-            // El mensaje ya fue emitido en ds2431_leer_datos
+            // El mensaje ya fue emitido en ds2431_parsear_imagen
         } else {
             ESP_LOGE(TAG, "Estado: DATOS INVÁLIDOS");
         }
         return false;
     }
+    if (leido.version != DS2431_VERSION_V3) {
+        ESP_LOGE(TAG, "Estado: quedó un registro v%d, no el v3 grabado", leido.version);
+        return false;
+    }
 
-    printf("  [0x00-0x01] Magic      : OK ('ID')\n");
-    printf("  [0x02-0x03] Jaula      : #%d\n",   leido.numero_jaula);
-    printf("  [0x04-0x0F] Unidad     : '%s'\n",  leido.unidad_jaula);
-    printf("  [0x10-0x11] Dolly      : %s\n",
-           leido.tiene_dolly ? "presente" : "sin dolly");
+    printf("  [0x00-0x01] Magic      : OK ('I', v3)\n");
+    printf("  [0x02-0x03] Jaula      : #%d ('%s')\n", leido.numero_jaula, leido.unidad_jaula);
     if (leido.tiene_dolly) {
-        printf("  [0x10-0x11] Num. Dolly : #%d\n",  leido.numero_dolly);
-        printf("  [0x12-0x1D] ID Dolly   : '%s'\n", leido.unidad_dolly);
+        printf("  [0x04-0x05] Dolly      : #%d ('%s')\n", leido.numero_dolly, leido.unidad_dolly);
+    } else {
+        printf("  [0x04-0x05] Dolly      : sin dolly\n");
     }
-    printf("  [0x24-0x25] CRC-16     : OK (0x%04X)\n",
-           ds2431_crc16(raw, DS2431_CRC_DATA_LEN));
+    printf("  [0x0A-0x0B] CRC-16     : OK (0x%04X)\n",
+           ds2431_crc16(raw, DS2431_V3_CRC_DATA_LEN));
 
     ESP_LOGI(TAG, "✅ Jaula #%d verificada correctamente.", leido.numero_jaula);
     return true;
@@ -111,6 +140,8 @@ void cmd_leer_eeprom(ds2482_t *ds2482) {
     esp_err_t err = ds2431_leer_datos(ds2482, &esclavo, &datos);
 
     if (err == ESP_ERR_INVALID_CRC) {
+        // v1, v2 y v3 se decodifican: acá solo llega un CRC que no cierra.
+        // El texto queda igual para no romper la app del reTerminal
         ble_enviar_status("READ_ERROR:formato_antiguo");
         return;
     }
@@ -170,7 +201,7 @@ void app_main(void) {
     ds2482_configure(&ds2482, DS2482_CFG_APU);
 
     ESP_LOGI(TAG, "\n========================================");
-    ESP_LOGI(TAG, "  IDJ PROGRAMADOR v2 — LISTO");
+    ESP_LOGI(TAG, "  IDJ PROGRAMADOR v3 — LISTO");
     ESP_LOGI(TAG, "  1. Conectar esclavo al bus 1-Wire");
     ESP_LOGI(TAG, "  2. Conectar reTerminal por BLE");
     ESP_LOGI(TAG, "  3. (Opcional) Enviar número de dolly → char 0xA0B6");
@@ -229,12 +260,16 @@ void app_main(void) {
 
             ds2431_t esclavo = { .rom_code = roms[0] };
 
-            // 3. Leer estado anterior para el mensaje de confirmación
-            ds2431_data_t datos_previos;
+            // 3. Leer estado anterior para el mensaje de confirmación. La
+            //    imagen cruda queda para la escritura diferencial
+            ds2431_data_t datos_previos = {0};
+            uint8_t imagen_previa[DS2431_EEPROM_BUF_LEN];
             char info_anterior_jaula[16] = "NUEVA/VACIA";
             char info_anterior_dolly[16] = "NONE";
 
-            esp_err_t err_read = ds2431_leer_datos(&ds2482, &esclavo, &datos_previos);
+            esp_err_t err_read = leer_crudo(&ds2482, &esclavo, imagen_previa, sizeof(imagen_previa));
+            bool imagen_ok = (err_read == ESP_OK);
+            if (imagen_ok) err_read = ds2431_parsear_imagen(imagen_previa, &datos_previos);
             if (err_read == ESP_OK && datos_previos.valido) {
                 snprintf(info_anterior_jaula, sizeof(info_anterior_jaula),
                          "#%d", datos_previos.numero_jaula);
@@ -245,14 +280,14 @@ void app_main(void) {
                 ESP_LOGW(TAG, "Esclavo ya tenía: Jaula %s | Dolly %s",
                          info_anterior_jaula, info_anterior_dolly);
             } else {
-                ESP_LOGI(TAG, "Esclavo virgen o formato antiguo — asignando nuevos datos");
+                ESP_LOGI(TAG, "Esclavo virgen o corrupto — asignando nuevos datos");
             }
 
             // 4. Preparar nuevos datos
             char unidad_jaula[12];
             char unidad_dolly[12] = {0};
-            generar_unidad_jaula(nueva_jaula, unidad_jaula);
-            if (tiene_dolly) generar_unidad_dolly(nuevo_dolly, unidad_dolly);
+            ds2431_generar_unidad_jaula(nueva_jaula, unidad_jaula);
+            if (tiene_dolly) ds2431_generar_unidad_dolly(nuevo_dolly, unidad_dolly);
 
             ds2431_data_t datos_nuevos = {
                 .numero_jaula = nueva_jaula,
@@ -268,11 +303,30 @@ void app_main(void) {
                 datos_nuevos.unidad_dolly[11] = '\0';
             }
 
-            // 5. Escribir EEPROM
-            esp_err_t err_write = ds2431_escribir_datos(&ds2482, &esclavo, &datos_nuevos);
+            // 5. Escribir EEPROM: solo los bloques que cambian
+            uint8_t escritos = 0;
+            int64_t t_escritura = esp_timer_get_time();
+            esp_err_t err_write = ds2431_escribir_datos_diff(&ds2482, &esclavo, &datos_nuevos,
+                                                             imagen_ok ? imagen_previa : NULL,
+                                                             &escritos);
+            int64_t t_verificacion = esp_timer_get_time();
 
             // 6. Verificar y notificar resultado
-            if (err_write == ESP_OK && verificar_eeprom(&ds2482, &esclavo)) {
+            bool grabado_ok = (err_write == ESP_OK) && verificar_eeprom(&ds2482, &esclavo);
+
+            // Tiempo por jaula: comparar builds con CONFIG_DS2431_RESUME on/off
+            ESP_LOGI(TAG, "⏱ Programación: escritura %lld ms (%d/%d bloques) + verificación %lld ms (Resume %s)",
+                     (t_verificacion - t_escritura) / 1000,
+                     __builtin_popcount(escritos), __builtin_popcount(DS2431_BLOQUES_V3),
+                     (esp_timer_get_time() - t_verificacion) / 1000,
+#if CONFIG_DS2431_RESUME
+                     "on"
+#else
+                     "off"
+#endif
+                     );
+
+            if (grabado_ok) {
                 char msg[80];
                 if (tiene_dolly) {
                     snprintf(msg, sizeof(msg),
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ── CRCs del bus 1-Wire y de la EEPROM IDJ ────────────────────────────────────
+//
+//  CRC-8 Maxim   ROM de 64 bits: x^8 + x^5 + x^4 + 1 (0x31, reflejado 0x8C),
+//                init 0. Sobre los 8 bytes de una ROM válida da 0.
+//  CRC-16 IDJ    Registro IDJ v2: polinomio 0x8005, MSB primero, init 0
+//                (el mismo que calculaba ds2431_crc16()).
+//  CRC-16 1-Wire El de los comandos de memoria del DS2431: polinomio 0x8005
+//                reflejado (0xA001), LSB primero, init 0. El esclavo lo manda
+//                invertido y LSB primero.
+//
+// Las funciones *_actualizar() son incrementales: se pueden ir alimentando a
+// medida que llegan los bytes del bus, partiendo de CRC8_INICIAL /
+// CRC16_IDJ_INICIAL. La implementación (bit a bit, tabla de 16 o de 256
+// entradas) y la ubicación de las tablas se eligen en menuconfig.
+// ─────────────────────────────────────────────────────────────────────────────
+
+#define CRC8_INICIAL       0x00
+#define CRC16_IDJ_INICIAL  0x0000
+#define CRC16_OW_INICIAL   0x0000
+
+uint8_t  crc8_maxim_actualizar(uint8_t crc, const uint8_t *data, size_t len);
+uint8_t  crc8_maxim_byte(uint8_t crc, uint8_t byte);
+uint16_t crc16_idj_actualizar(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16_ow_actualizar(uint16_t crc, const uint8_t *data, size_t len);
+
+static inline uint8_t crc8_maxim(const uint8_t *data, size_t len) {
+    return crc8_maxim_actualizar(CRC8_INICIAL, data, len);
+}
+
+static inline uint16_t crc16_idj(const uint8_t *data, size_t len) {
+    return crc16_idj_actualizar(CRC16_IDJ_INICIAL, data, len);
+}
+
+static inline uint16_t crc16_ow(const uint8_t *data, size_t len) {
+    return crc16_ow_actualizar(CRC16_OW_INICIAL, data, len);
+}
@@ -0,0 +1,172 @@
+// Prueba de host del componente CRC: compila crc.c tres veces (bit a bit,
+// tabla de 16 y tabla de 256 entradas) en el mismo binario, verifica que
+// coincidan en buffers aleatorios y alimentados por tramos, y mide cuánto
+// tarda cada una. No forma parte del build de ESP-IDF; se compila con el
+// CMakeLists.txt de este directorio (ver ahí) y corre con ctest.
+//
+// Los tiempos son del host; en el ESP32 los da benchmark_bus().
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "crc.h"
+
+// ── Tres copias de crc.c con nombres propios ─────────────────────────────────
+#define crc8_maxim_actualizar  bits_crc8_maxim_actualizar
+#define crc8_maxim_byte        bits_crc8_maxim_byte
+#define crc16_idj_actualizar   bits_crc16_idj_actualizar
+#define crc16_ow_actualizar    bits_crc16_ow_actualizar
+#define CONFIG_CRC_IMPL_BITS   1
+#include "crc.c"
+#undef CONFIG_CRC_IMPL_BITS
+#undef CRC_TABLA
+#undef crc8_maxim_actualizar
+#undef crc8_maxim_byte
+#undef crc16_idj_actualizar
+#undef crc16_ow_actualizar
+
+#define crc8_maxim_actualizar  nib_crc8_maxim_actualizar
+#define crc8_maxim_byte        nib_crc8_maxim_byte
+#define crc16_idj_actualizar   nib_crc16_idj_actualizar
+#define crc16_ow_actualizar    nib_crc16_ow_actualizar
+#define s_crc8_tabla           nib_crc8_tabla
+#define s_crc16_tabla          nib_crc16_tabla
+#define s_crc16_ow_tabla       nib_crc16_ow_tabla
+#define CONFIG_CRC_IMPL_TABLA_16 1
+#include "crc.c"
+#undef CONFIG_CRC_IMPL_TABLA_16
+#undef CRC_TABLA
+#undef crc8_maxim_actualizar
+#undef crc8_maxim_byte
+#undef crc16_idj_actualizar
+#undef crc16_ow_actualizar
+#undef s_crc8_tabla
+#undef s_crc16_tabla
+#undef s_crc16_ow_tabla
+
+#define crc8_maxim_actualizar  byte_crc8_maxim_actualizar
+#define crc8_maxim_byte        byte_crc8_maxim_byte
+#define crc16_idj_actualizar   byte_crc16_idj_actualizar
+#define crc16_ow_actualizar    byte_crc16_ow_actualizar
+#define CONFIG_CRC_IMPL_TABLA_256 1
+#include "crc.c"
+#undef CONFIG_CRC_IMPL_TABLA_256
+#undef crc8_maxim_actualizar
+#undef crc8_maxim_byte
+#undef crc16_idj_actualizar
+#undef crc16_ow_actualizar
+
+typedef struct {
+    const char *nombre;
+    uint8_t  (*crc8)(uint8_t, const uint8_t *, size_t);
+    uint16_t (*idj)(uint16_t, const uint8_t *, size_t);
+    uint16_t (*ow)(uint16_t, const uint8_t *, size_t);
+} impl_t;
+
+static const impl_t s_impls[] = {
+    { "bits",  bits_crc8_maxim_actualizar, bits_crc16_idj_actualizar, bits_crc16_ow_actualizar },
+    { "nibble", nib_crc8_maxim_actualizar, nib_crc16_idj_actualizar,  nib_crc16_ow_actualizar  },
+    { "byte",  byte_crc8_maxim_actualizar, byte_crc16_idj_actualizar, byte_crc16_ow_actualizar },
+};
+#define NUM_IMPLS  (sizeof(s_impls) / sizeof(s_impls[0]))
+
+#define PRUEBA_BUFFERS   20000
+#define PRUEBA_LEN_MAX   128
+#define MEDIDA_BYTES     (8u * 1024u * 1024u)
+
+static int s_fallos;
+
+static void comprobar(int ok, const char *que, int i, size_t len) {
+    if (ok) return;
+    if (s_fallos++ < 10) printf("FALLO %s: buffer %d, %zu bytes\n", que, i, len);
+}
+
+// ── Vectores conocidos ───────────────────────────────────────────────────────
+static void probar_vectores(void) {
+    // ROM de ejemplo de la hoja de datos (CRC-8 en el último byte): da 0
+    static const uint8_t rom[8] = { 0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xA2 };
+    // "123456789": CRC-16/BUYPASS 0xFEE8 (IDJ) y CRC-16/ARC 0xBB3D (1-Wire)
+    static const uint8_t ascii[9] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    for (size_t k = 0; k < NUM_IMPLS; k++) {
+        const impl_t *f = &s_impls[k];
+        comprobar(f->crc8(CRC8_INICIAL, rom, sizeof(rom)) == 0, f->nombre, -1, sizeof(rom));
+        comprobar(f->idj(CRC16_IDJ_INICIAL, ascii, sizeof(ascii)) == 0xFEE8, f->nombre, -1, sizeof(ascii));
+        comprobar(f->ow(CRC16_OW_INICIAL, ascii, sizeof(ascii)) == 0xBB3D, f->nombre, -1, sizeof(ascii));
+    }
+}
+
+// ── Aleatorios y por tramos ──────────────────────────────────────────────────
+// Cada buffer se calcula de una vez con la referencia bit a bit y por tramos
+// de largo aleatorio (como llegan del bus) con cada implementación.
+static void probar_aleatorios(void) {
+    uint8_t buf[PRUEBA_LEN_MAX];
+    for (int i = 0; i < PRUEBA_BUFFERS; i++) {
+        size_t len = (size_t)(rand() % (PRUEBA_LEN_MAX + 1));
+        for (size_t j = 0; j < len; j++) buf[j] = (uint8_t)rand();
+        uint8_t  r8  = bits_crc8_maxim_actualizar(CRC8_INICIAL, buf, len);
+        uint16_t r16 = bits_crc16_idj_actualizar(CRC16_IDJ_INICIAL, buf, len);
+        uint16_t row = bits_crc16_ow_actualizar(CRC16_OW_INICIAL, buf, len);
+
+        for (size_t k = 0; k < NUM_IMPLS; k++) {
+            const impl_t *f = &s_impls[k];
+            comprobar(f->crc8(CRC8_INICIAL, buf, len) == r8, f->nombre, i, len);
+            comprobar(f->idj(CRC16_IDJ_INICIAL, buf, len) == r16, f->nombre, i, len);
+            comprobar(f->ow(CRC16_OW_INICIAL, buf, len) == row, f->nombre, i, len);
+
+            uint8_t c8 = CRC8_INICIAL;
+            uint16_t c16 = CRC16_IDJ_INICIAL, cow = CRC16_OW_INICIAL;
+            size_t pos = 0;
+            while (pos < len) {
+                size_t tramo = 1 + (size_t)rand() % (len - pos);
+                c8  = f->crc8(c8, buf + pos, tramo);
+                c16 = f->idj(c16, buf + pos, tramo);
+                cow = f->ow(cow, buf + pos, tramo);
+                pos += tramo;
+            }
+            comprobar(c8 == r8 && c16 == r16 && cow == row, "por tramos", i, len);
+        }
+    }
+}
+
+// ── Tiempos ──────────────────────────────────────────────────────────────────
+static double ns_por_byte(uint32_t (*calc)(const impl_t *, const uint8_t *, size_t),
+                          const impl_t *f, const uint8_t *buf, size_t len, uint32_t *acum) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (size_t hecho = 0; hecho < MEDIDA_BYTES; hecho += len) *acum += calc(f, buf, len);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    return ns / MEDIDA_BYTES;
+}
+
+static uint32_t calc_crc8(const impl_t *f, const uint8_t *b, size_t n) { return f->crc8(CRC8_INICIAL, b, n); }
+static uint32_t calc_idj(const impl_t *f, const uint8_t *b, size_t n)  { return f->idj(CRC16_IDJ_INICIAL, b, n); }
+static uint32_t calc_ow(const impl_t *f, const uint8_t *b, size_t n)   { return f->ow(CRC16_OW_INICIAL, b, n); }
+
+static void medir(size_t len) {
+    uint8_t buf[PRUEBA_LEN_MAX];
+    uint32_t acum = 0;   // evita que el compilador descarte el cálculo
+    for (size_t j = 0; j < len; j++) buf[j] = (uint8_t)rand();
+    printf("buffers de %3zu bytes      crc8    crc16 idj  crc16 1-Wire (ns/byte)\n", len);
+    for (size_t k = 0; k < NUM_IMPLS; k++) {
+        const impl_t *f = &s_impls[k];
+        double a = ns_por_byte(calc_crc8, f, buf, len, &acum);
+        double b = ns_por_byte(calc_idj, f, buf, len, &acum);
+        double c = ns_por_byte(calc_ow, f, buf, len, &acum);
+        printf("  %-20s %7.2f  %9.2f  %12.2f\n", f->nombre, a, b, c);
+    }
+    if (acum == 0x5A5A5A5A) printf("\n");
+}
+
+int main(void) {
+    srand(1);
+    probar_vectores();
+    probar_aleatorios();
+    printf("%d buffers aleatorios (0 a %d bytes), enteros y por tramos: %d fallos\n",
+           PRUEBA_BUFFERS, PRUEBA_LEN_MAX, s_fallos);
+
+    medir(8);     // ROM
+    medir(40);    // Read Memory de una página + CRC
+    medir(128);   // registro IDJ completo
+    return s_fallos ? 1 : 0;
+}
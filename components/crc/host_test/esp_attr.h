@@ -0,0 +1,3 @@
+#pragma once
+// Sustituto de host: las tablas quedan en .rodata.
+#define DRAM_ATTR
@@ -0,0 +1,3 @@
+#pragma once
+// sdkconfig vacío para la prueba de host: crc_host_test.c define la
+// implementación antes de cada inclusión de crc.c.